@@ -0,0 +1,295 @@
+// SPDX-FileCopyrightText: Copyright (c) The helly25/mbo authors (helly25.com)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Benchmarks for the parse, file and matcher hot paths.
+//
+// Every benchmark runs for several message sizes and two shapes built from the test protos:
+// - Flat:   `SimpleMessage` with `n` repeated integers.
+// - Nested: `TestMessage2` with `n` repeated sub-messages holding strings and doubles.
+//
+// Besides time, each benchmark reports `bytes_per_second` for the size of the text or file being processed (the
+// serialized size for matchers) and `allocs/op`, the number of heap allocations per iteration, counted by replacing
+// the global `operator new`.
+//
+// Run with: bazel run -c opt //mbo/proto:benchmarks
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <new>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include "absl/log/absl_check.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "benchmark/benchmark.h"
+#include "gmock/gmock.h"
+#include "google/protobuf/text_format.h"
+#include "mbo/proto/file.h"
+#include "mbo/proto/matchers.h"
+#include "mbo/proto/parse_text_proto.h"
+#include "mbo/proto/tests/simple_message.pb.h"
+#include "mbo/proto/tests/test.pb.h"
+
+namespace {
+
+std::atomic<std::int64_t> g_allocations{0};  // NOLINT(*-avoid-non-const-global-variables)
+
+}  // namespace
+
+// NOLINTBEGIN(*-no-malloc,*-owning-memory,misc-new-delete-overloads)
+void* operator new(std::size_t size) {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t /*size*/) noexcept {
+  std::free(ptr);
+}
+
+// NOLINTEND(*-no-malloc,*-owning-memory,misc-new-delete-overloads)
+
+namespace mbo::proto {
+namespace {
+// NOLINTBEGIN(*-magic-numbers)
+
+using ::mbo::proto::tests::SimpleMessage;
+using ::mbo::proto::tests::TestMessage2;
+
+struct FlatShape {
+  using ProtoType = SimpleMessage;
+
+  static ProtoType Make(int size) {
+    ProtoType proto;
+    proto.set_one(size);
+    for (int i = 0; i < size; ++i) {
+      proto.add_two(i * 7919);
+    }
+    return proto;
+  }
+};
+
+struct NestedShape {
+  using ProtoType = TestMessage2;
+
+  static ProtoType Make(int size) {
+    ProtoType proto;
+    proto.mutable_one()->set_name("one");
+    for (int i = 0; i < size; ++i) {
+      auto& more = *proto.add_more();
+      more.set_name(absl::StrCat("name_", i));
+      more.set_num(i);
+      more.set_val(i / 3.0);
+    }
+    return proto;
+  }
+};
+
+// Counts the heap allocations between construction and `Finish`, and sets the per iteration
+// counters of `state`.
+class AllocationCounter final {
+ public:
+  explicit AllocationCounter(benchmark::State& state)
+      : state_(state), start_(g_allocations.load(std::memory_order_relaxed)) {}
+
+  void Finish(std::size_t bytes_per_iteration) {
+    const std::int64_t allocations = g_allocations.load(std::memory_order_relaxed) - start_;
+    state_.counters["allocs/op"] = benchmark::Counter(
+        static_cast<double>(allocations), benchmark::Counter::kAvgIterations);
+    state_.SetBytesProcessed(state_.iterations() * static_cast<std::int64_t>(bytes_per_iteration));
+  }
+
+ private:
+  benchmark::State& state_;
+  const std::int64_t start_;
+};
+
+// A file in the temp directory that gets removed at the end of the benchmark.
+class TempFile final {
+ public:
+  explicit TempFile(std::string_view name)
+      : path_(std::filesystem::temp_directory_path() / absl::StrCat("mbo_proto_benchmark_", name)) {}
+
+  TempFile(const TempFile&) = delete;
+  TempFile& operator=(const TempFile&) = delete;
+  TempFile(TempFile&&) = delete;
+  TempFile& operator=(TempFile&&) = delete;
+
+  ~TempFile() {
+    std::error_code error;
+    std::filesystem::remove(path_, error);
+  }
+
+  const std::filesystem::path& path() const { return path_; }
+
+ private:
+  const std::filesystem::path path_;
+};
+
+template<typename Shape>
+std::string MakeText(int size) {
+  std::string text;
+  ABSL_CHECK(::google::protobuf::TextFormat::PrintToString(Shape::Make(size), &text));
+  return text;
+}
+
+template<typename Shape>
+void BM_ParseText(benchmark::State& state) {
+  using ProtoType = typename Shape::ProtoType;
+  const std::string text = MakeText<Shape>(static_cast<int>(state.range(0)));
+  AllocationCounter counter(state);
+  for (auto _ : state) {
+    absl::StatusOr<ProtoType> proto = ParseText<ProtoType>(text);
+    benchmark::DoNotOptimize(proto);
+  }
+  counter.Finish(text.size());
+}
+
+template<typename Shape>
+void BM_ParseTextProtoOrDie(benchmark::State& state) {
+  using ProtoType = typename Shape::ProtoType;
+  const std::string text = MakeText<Shape>(static_cast<int>(state.range(0)));
+  AllocationCounter counter(state);
+  for (auto _ : state) {
+    ProtoType proto = ParseTextProtoOrDie(text);
+    benchmark::DoNotOptimize(proto);
+  }
+  counter.Finish(text.size());
+}
+
+template<typename Shape>
+void BM_WriteBinaryProtoFile(benchmark::State& state) {
+  const auto proto = Shape::Make(static_cast<int>(state.range(0)));
+  const TempFile file("write.pb");
+  const std::filesystem::path& filename = file.path();
+  AllocationCounter counter(state);
+  for (auto _ : state) {
+    ABSL_CHECK_OK(WriteBinaryProtoFile(filename, proto));
+  }
+  counter.Finish(std::filesystem::file_size(filename));
+}
+
+template<typename Shape>
+void BM_ReadBinaryProtoFile(benchmark::State& state) {
+  using ProtoType = typename Shape::ProtoType;
+  const auto proto = Shape::Make(static_cast<int>(state.range(0)));
+  const TempFile file("read.pb");
+  const std::filesystem::path& filename = file.path();
+  ABSL_CHECK_OK(WriteBinaryProtoFile(filename, proto));
+  AllocationCounter counter(state);
+  for (auto _ : state) {
+    absl::StatusOr<ProtoType> result = ReadBinaryProtoFile(filename);
+    benchmark::DoNotOptimize(result);
+  }
+  counter.Finish(std::filesystem::file_size(filename));
+}
+
+template<typename Shape>
+void BM_WriteTextProtoFile(benchmark::State& state) {
+  const auto proto = Shape::Make(static_cast<int>(state.range(0)));
+  const TempFile file("write.txtpb");
+  const std::filesystem::path& filename = file.path();
+  AllocationCounter counter(state);
+  for (auto _ : state) {
+    ABSL_CHECK_OK(WriteTextProtoFile(filename, proto));
+  }
+  counter.Finish(std::filesystem::file_size(filename));
+}
+
+template<typename Shape>
+void BM_ReadTextProtoFile(benchmark::State& state) {
+  using ProtoType = typename Shape::ProtoType;
+  const auto proto = Shape::Make(static_cast<int>(state.range(0)));
+  const TempFile file("read.txtpb");
+  const std::filesystem::path& filename = file.path();
+  ABSL_CHECK_OK(WriteTextProtoFile(filename, proto));
+  AllocationCounter counter(state);
+  for (auto _ : state) {
+    absl::StatusOr<ProtoType> result = ReadTextProtoFile(filename);
+    benchmark::DoNotOptimize(result);
+  }
+  counter.Finish(std::filesystem::file_size(filename));
+}
+
+// Matches two equal messages, so that the matchers have to compare everything.
+template<typename Shape, typename MakeMatcher>
+void RunMatcher(benchmark::State& state, MakeMatcher&& make_matcher) {
+  const auto actual = Shape::Make(static_cast<int>(state.range(0)));
+  const auto expected = Shape::Make(static_cast<int>(state.range(0)));
+  const ::testing::Matcher<const typename Shape::ProtoType&> matcher = make_matcher(expected);
+  AllocationCounter counter(state);
+  for (auto _ : state) {
+    ABSL_CHECK(matcher.Matches(actual));
+  }
+  counter.Finish(actual.ByteSizeLong());
+}
+
+template<typename Shape>
+void BM_EqualsProto(benchmark::State& state) {
+  RunMatcher<Shape>(state, [](const auto& expected) { return EqualsProto(expected); });
+}
+
+template<typename Shape>
+void BM_Approximately(benchmark::State& state) {
+  RunMatcher<Shape>(state, [](const auto& expected) { return Approximately(EqualsProto(expected)); });
+}
+
+template<typename Shape>
+void BM_IgnoringRepeatedFieldOrdering(benchmark::State& state) {
+  RunMatcher<Shape>(state, [](const auto& expected) { return IgnoringRepeatedFieldOrdering(EqualsProto(expected)); });
+}
+
+template<typename Shape>
+void BM_Partially(benchmark::State& state) {
+  RunMatcher<Shape>(state, [](const auto& expected) { return Partially(EqualsProto(expected)); });
+}
+
+// Message sizes from a single element to a multi-megabyte text file.
+void Sizes(benchmark::internal::Benchmark* benchmark) {
+  benchmark->RangeMultiplier(16)->Range(1, 1 << 16);
+}
+
+// NOLINTNEXTLINE(cppcoreguidelines-macro-usage)
+#define MBO_PROTO_BENCHMARK(func)                    \
+  BENCHMARK_TEMPLATE(func, FlatShape)->Apply(Sizes); \
+  BENCHMARK_TEMPLATE(func, NestedShape)->Apply(Sizes)
+
+MBO_PROTO_BENCHMARK(BM_ParseText);
+MBO_PROTO_BENCHMARK(BM_ParseTextProtoOrDie);
+MBO_PROTO_BENCHMARK(BM_WriteBinaryProtoFile);
+MBO_PROTO_BENCHMARK(BM_ReadBinaryProtoFile);
+MBO_PROTO_BENCHMARK(BM_WriteTextProtoFile);
+MBO_PROTO_BENCHMARK(BM_ReadTextProtoFile);
+MBO_PROTO_BENCHMARK(BM_EqualsProto);
+MBO_PROTO_BENCHMARK(BM_Approximately);
+MBO_PROTO_BENCHMARK(BM_IgnoringRepeatedFieldOrdering);
+MBO_PROTO_BENCHMARK(BM_Partially);
+
+#undef MBO_PROTO_BENCHMARK
+
+// NOLINTEND(*-magic-numbers)
+}  // namespace
+}  // namespace mbo::proto
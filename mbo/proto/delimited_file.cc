@@ -0,0 +1,128 @@
+// SPDX-FileCopyrightText: Copyright (c) The helly25/mbo authors (helly25.com)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mbo/proto/delimited_file.h"
+
+#include <fcntl.h>
+
+#include <filesystem>
+#include <memory>
+#include <source_location>
+#include <string>
+#include <utility>
+
+#include "absl/log/absl_log.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_format.h"
+#include "google/protobuf/io/zero_copy_stream_impl.h"
+#include "google/protobuf/message.h"
+#include "google/protobuf/util/delimited_message_util.h"
+#include "mbo/proto/file.h"
+
+namespace mbo::proto {
+
+using ::mbo::proto::proto_internal::SrcLoc;
+
+namespace proto_internal {
+
+DelimitedProtoFileReader::DelimitedProtoFileReader(std::filesystem::path filename, const std::source_location& src_loc)
+    : filename_(std::move(filename)), src_loc_(src_loc) {
+  const int fd = ::open(filename_.c_str(), O_RDONLY | O_CLOEXEC);  // NOLINT(*-vararg)
+  if (fd < 0) {
+    status_ = absl::NotFoundError(absl::StrFormat("Cannot open '%s' @ %s", filename_, SrcLoc(src_loc_)));
+    return;
+  }
+  auto input = std::make_unique<::google::protobuf::io::FileInputStream>(fd);
+  input->SetCloseOnDelete(true);
+  input_ = std::move(input);
+}
+
+DelimitedProtoFileReader::~DelimitedProtoFileReader() = default;
+
+bool DelimitedProtoFileReader::Next(::google::protobuf::Message& message) {
+  if (!status_.ok() || input_ == nullptr) {
+    return false;
+  }
+  bool clean_eof = false;
+  if (::google::protobuf::util::ParseDelimitedFromZeroCopyStream(&message, input_.get(), &clean_eof)) {
+    ++index_;
+    return true;
+  }
+  input_.reset();
+  if (!clean_eof) {
+    status_ = absl::AbortedError(absl::StrFormat(
+        "Cannot parse delimited proto #%d from file '%s' @ %s.", index_, filename_, SrcLoc(src_loc_)));
+  }
+  return false;
+}
+
+}  // namespace proto_internal
+
+absl::StatusOr<DelimitedProtoFileWriter> DelimitedProtoFileWriter::Open(
+    const std::filesystem::path& filename,
+    const std::source_location& src_loc) {
+  // NOLINTNEXTLINE(*-vararg)
+  const int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+  if (fd < 0) {
+    return absl::AbortedError(absl::StrFormat("Cannot open '%s' for writing @ %s.", filename, SrcLoc(src_loc)));
+  }
+  return DelimitedProtoFileWriter(filename, src_loc, fd);
+}
+
+DelimitedProtoFileWriter::DelimitedProtoFileWriter(
+    std::filesystem::path filename,
+    const std::source_location& src_loc,
+    int fd)
+    : filename_(std::move(filename)),
+      src_loc_(src_loc),
+      output_(std::make_unique<::google::protobuf::io::FileOutputStream>(fd)) {}
+
+DelimitedProtoFileWriter::DelimitedProtoFileWriter(DelimitedProtoFileWriter&&) noexcept = default;
+
+DelimitedProtoFileWriter::~DelimitedProtoFileWriter() {
+  if (output_ != nullptr) {
+    const absl::Status status = Close();
+    ABSL_LOG_IF(ERROR, !status.ok()) << status;
+  }
+}
+
+absl::Status DelimitedProtoFileWriter::Write(const ::google::protobuf::Message& message) {
+  if (output_ == nullptr) {
+    return absl::FailedPreconditionError(
+        absl::StrFormat("Cannot write to closed file '%s' @ %s.", filename_, SrcLoc(src_loc_)));
+  }
+  if (!::google::protobuf::util::SerializeDelimitedToZeroCopyStream(message, output_.get())) {
+    return absl::AbortedError(absl::StrFormat(
+        "Cannot write delimited proto #%d to file '%s' @ %s.", index_, filename_, SrcLoc(src_loc_)));
+  }
+  ++index_;
+  return absl::OkStatus();
+}
+
+absl::Status DelimitedProtoFileWriter::Close() {
+  if (output_ == nullptr) {
+    return absl::FailedPreconditionError(
+        absl::StrFormat("Cannot close already closed file '%s' @ %s.", filename_, SrcLoc(src_loc_)));
+  }
+  const std::unique_ptr<::google::protobuf::io::FileOutputStream> output = std::move(output_);
+  if (!output->Close()) {
+    return absl::AbortedError(
+        absl::StrFormat("Cannot write delimited proto file '%s' @ %s.", filename_, SrcLoc(src_loc_)));
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace mbo::proto
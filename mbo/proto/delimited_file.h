@@ -0,0 +1,234 @@
+// SPDX-FileCopyrightText: Copyright (c) The helly25/mbo authors (helly25.com)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MBO_PROTO_DELIMITED_FILE_H_
+#define MBO_PROTO_DELIMITED_FILE_H_
+
+#include <cstddef>
+#include <filesystem>
+#include <iterator>
+#include <memory>
+#include <source_location>
+#include <utility>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "google/protobuf/io/zero_copy_stream.h"
+#include "google/protobuf/io/zero_copy_stream_impl.h"
+#include "google/protobuf/message.h"
+#include "mbo/proto/file.h"
+
+// Functionality for reading and writing files of length-delimited protos:
+// - struct  ReadDelimitedProtoFileOptions
+// - class   ReadDelimitedProtoFile
+// - class   DelimitedProtoFileWriter
+//
+// The file format is a plain sequence of messages, each prefixed with its size
+// as a varint. This is compatible with Java's `writeDelimitedTo` and with
+// `google::protobuf::util::SerializeDelimitedToZeroCopyStream`.
+
+namespace mbo::proto {
+namespace proto_internal {
+
+// Type erased sequential reader for files of length-delimited messages.
+class DelimitedProtoFileReader final {
+ public:
+  DelimitedProtoFileReader(std::filesystem::path filename, const std::source_location& src_loc);
+
+  DelimitedProtoFileReader(const DelimitedProtoFileReader&) = delete;
+  DelimitedProtoFileReader& operator=(const DelimitedProtoFileReader&) = delete;
+  DelimitedProtoFileReader(DelimitedProtoFileReader&&) = delete;
+  DelimitedProtoFileReader& operator=(DelimitedProtoFileReader&&) = delete;
+
+  ~DelimitedProtoFileReader();
+
+  // Reads the next message into `message` which must be empty. Returns false at the end of the
+  // file or if an error occurred, in which case `status` will be set.
+  bool Next(::google::protobuf::Message& message);
+
+  // The status of the reader. Any error is final.
+  const absl::Status& status() const { return status_; }
+
+ private:
+  const std::filesystem::path filename_;
+  const std::source_location src_loc_;
+  std::unique_ptr<::google::protobuf::io::ZeroCopyInputStream> input_;
+  absl::Status status_;
+  std::size_t index_ = 0;
+};
+
+}  // namespace proto_internal
+
+// Options for reading files of length-delimited protos.
+struct ReadDelimitedProtoFileOptions {
+  // Reuse a single message object for all records. The message gets cleared before each record is
+  // read, which keeps the allocated capacity of strings and repeated fields. Otherwise a new message
+  // is created for each record, so that records can be moved out of the iteration.
+  bool reuse_message = false;
+};
+
+// Input range over a file of length-delimited protos.
+//
+// Records are read lazily while iterating, so memory is bounded by a single
+// message. The iteration stops at the end of the file or at the first error.
+// Once iteration finished, `status` tells whether the whole file was read.
+//
+// Example:
+//
+// ```c++
+// ReadDelimitedProtoFile<MyProto> records(filename, {.reuse_message = true});
+// for (const MyProto& record : records) {
+//   Process(record);
+// }
+// if (!records.status().ok()) {
+//   return records.status();
+// }
+// ```
+template<IsProtoType ProtoType>
+class ReadDelimitedProtoFile final {
+ public:
+  class iterator final {  // NOLINT(readability-identifier-naming)
+   public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = ProtoType;
+    using difference_type = std::ptrdiff_t;
+    using pointer = ProtoType*;
+    using reference = ProtoType&;
+
+    iterator() = default;
+
+    reference operator*() const { return file_->message_; }
+
+    pointer operator->() const { return &file_->message_; }
+
+    iterator& operator++() {
+      if (!file_->Advance()) {
+        file_ = nullptr;
+      }
+      return *this;
+    }
+
+    void operator++(int) { ++*this; }
+
+    friend bool operator==(const iterator& it, std::default_sentinel_t /*unused*/) { return it.file_ == nullptr; }
+
+   private:
+    friend class ReadDelimitedProtoFile;
+
+    explicit iterator(ReadDelimitedProtoFile* file) : file_(file) {}
+
+    ReadDelimitedProtoFile* file_ = nullptr;
+  };
+
+  explicit ReadDelimitedProtoFile(
+      std::filesystem::path filename,
+      const std::source_location& src_loc = std::source_location::current())
+      : ReadDelimitedProtoFile(std::move(filename), ReadDelimitedProtoFileOptions{}, src_loc) {}
+
+  ReadDelimitedProtoFile(
+      std::filesystem::path filename,
+      const ReadDelimitedProtoFileOptions& options,
+      const std::source_location& src_loc = std::source_location::current())
+      : options_(options), reader_(std::move(filename), src_loc) {}
+
+  ReadDelimitedProtoFile(const ReadDelimitedProtoFile&) = delete;
+  ReadDelimitedProtoFile& operator=(const ReadDelimitedProtoFile&) = delete;
+  ReadDelimitedProtoFile(ReadDelimitedProtoFile&&) = delete;
+  ReadDelimitedProtoFile& operator=(ReadDelimitedProtoFile&&) = delete;
+
+  ~ReadDelimitedProtoFile() = default;
+
+  // Starts the iteration by reading the first record. This is an input range,
+  // so it can only be iterated once.
+  iterator begin() {  // NOLINT(readability-identifier-naming)
+    if (started_) {
+      return iterator();
+    }
+    started_ = true;
+    return Advance() ? iterator(this) : iterator();
+  }
+
+  std::default_sentinel_t end() const { return {}; }  // NOLINT(readability-identifier-naming)
+
+  // The error, if any, that stopped the iteration.
+  const absl::Status& status() const { return reader_.status(); }  // NOLINT(readability-identifier-naming)
+
+ private:
+  bool Advance() {
+    if (options_.reuse_message) {
+      message_.Clear();
+    } else {
+      message_ = ProtoType();
+    }
+    return reader_.Next(message_);
+  }
+
+  const ReadDelimitedProtoFileOptions options_;
+  proto_internal::DelimitedProtoFileReader reader_;
+  ProtoType message_;
+  bool started_ = false;
+};
+
+// Writes length-delimited protos to a file.
+//
+// Example:
+//
+// ```c++
+// absl::StatusOr<DelimitedProtoFileWriter> writer = DelimitedProtoFileWriter::Open(filename);
+// if (!writer.ok()) {
+//   return writer.status();
+// }
+// for (const MyProto& record : records) {
+//   if (absl::Status status = writer->Write(record); !status.ok()) {
+//     return status;
+//   }
+// }
+// return writer->Close();
+// ```
+class DelimitedProtoFileWriter final {
+ public:
+  // Creates (or truncates) `filename` for writing.
+  static absl::StatusOr<DelimitedProtoFileWriter> Open(
+      const std::filesystem::path& filename,
+      const std::source_location& src_loc = std::source_location::current());
+
+  DelimitedProtoFileWriter() = delete;
+
+  DelimitedProtoFileWriter(const DelimitedProtoFileWriter&) = delete;
+  DelimitedProtoFileWriter& operator=(const DelimitedProtoFileWriter&) = delete;
+  DelimitedProtoFileWriter(DelimitedProtoFileWriter&&) noexcept;
+  DelimitedProtoFileWriter& operator=(DelimitedProtoFileWriter&&) = delete;
+
+  // Closes the file if it was not closed explicitly. Errors will only be logged.
+  ~DelimitedProtoFileWriter();
+
+  // Appends `message` as a length-delimited record.
+  absl::Status Write(const ::google::protobuf::Message& message);
+
+  // Flushes all buffered data and closes the file. Must be called to detect write errors.
+  absl::Status Close();
+
+ private:
+  DelimitedProtoFileWriter(std::filesystem::path filename, const std::source_location& src_loc, int fd);
+
+  std::filesystem::path filename_;
+  std::source_location src_loc_;
+  std::unique_ptr<::google::protobuf::io::FileOutputStream> output_;
+  std::size_t index_ = 0;
+};
+
+}  // namespace mbo::proto
+
+#endif  // MBO_PROTO_DELIMITED_FILE_H_
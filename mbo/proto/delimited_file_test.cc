@@ -0,0 +1,144 @@
+// SPDX-FileCopyrightText: Copyright (c) The helly25/mbo authors (helly25.com)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mbo/proto/delimited_file.h"
+
+#include <filesystem>
+#include <fstream>
+#include <ios>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "mbo/proto/matchers.h"
+#include "mbo/proto/status_matchers.h"
+#include "mbo/proto/tests/simple_message.pb.h"
+
+namespace mbo::proto {
+namespace {
+// NOLINTBEGIN(*-magic-numbers)
+
+using ::mbo::proto::EqualsProto;
+using ::mbo::proto::tests::SimpleMessage;
+using ::testing::ElementsAre;
+using ::testing::HasSubstr;
+
+struct DelimitedFileTest : ::testing::Test {
+  static std::vector<SimpleMessage> MakeRecords(int count) {
+    std::vector<SimpleMessage> records;
+    for (int i = 0; i < count; ++i) {
+      SimpleMessage& record = records.emplace_back();
+      record.set_one(i);
+      for (int j = 0; j < i % 3; ++j) {
+        record.add_two(j);
+      }
+    }
+    return records;
+  }
+
+  static void WriteRecords(const std::filesystem::path& filename, const std::vector<SimpleMessage>& records) {
+    absl::StatusOr<DelimitedProtoFileWriter> writer = DelimitedProtoFileWriter::Open(filename);
+    ASSERT_THAT(writer, IsOk());
+    for (const SimpleMessage& record : records) {
+      ASSERT_THAT(writer->Write(record), IsOk());
+    }
+    ASSERT_THAT(writer->Close(), IsOk());
+  }
+};
+
+TEST_F(DelimitedFileTest, WriteAndRead) {
+  const std::vector<SimpleMessage> records = MakeRecords(10);
+  WriteRecords("test.delimited.pb", records);
+  std::vector<SimpleMessage> result;
+  ReadDelimitedProtoFile<SimpleMessage> reader("test.delimited.pb");
+  for (SimpleMessage& record : reader) {
+    result.push_back(std::move(record));
+  }
+  EXPECT_THAT(reader.status(), IsOk());
+  ASSERT_THAT(result.size(), records.size());
+  for (std::size_t i = 0; i < records.size(); ++i) {
+    EXPECT_THAT(result[i], EqualsProto(records[i]));
+  }
+  // An input range can only be iterated once.
+  EXPECT_TRUE(reader.begin() == reader.end());
+}
+
+TEST_F(DelimitedFileTest, ReuseMessage) {
+  const std::vector<SimpleMessage> records = MakeRecords(10);
+  WriteRecords("test.delimited.pb", records);
+  ReadDelimitedProtoFile<SimpleMessage> reader("test.delimited.pb", {.reuse_message = true});
+  std::size_t index = 0;
+  const SimpleMessage* first = nullptr;
+  for (const SimpleMessage& record : reader) {
+    ASSERT_LT(index, records.size());
+    EXPECT_THAT(record, EqualsProto(records[index]));
+    if (first == nullptr) {
+      first = &record;
+    }
+    EXPECT_THAT(&record, first);
+    ++index;
+  }
+  EXPECT_THAT(reader.status(), IsOk());
+  EXPECT_THAT(index, records.size());
+}
+
+TEST_F(DelimitedFileTest, Empty) {
+  WriteRecords("empty.delimited.pb", {});
+  ReadDelimitedProtoFile<SimpleMessage> reader("empty.delimited.pb");
+  EXPECT_TRUE(reader.begin() == reader.end());
+  EXPECT_THAT(reader.status(), IsOk());
+}
+
+TEST_F(DelimitedFileTest, WriterErrors) {
+  absl::StatusOr<DelimitedProtoFileWriter> writer = DelimitedProtoFileWriter::Open("test.delimited.pb");
+  ASSERT_THAT(writer, IsOk());
+  ASSERT_THAT(writer->Close(), IsOk());
+  EXPECT_THAT(
+      writer->Write(SimpleMessage()), StatusIs(absl::StatusCode::kFailedPrecondition, HasSubstr("closed file")));
+  EXPECT_THAT(writer->Close(), StatusIs(absl::StatusCode::kFailedPrecondition, HasSubstr("closed file")));
+  EXPECT_THAT(
+      DelimitedProtoFileWriter::Open("does/not/exist.pb"),
+      StatusIs(absl::StatusCode::kAborted, HasSubstr("Cannot open 'does/not/exist.pb' for writing")));
+}
+
+TEST_F(DelimitedFileTest, ReaderErrors) {
+  {
+    ReadDelimitedProtoFile<SimpleMessage> reader("DoesNotExist.pb");
+    EXPECT_TRUE(reader.begin() == reader.end());
+    EXPECT_THAT(reader.status(), StatusIs(absl::StatusCode::kNotFound, HasSubstr("Cannot open 'DoesNotExist.pb'")));
+  }
+  {
+    const std::vector<SimpleMessage> records = MakeRecords(2);
+    WriteRecords("truncated.pb", records);
+    std::ofstream output("truncated.pb", std::ios::binary | std::ios::app);
+    output << std::string_view("\x05\x08", 2);  // Announces 5 bytes but has only 1.
+    output.close();
+    ReadDelimitedProtoFile<SimpleMessage> reader("truncated.pb");
+    std::vector<int> ones;
+    for (const SimpleMessage& record : reader) {
+      ones.push_back(record.one());
+    }
+    EXPECT_THAT(ones, ElementsAre(0, 1));
+    EXPECT_THAT(
+        reader.status(),
+        StatusIs(absl::StatusCode::kAborted, HasSubstr("Cannot parse delimited proto #2 from file 'truncated.pb'")));
+  }
+}
+
+// NOLINTEND(*-magic-numbers)
+}  // namespace
+}  // namespace mbo::proto
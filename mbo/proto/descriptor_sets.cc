@@ -0,0 +1,55 @@
+// SPDX-FileCopyrightText: Copyright (c) The helly25/mbo authors (helly25.com)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mbo/proto/descriptor_sets.h"
+
+#include <filesystem>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_format.h"
+#include "google/protobuf/descriptor.pb.h"
+#include "google/protobuf/descriptor_database.h"
+#include "mbo/proto/file.h"
+
+namespace mbo::proto::proto_internal {
+
+absl::Status LoadDescriptorSets(
+    const std::vector<std::filesystem::path>& descriptor_sets,
+    ::google::protobuf::SimpleDescriptorDatabase& database) {
+  for (const std::filesystem::path& filename : descriptor_sets) {
+    const absl::StatusOr<::google::protobuf::FileDescriptorSet> file_set =
+        ReadBinaryProtoFile::As<::google::protobuf::FileDescriptorSet>(filename);
+    if (!file_set.ok()) {
+      return file_set.status();
+    }
+    for (const ::google::protobuf::FileDescriptorProto& file : file_set->file()) {
+      ::google::protobuf::FileDescriptorProto known;
+      if (database.FindFileByName(file.name(), &known)) {
+        if (known.SerializeAsString() == file.SerializeAsString()) {
+          continue;
+        }
+      }
+      if (!database.Add(file)) {
+        return absl::InvalidArgumentError(
+            absl::StrFormat("Conflicting definitions of '%s' in '%s'.", file.name(), filename));
+      }
+    }
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace mbo::proto::proto_internal
@@ -0,0 +1,37 @@
+// SPDX-FileCopyrightText: Copyright (c) The helly25/mbo authors (helly25.com)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MBO_PROTO_DESCRIPTOR_SETS_H_
+#define MBO_PROTO_DESCRIPTOR_SETS_H_
+
+// IWYU pragma: private
+
+#include <filesystem>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "google/protobuf/descriptor_database.h"
+
+namespace mbo::proto::proto_internal {
+
+// Adds the files of the binary `FileDescriptorSet`s in `descriptor_sets` to `database`. Transitive
+// descriptor sets repeat common dependencies, so identical files are accepted more than once.
+absl::Status LoadDescriptorSets(
+    const std::vector<std::filesystem::path>& descriptor_sets,
+    ::google::protobuf::SimpleDescriptorDatabase& database);
+
+}  // namespace mbo::proto::proto_internal
+
+#endif  // MBO_PROTO_DESCRIPTOR_SETS_H_
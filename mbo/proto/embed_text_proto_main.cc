@@ -0,0 +1,244 @@
+// SPDX-FileCopyrightText: Copyright (c) The helly25/mbo authors (helly25.com)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Converts text proto files into a C++ header that embeds them in binary wire format.
+//
+// Usage:
+//   embed_text_proto --message=<full.Name> --namespace=<cpp::ns> --output=<file> [--header=<include path>]
+//                    --descriptor_set=<file> [--descriptor_set=<file>...] <text proto>...
+//
+// The `--header` is the path under which the output gets included. It determines the header guard
+// and defaults to the `--output` path.
+//
+// This is the tool behind the Bazel macro `cc_embedded_text_proto`, see "mbo/proto/embedded_proto.h".
+
+#include <cctype>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <ios>
+#include <iostream>
+#include <memory>
+#include <source_location>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/escaping.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/strip.h"
+#include "google/protobuf/descriptor.h"
+#include "google/protobuf/descriptor_database.h"
+#include "google/protobuf/dynamic_message.h"
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
+#include "google/protobuf/message.h"
+#include "mbo/proto/descriptor_sets.h"
+#include "mbo/proto/file.h"
+
+namespace mbo::proto {
+namespace {
+
+struct Args {
+  std::string message;
+  std::string cpp_namespace;
+  std::filesystem::path output;
+  std::string header;
+  std::vector<std::filesystem::path> descriptor_sets;
+  std::vector<std::filesystem::path> inputs;
+};
+
+absl::StatusOr<Args> ParseArgs(int argc, char** argv) {
+  Args args;
+  for (int i = 1; i < argc; ++i) {
+    std::string_view arg = argv[i];  // NOLINT(*-pointer-arithmetic)
+    if (arg.starts_with("--message=")) {
+      args.message = arg.substr(arg.find('=') + 1);
+    } else if (arg.starts_with("--namespace=")) {
+      args.cpp_namespace = arg.substr(arg.find('=') + 1);
+    } else if (arg.starts_with("--output=")) {
+      args.output = arg.substr(arg.find('=') + 1);
+    } else if (arg.starts_with("--header=")) {
+      args.header = arg.substr(arg.find('=') + 1);
+    } else if (arg.starts_with("--descriptor_set=")) {
+      args.descriptor_sets.emplace_back(arg.substr(arg.find('=') + 1));
+    } else if (arg.starts_with("--")) {
+      return absl::InvalidArgumentError(absl::StrFormat("Unknown flag '%s'.", arg));
+    } else {
+      args.inputs.emplace_back(arg);
+    }
+  }
+  if (args.message.empty() || args.output.empty() || args.descriptor_sets.empty()) {
+    return absl::InvalidArgumentError("Flags --message, --output and --descriptor_set are required.");
+  }
+  return args;
+}
+
+// Serializes `message` deterministically, so that builds are reproducible even with map fields.
+std::string SerializeDeterministic(const ::google::protobuf::Message& message) {
+  std::string data;
+  {
+    ::google::protobuf::io::StringOutputStream stream(&data);
+    ::google::protobuf::io::CodedOutputStream output(&stream);
+    output.SetSerializationDeterministic(true);
+    message.ByteSizeLong();  // Computes the cached sizes.
+    message.SerializeWithCachedSizes(&output);
+  }
+  return data;
+}
+
+// Converts the basename of `filename` up to the first '.' into a CamelCase identifier.
+std::string StructName(const std::filesystem::path& filename) {
+  const std::string stem = filename.filename().string();
+  std::string name;
+  bool upper = true;
+  for (const char chr : std::string_view(stem).substr(0, stem.find('.'))) {
+    if (std::isalnum(static_cast<unsigned char>(chr)) == 0) {
+      upper = true;
+      continue;
+    }
+    name += upper ? static_cast<char>(std::toupper(static_cast<unsigned char>(chr))) : chr;
+    upper = false;
+  }
+  if (name.empty() || std::isdigit(static_cast<unsigned char>(name.front())) != 0) {
+    name.insert(0, "Embedded");
+  }
+  return name;
+}
+
+std::string HeaderGuard(std::string_view header) {
+  std::string guard;
+  for (const char chr : header) {
+    const auto byte = static_cast<unsigned char>(chr);
+    guard += std::isalnum(byte) != 0 ? static_cast<char>(std::toupper(byte)) : '_';
+  }
+  return guard + "_";
+}
+
+// Returns `data` as a sequence of string literals, one per line. Octal escapes always have three
+// digits, so unlike hex escapes they never swallow the next byte.
+std::string CppStringLiterals(std::string_view data) {
+  static constexpr std::size_t kBytesPerLine = 32;
+  std::string result;
+  for (std::size_t pos = 0; pos < data.size(); pos += kBytesPerLine) {
+    absl::StrAppend(&result, result.empty() ? "" : "\n", "      \"");
+    for (const char chr : data.substr(pos, kBytesPerLine)) {
+      absl::StrAppendFormat(&result, "\\%03o", static_cast<unsigned char>(chr));
+    }
+    result += '"';
+  }
+  return result.empty() ? "      \"\"" : result;
+}
+
+absl::Status Run(const Args& args) {
+  ::google::protobuf::SimpleDescriptorDatabase database;
+  if (absl::Status status = proto_internal::LoadDescriptorSets(args.descriptor_sets, database); !status.ok()) {
+    return status;
+  }
+  const ::google::protobuf::DescriptorPool pool(&database);
+  const ::google::protobuf::Descriptor* descriptor = pool.FindMessageTypeByName(args.message);
+  if (descriptor == nullptr) {
+    return absl::NotFoundError(absl::StrFormat("Cannot find message type '%s'.", args.message));
+  }
+  ::google::protobuf::DynamicMessageFactory factory(&pool);
+  std::string_view proto_file = descriptor->file()->name();
+  if (!absl::ConsumeSuffix(&proto_file, ".proto")) {
+    return absl::InvalidArgumentError(absl::StrFormat(
+        "Cannot determine the generated header for '%s', which does not end in '.proto'.",
+        descriptor->file()->name()));
+  }
+  const std::string proto_header = absl::StrCat(proto_file, ".pb.h");
+
+  const std::string guard = HeaderGuard(args.header.empty() ? args.output.string() : args.header);
+  std::string header = absl::StrFormat(
+      "// Generated by embed_text_proto. DO NOT EDIT!\n"
+      "\n"
+      "#ifndef %s\n"
+      "#define %s\n"
+      "\n"
+      "#include <string_view>\n"
+      "\n"
+      "#include \"%s\"\n"
+      "#include \"mbo/proto/embedded_proto.h\"\n",
+      guard, guard, proto_header);
+  if (!args.cpp_namespace.empty()) {
+    absl::StrAppendFormat(&header, "\nnamespace %s {\n", args.cpp_namespace);
+  }
+  std::string cpp_type = absl::StrCat("::", descriptor->full_name());
+  for (std::size_t pos = cpp_type.find('.'); pos != std::string::npos; pos = cpp_type.find('.', pos)) {
+    cpp_type.replace(pos, 1, "::");
+  }
+  absl::flat_hash_map<std::string, std::filesystem::path> struct_names;
+  for (const std::filesystem::path& input : args.inputs) {
+    const std::string struct_name = StructName(input);
+    if (const auto [it, inserted] = struct_names.emplace(struct_name, input); !inserted) {
+      return absl::InvalidArgumentError(absl::StrFormat(
+          "Text protos '%s' and '%s' would both be embedded as struct '%s'. Rename one of them or put them into "
+          "separate targets.",
+          it->second, input, struct_name));
+    }
+    const std::unique_ptr<::google::protobuf::Message> message(factory.GetPrototype(descriptor)->New());
+    if (absl::Status status = proto_internal::ReadTextProtoFile(input, *message, std::source_location::current());
+        !status.ok()) {
+      return status;
+    }
+    const std::string data = SerializeDeterministic(*message);
+    absl::StrAppendFormat(
+        &header,
+        "\n"
+        "struct %s final {\n"
+        "  using ProtoType = %s;\n"
+        "\n"
+        "  static constexpr std::string_view kSource = \"%s\";\n"
+        "\n"
+        "  static constexpr std::string_view kData{\n"
+        "%s,\n"
+        "      %d};\n"
+        "};\n",
+        struct_name, cpp_type, absl::CEscape(input.string()), CppStringLiterals(data), data.size());
+  }
+  if (!args.cpp_namespace.empty()) {
+    absl::StrAppendFormat(&header, "\n}  // namespace %s\n", args.cpp_namespace);
+  }
+  absl::StrAppendFormat(&header, "\n#endif  // %s\n", guard);
+
+  std::ofstream output(args.output, std::ios::binary | std::ios::trunc);
+  output << header;
+  output.close();
+  if (!output.good()) {
+    return absl::AbortedError(absl::StrFormat("Cannot write '%s'.", args.output));
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace
+}  // namespace mbo::proto
+
+int main(int argc, char** argv) {
+  const absl::StatusOr<mbo::proto::Args> args = mbo::proto::ParseArgs(argc, argv);
+  if (!args.ok()) {
+    std::cerr << args.status() << "\n";
+    return 1;
+  }
+  if (const absl::Status status = mbo::proto::Run(*args); !status.ok()) {
+    std::cerr << status << "\n";
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,100 @@
+# SPDX-FileCopyrightText: Copyright (c) The helly25/mbo authors (helly25.com)
+# SPDX-License-Identifier: Apache-2.0
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Embedding of text protos as binary protos at build time.
+
+The macro `cc_embedded_text_proto` parses text proto files during the build and generates a
+`cc_library` with a header that holds them in binary wire format. See "mbo/proto/embedded_proto.h"
+for how to access them.
+"""
+
+load("@com_google_protobuf//bazel/common:proto_info.bzl", "ProtoInfo")
+load("@rules_cc//cc:defs.bzl", "cc_library")
+
+def _embedded_text_proto_impl(ctx):
+    proto_info = ctx.attr.proto[ProtoInfo]
+    descriptor_sets = proto_info.transitive_descriptor_sets.to_list()
+    args = ctx.actions.args()
+    args.add("--message=" + ctx.attr.message)
+    args.add("--namespace=" + ctx.attr.cpp_namespace)
+    args.add("--output=" + ctx.outputs.out.path)
+    args.add("--header=" + ctx.outputs.out.short_path)
+    args.add_all(descriptor_sets, format_each = "--descriptor_set=%s")
+    args.add_all(ctx.files.srcs)
+    ctx.actions.run(
+        inputs = ctx.files.srcs + descriptor_sets,
+        outputs = [ctx.outputs.out],
+        executable = ctx.executable._tool,
+        arguments = [args],
+        mnemonic = "EmbedTextProto",
+        progress_message = "Embedding text protos into %{output}",
+    )
+    return [DefaultInfo(files = depset([ctx.outputs.out]))]
+
+_embedded_text_proto = rule(
+    implementation = _embedded_text_proto_impl,
+    attrs = {
+        "cpp_namespace": attr.string(mandatory = True),
+        "message": attr.string(mandatory = True),
+        "out": attr.output(mandatory = True),
+        "proto": attr.label(mandatory = True, providers = [ProtoInfo]),
+        "srcs": attr.label_list(allow_files = [".txtpb", ".textproto"], mandatory = True),
+        "_tool": attr.label(
+            default = Label("//mbo/proto:embed_text_proto"),
+            executable = True,
+            cfg = "exec",
+        ),
+    },
+)
+
+def cc_embedded_text_proto(name, srcs, proto, cc_proto, message, cpp_namespace = None, **kwargs):
+    """Creates a `cc_library` that embeds text protos in binary wire format.
+
+    The library has a single header `<name>.h` that has one struct per source. The structs are
+    named after their source in CamelCase (`my_fixture.txtpb` becomes `MyFixture`) and can be
+    read using `mbo::proto::EmbeddedProto<MyFixture>()`. Malformed text protos fail the build, as
+    do sources that result in the same struct name (e.g. `a/config.txtpb` and `b/config.txtpb`).
+
+    Args:
+        name:          Name of the `cc_library`, also used as the basename of the header.
+        srcs:          Text proto files (`.txtpb` or `.textproto`).
+        proto:         The `proto_library` that defines `message`.
+        cc_proto:      The `cc_proto_library` for `proto`.
+        message:       Full name of the message type, e.g. `my.package.MyProto`.
+        cpp_namespace: C++ namespace of the generated structs. Defaults to the package path,
+                       e.g. `my::package` for package `my/package`.
+        **kwargs:      Common attributes like `visibility` and `testonly`.
+    """
+    if cpp_namespace == None:
+        cpp_namespace = native.package_name().replace("/", "::")
+    _embedded_text_proto(
+        name = name + "_gen",
+        srcs = srcs,
+        proto = proto,
+        message = message,
+        cpp_namespace = cpp_namespace,
+        out = name + ".h",
+        testonly = kwargs.get("testonly", False),
+        visibility = ["//visibility:private"],
+    )
+    cc_library(
+        name = name,
+        hdrs = [":" + name + ".h"],
+        deps = [
+            cc_proto,
+            Label("//mbo/proto:embedded_proto_cc"),
+        ],
+        **kwargs
+    )
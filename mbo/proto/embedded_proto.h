@@ -0,0 +1,81 @@
+// SPDX-FileCopyrightText: Copyright (c) The helly25/mbo authors (helly25.com)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MBO_PROTO_EMBEDDED_PROTO_H_
+#define MBO_PROTO_EMBEDDED_PROTO_H_
+
+#include <concepts>
+#include <cstddef>
+#include <limits>
+#include <string_view>
+
+#include "absl/log/absl_check.h"
+#include "google/protobuf/arena.h"
+#include "mbo/proto/file.h"
+
+// Functionality for text protos that were converted to binary at build time:
+// - concept   IsEmbeddedProto
+// - function  EmbeddedProto
+//
+// The Bazel macro `cc_embedded_text_proto` from "@com_helly25_proto//mbo/proto:embedded_proto.bzl"
+// parses each text proto source while building and generates a header with one struct per source.
+// A malformed text proto therefore fails the build rather than the program. The struct is named
+// after the source file in CamelCase (`my_fixture.txtpb` becomes `MyFixture`), which must be unique
+// within the target, and has:
+// - `ProtoType`: The generated message type.
+// - `kSource`:   The path of the text proto source.
+// - `kData`:     The message serialized in binary wire format.
+
+namespace mbo::proto {
+
+// Concept that identifies the structs generated by `cc_embedded_text_proto`.
+template<typename Embedded>
+concept IsEmbeddedProto = IsProtoType<typename Embedded::ProtoType> && requires {
+  { Embedded::kSource } -> std::convertible_to<std::string_view>;
+  { Embedded::kData } -> std::convertible_to<std::string_view>;
+};
+
+// Returns the embedded proto. This is a plain binary parse without any reflection, so it is much
+// cheaper than `ParseTextProtoOrDie` or `ReadTextProtoFile` on the original text.
+//
+// Example:
+//
+// ```c++
+// #include "my/package/my_fixtures.h"  // Generated by `cc_embedded_text_proto(name = "my_fixtures")`.
+//
+// const MyProto proto = EmbeddedProto<my::package::MyFixture>();
+// ```
+template<IsEmbeddedProto Embedded>
+typename Embedded::ProtoType EmbeddedProto() {
+  static_assert(Embedded::kData.size() <= static_cast<std::size_t>(std::numeric_limits<int>::max()));
+  typename Embedded::ProtoType result;
+  ABSL_CHECK(result.ParseFromArray(Embedded::kData.data(), static_cast<int>(Embedded::kData.size())))
+      << "Cannot parse embedded proto from '" << Embedded::kSource << "'.";
+  return result;
+}
+
+// Same as above but creates the message on `arena`.
+template<IsEmbeddedProto Embedded>
+typename Embedded::ProtoType* EmbeddedProto(::google::protobuf::Arena* arena) {
+  static_assert(Embedded::kData.size() <= static_cast<std::size_t>(std::numeric_limits<int>::max()));
+  auto* result = ::google::protobuf::Arena::Create<typename Embedded::ProtoType>(arena);
+  ABSL_CHECK(result->ParseFromArray(Embedded::kData.data(), static_cast<int>(Embedded::kData.size())))
+      << "Cannot parse embedded proto from '" << Embedded::kSource << "'.";
+  return result;
+}
+
+}  // namespace mbo::proto
+
+#endif  // MBO_PROTO_EMBEDDED_PROTO_H_
@@ -0,0 +1,66 @@
+// SPDX-FileCopyrightText: Copyright (c) The helly25/mbo authors (helly25.com)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mbo/proto/embedded_proto.h"
+
+#include <string>
+#include <string_view>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "google/protobuf/arena.h"
+#include "mbo/proto/matchers.h"
+#include "mbo/proto/tests/embedded_fixtures.h"
+#include "mbo/proto/tests/test.pb.h"
+
+namespace mbo::proto {
+namespace {
+
+using ::mbo::proto::EqualsProto;
+using ::mbo::proto::tests::EmbeddedFixture;
+using ::mbo::proto::tests::EmptyFixture;
+using ::mbo::proto::tests::TestMessage2;
+
+static_assert(IsEmbeddedProto<EmbeddedFixture>);
+static_assert(IsEmbeddedProto<EmptyFixture>);
+static_assert(!IsEmbeddedProto<TestMessage2>);
+
+TEST(EmbeddedProtoTest, Read) {
+  EXPECT_THAT(EmbeddedFixture::kSource, "mbo/proto/tests/embedded_fixture.txtpb");
+  const TestMessage2 message = EmbeddedProto<EmbeddedFixture>();
+  EXPECT_THAT(message, EqualsProto(R"pb(
+    num: [ 1, 2, 3 ]
+    one { name: "one" num: 1 val: 1.5 }
+    more { name: "a\000b" }
+  )pb"));
+  EXPECT_THAT(message.more(0).name(), std::string_view("a\0b", 3));
+  EXPECT_THAT(EmbeddedFixture::kData, message.SerializeAsString());
+}
+
+TEST(EmbeddedProtoTest, Empty) {
+  EXPECT_THAT(EmptyFixture::kData, "");
+  EXPECT_THAT(EmbeddedProto<EmptyFixture>(), EqualsProto(TestMessage2()));
+}
+
+TEST(EmbeddedProtoTest, Arena) {
+  ::google::protobuf::Arena arena;
+  const TestMessage2* message = EmbeddedProto<EmbeddedFixture>(&arena);
+  ASSERT_THAT(message, ::testing::NotNull());
+  EXPECT_THAT(message->GetArena(), &arena);
+  EXPECT_THAT(*message, EqualsProto(EmbeddedProto<EmbeddedFixture>()));
+}
+
+}  // namespace
+}  // namespace mbo::proto
@@ -15,41 +15,140 @@
 
 #include "mbo/proto/file.h"
 
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
 #include <fstream>
+#include <limits>
+#include <optional>
 #include <source_location>
+#include <string>
+#include <string_view>
+#include <utility>
 
 #include "absl/status/status.h"
 #include "absl/strings/str_format.h"
+#include "google/protobuf/io/gzip_stream.h"
+#include "google/protobuf/io/zero_copy_stream.h"
 #include "google/protobuf/io/zero_copy_stream_impl.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
 #include "google/protobuf/message.h"
 #include "google/protobuf/text_format.h"
+#include "google/protobuf/util/json_util.h"
+#include "mbo/proto/mapped_file.h"
 #include "mbo/proto/silent_error_collector.h"
 
 namespace mbo::proto {
 namespace {
 
-std::string SrcLoc(const std::source_location& sloc) {
-  return absl::StrFormat("%s:%d", sloc.file_name(), sloc.line());
+using ::mbo::proto::proto_internal::SrcLoc;
+
+constexpr std::string_view kGzipExtension = ".gz";
+
+std::string_view StripGzipExtension(std::string_view filename) {
+  if (HasGzipExtension(filename)) {
+    filename.remove_suffix(kGzipExtension.size());
+  }
+  return filename;
 }
 
-bool PrintTextMessage(const ::google::protobuf::Message& proto, std::ofstream& output) {
-  ::google::protobuf::io::OstreamOutputStream zstream(&output);
-  return ::google::protobuf::TextFormat::Print(proto, &zstream);
+// Corrupt or truncated compressed data ends the stream like a regular end of input, so the zlib
+// status must be checked separately. Negative zlib codes are errors.
+bool HasGzipError(const ::google::protobuf::io::GzipInputStream& gzip) {
+  return gzip.ZlibErrorCode() < 0;
 }
 
-}  // namespace
+// Writes to the open `fd` using `write`, which receives the output stream, and closes `fd`. If
+// `gzip` is set, then the data gets compressed while it is being written.
+template<typename WriteFunc>
+bool WriteFd(int fd, bool gzip, const WriteProtoFileOptions& options, WriteFunc&& write) {
+  ::google::protobuf::io::FileOutputStream output(fd, options.buffer_size > 0 ? options.buffer_size : -1);
+  bool written = false;
+  if (gzip) {
+    ::google::protobuf::io::GzipOutputStream gzip_output(&output);
+    written = write(gzip_output) && gzip_output.Close();
+  } else {
+    written = write(output);
+  }
+  written = written && output.Flush() && (!options.fsync || ::fsync(fd) == 0);
+  return output.Close() && written;
+}
 
-namespace proto_internal {
+// Creates a new file next to `filename`, so that it can later be renamed onto `filename`. If
+// `filename` exists, then the new file gets its permissions, so that replacing it keeps them.
+// Returns the open descriptor, or -1 on error.
+int OpenTempFile(const std::filesystem::path& filename, std::filesystem::path& temp_filename) {
+  static std::atomic<unsigned> counter{0};
+  static constexpr int kMaxAttempts = 100;
+  for (int attempt = 0; attempt < kMaxAttempts; ++attempt) {
+    temp_filename = filename;
+    temp_filename += absl::StrFormat(".tmp.%d.%d", ::getpid(), counter++);
+    const int fd = ::open(temp_filename.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);  // NOLINT(*-vararg)
+    if (fd < 0) {
+      if (errno == EEXIST) {
+        continue;
+      }
+      return fd;
+    }
+    struct stat target{};
+    if (::stat(filename.c_str(), &target) == 0 && ::fchmod(fd, target.st_mode & 07777) != 0) {
+      ::close(fd);
+      ::unlink(temp_filename.c_str());
+      return -1;
+    }
+    return fd;
+  }
+  return -1;
+}
 
-absl::Status ReadBinaryProtoFile(
+// Makes a completed rename durable.
+bool SyncParentDirectory(const std::filesystem::path& filename) {
+  const std::filesystem::path parent = filename.has_parent_path() ? filename.parent_path() : ".";
+  const int fd = ::open(parent.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);  // NOLINT(*-vararg)
+  if (fd < 0) {
+    return false;
+  }
+  const bool synced = ::fsync(fd) == 0;
+  ::close(fd);
+  return synced;
+}
+
+// Creates `filename` and writes it using `write`, which receives the output stream. If `filename`
+// has a gzip extension, then the data gets compressed while it is being written.
+template<typename WriteFunc>
+bool WriteFile(const std::filesystem::path& filename, const WriteProtoFileOptions& options, WriteFunc&& write) {
+  const bool gzip = HasGzipExtension(filename);
+  if (!options.atomic) {
+    // NOLINTNEXTLINE(*-vararg)
+    const int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    return fd >= 0 && WriteFd(fd, gzip, options, std::forward<WriteFunc>(write));
+  }
+  std::filesystem::path temp_filename;
+  const int fd = OpenTempFile(filename, temp_filename);
+  if (fd < 0) {
+    return false;
+  }
+  if (!WriteFd(fd, gzip, options, std::forward<WriteFunc>(write))
+      || ::rename(temp_filename.c_str(), filename.c_str()) != 0) {
+    ::unlink(temp_filename.c_str());
+    return false;
+  }
+  return !options.fsync || SyncParentDirectory(filename);
+}
+
+absl::Status CheckBinaryProtoParsed(
+    bool parsed,
     const std::filesystem::path& filename,
-    ::google::protobuf::Message& result,
+    const ::google::protobuf::Message& result,
     const std::source_location& src_loc) {
-  std::ifstream input(filename, std::ios::binary);
-  if (!input.good()) {
-    return absl::NotFoundError(absl::StrFormat("Cannot open '%s' @ %s", filename, SrcLoc(src_loc)));
-  }
-  if (!result.ParseFromIstream(&input)) {
+  if (!parsed) {
     return absl::AbortedError(absl::StrFormat("Cannot parse binary proto file '%s' @%s.", filename, SrcLoc(src_loc)));
   }
   if (!result.IsInitialized()) {
@@ -60,48 +159,328 @@ absl::Status ReadBinaryProtoFile(
   return absl::OkStatus();
 }
 
-absl::Status ReadTextProtoFile(
+// Calls `parse` with `input`, which gets decompressed if `filename` has a gzip extension. The `kind`
+// names the file kind for error messages.
+template<typename ParseFunc>
+absl::Status ParseMaybeCompressed(
+    ::google::protobuf::io::ZeroCopyInputStream& input,
+    const std::filesystem::path& filename,
+    std::string_view kind,
+    const std::source_location& src_loc,
+    ParseFunc&& parse) {
+  if (!HasGzipExtension(filename)) {
+    return parse(input);
+  }
+  ::google::protobuf::io::GzipInputStream gzip(&input, ::google::protobuf::io::GzipInputStream::GZIP);
+  absl::Status status = parse(gzip);
+  if (HasGzipError(gzip)) {
+    return absl::AbortedError(
+        absl::StrFormat("Cannot parse %s '%s' @%s: Corrupt gzip data.", kind, filename, SrcLoc(src_loc)));
+  }
+  return status;
+}
+
+absl::Status ParseBinaryProto(
+    ::google::protobuf::io::ZeroCopyInputStream& input,
     const std::filesystem::path& filename,
     ::google::protobuf::Message& result,
     const std::source_location& src_loc) {
-  std::ifstream input(filename, std::ios::binary);
-  if (!input.good()) {
-    return absl::NotFoundError(absl::StrFormat("Cannot open '%s' @ %s", filename, SrcLoc(src_loc)));
-  }
+  return CheckBinaryProtoParsed(result.ParseFromZeroCopyStream(&input), filename, result, src_loc);
+}
+
+absl::Status ParseTextProto(
+    ::google::protobuf::io::ZeroCopyInputStream& input,
+    const std::filesystem::path& filename,
+    ::google::protobuf::Message& result,
+    SilentErrorCollector& error_collector,
+    const std::source_location& src_loc) {
   ::google::protobuf::TextFormat::Parser parser;
   parser.AllowPartialMessage(false);
-  SilentErrorCollector error_collector;
   parser.RecordErrorsTo(error_collector);
-  ::google::protobuf::io::IstreamInputStream zstream(&input);
-  if (parser.Parse(&zstream, &result)) {
+  if (parser.Parse(&input, &result)) {
     return absl::OkStatus();
   }
   return absl::AbortedError(absl::StrFormat(
       "Cannot parse text proto file '%s' @%s: %s.", filename, SrcLoc(src_loc), error_collector.GetErrors(", ")));
 }
 
+absl::Status ParseJsonProto(
+    ::google::protobuf::io::ZeroCopyInputStream& input,
+    const std::filesystem::path& filename,
+    ::google::protobuf::Message& result,
+    const std::source_location& src_loc) {
+  // The JSON parser needs the complete input.
+  std::string json;
+  const void* data = nullptr;
+  int size = 0;
+  while (input.Next(&data, &size)) {
+    json.append(static_cast<const char*>(data), static_cast<std::size_t>(size));
+  }
+  if (const absl::Status status = ::google::protobuf::util::JsonStringToMessage(json, &result); !status.ok()) {
+    return absl::AbortedError(
+        absl::StrFormat("Cannot parse JSON proto file '%s' @%s: %s.", filename, SrcLoc(src_loc), status.message()));
+  }
+  return absl::OkStatus();
+}
+
+// Determines the format from the first bytes of `input` without consuming them.
+ProtoFileFormat SniffProtoStreamFormat(::google::protobuf::io::ZeroCopyInputStream& input) {
+  const void* data = nullptr;
+  int size = 0;
+  while (input.Next(&data, &size)) {
+    if (size > 0) {
+      input.BackUp(size);
+      return SniffProtoFileFormat(std::string_view(static_cast<const char*>(data), static_cast<std::size_t>(size)));
+    }
+  }
+  return ProtoFileFormat::kBinary;  // Empty input is an empty message in any format.
+}
+
+absl::Status ParseProto(
+    ProtoFileFormat format,
+    ::google::protobuf::io::ZeroCopyInputStream& input,
+    const std::filesystem::path& filename,
+    ::google::protobuf::Message& result,
+    const std::source_location& src_loc) {
+  switch (format) {
+    case ProtoFileFormat::kBinary: return ParseBinaryProto(input, filename, result, src_loc);
+    case ProtoFileFormat::kText: {
+      SilentErrorCollector error_collector;
+      return ParseTextProto(input, filename, result, error_collector, src_loc);
+    }
+    case ProtoFileFormat::kJson: return ParseJsonProto(input, filename, result, src_loc);
+  }
+  return absl::InternalError(absl::StrFormat("Unknown proto file format @%s.", SrcLoc(src_loc)));
+}
+
+// Parses `filename` from a memory mapping. Files that cannot be mapped are read from the already
+// opened descriptor, so that pipes and special files are never opened twice.
+absl::Status ReadMappedBinaryProtoFile(
+    const std::filesystem::path& filename,
+    ::google::protobuf::Message& result,
+    const std::source_location& src_loc) {
+  const int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);  // NOLINT(*-vararg)
+  if (fd < 0) {
+    return absl::NotFoundError(absl::StrFormat("Cannot open '%s' @ %s", filename, SrcLoc(src_loc)));
+  }
+  // Parsing walks the data front to back exactly once.
+  const std::optional<proto_internal::MappedFile> mapped = proto_internal::MappedFile::Map(fd);
+  if (mapped.has_value() && mapped->data().size() <= static_cast<std::size_t>(std::numeric_limits<int>::max())) {
+    ::close(fd);
+    const std::string_view data = mapped->data();
+    if (HasGzipExtension(filename)) {
+      ::google::protobuf::io::ArrayInputStream input(data.data(), static_cast<int>(data.size()));
+      return ParseMaybeCompressed(input, filename, "binary proto file", src_loc, [&](auto& stream) {
+        return ParseBinaryProto(stream, filename, result, src_loc);
+      });
+    }
+    return CheckBinaryProtoParsed(
+        result.ParseFromArray(data.data(), static_cast<int>(data.size())), filename, result, src_loc);
+  }
+  ::google::protobuf::io::FileInputStream input(fd);
+  input.SetCloseOnDelete(true);
+  return ParseMaybeCompressed(input, filename, "binary proto file", src_loc, [&](auto& stream) {
+    return ParseBinaryProto(stream, filename, result, src_loc);
+  });
+}
+
+// Reads a varint from `data` at `pos`. Returns false if `data` ends first.
+bool ReadSniffedVarint(std::string_view data, std::size_t& pos, std::uint64_t& value) {
+  value = 0;
+  for (int shift = 0; pos < data.size() && shift < 64; shift += 7) {  // NOLINT(*-magic-numbers)
+    const auto byte = static_cast<unsigned char>(data[pos++]);
+    value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;  // NOLINT(*-magic-numbers)
+    if ((byte & 0x80) == 0) {                                    // NOLINT(*-magic-numbers)
+      return true;
+    }
+  }
+  return false;
+}
+
+// Returns whether `head` is a plausible sequence of binary proto fields. Unless `truncated`, the
+// last field must end exactly at the end of `head`. Groups are not accepted, so that text starting
+// with `#`, `[` or `{` (all of which are group tags) never qualifies.
+bool DecodesAsWireFormat(std::string_view head, bool truncated) {
+  static constexpr std::uint64_t kMaxFieldNumber = (1 << 29) - 1;
+  std::size_t pos = 0;
+  while (pos < head.size()) {
+    std::uint64_t tag = 0;
+    if (!ReadSniffedVarint(head, pos, tag)) {
+      return truncated;
+    }
+    if ((tag >> 3) == 0 || (tag >> 3) > kMaxFieldNumber) {
+      return false;
+    }
+    std::uint64_t size = 0;
+    switch (tag & 7) {  // NOLINT(*-magic-numbers)
+      case 0:
+        if (!ReadSniffedVarint(head, pos, size)) {
+          return truncated;
+        }
+        continue;
+      case 1: size = 8; break;  // NOLINT(*-magic-numbers)
+      case 2:
+        if (!ReadSniffedVarint(head, pos, size)) {
+          return truncated;
+        }
+        break;
+      case 5: size = 4; break;  // NOLINT(*-magic-numbers)
+      default: return false;
+    }
+    if (size > head.size() - pos) {
+      return truncated;
+    }
+    pos += size;
+  }
+  return true;
+}
+
+}  // namespace
+
+namespace proto_internal {
+
+std::string SrcLoc(const std::source_location& src_loc) {
+  return absl::StrFormat("%s:%d", src_loc.file_name(), src_loc.line());
+}
+
+std::int64_t ModificationTimeNanos(const struct stat& info) {
+#if defined(__APPLE__)
+  const struct timespec& mtime = info.st_mtimespec;
+#else
+  const struct timespec& mtime = info.st_mtim;
+#endif
+  return static_cast<std::int64_t>(mtime.tv_sec) * 1'000'000'000 + mtime.tv_nsec;
+}
+
+absl::Status ReadBinaryProtoFile(
+    const std::filesystem::path& filename,
+    ::google::protobuf::Message& result,
+    const ReadBinaryProtoFileOptions& options,
+    const std::source_location& src_loc) {
+  if (options.memory_map) {
+    return ReadMappedBinaryProtoFile(filename, result, src_loc);
+  }
+  return ParseFile(filename, "binary proto file", src_loc, [&](auto& stream) {
+    return ParseBinaryProto(stream, filename, result, src_loc);
+  });
+}
+
+absl::Status ReadTextProtoFile(
+    const std::filesystem::path& filename,
+    ::google::protobuf::Message& result,
+    const std::source_location& src_loc) {
+  SilentErrorCollector error_collector;
+  return ReadTextProtoFile(filename, result, error_collector, src_loc);
+}
+
+absl::Status ReadTextProtoFile(
+    const std::filesystem::path& filename,
+    ::google::protobuf::Message& result,
+    SilentErrorCollector& error_collector,
+    const std::source_location& src_loc) {
+  return ParseFile(filename, "text proto file", src_loc, [&](auto& stream) {
+    return ParseTextProto(stream, filename, result, error_collector, src_loc);
+  });
+}
+
+absl::Status ParseFile(
+    const std::filesystem::path& filename,
+    std::string_view kind,
+    const std::source_location& src_loc,
+    absl::FunctionRef<absl::Status(::google::protobuf::io::ZeroCopyInputStream&)> parse) {
+  std::ifstream input(filename, std::ios::binary);
+  if (!input.good()) {
+    return absl::NotFoundError(absl::StrFormat("Cannot open '%s' @ %s", filename, SrcLoc(src_loc)));
+  }
+  ::google::protobuf::io::IstreamInputStream zstream(&input);
+  return ParseMaybeCompressed(zstream, filename, kind, src_loc, parse);
+}
+
+absl::Status ReadProtoFile(
+    const std::filesystem::path& filename,
+    ::google::protobuf::Message& result,
+    const ReadBinaryProtoFileOptions& binary_options,
+    const std::source_location& src_loc) {
+  if (HasBinaryProtoExtension(filename)) {
+    return ReadBinaryProtoFile(filename, result, binary_options, src_loc);
+  }
+  if (HasTextProtoExtension(filename)) {
+    return ReadTextProtoFile(filename, result, src_loc);
+  }
+  if (HasJsonProtoExtension(filename)) {
+    return ParseFile(filename, "JSON proto file", src_loc, [&](auto& stream) {
+      return ParseJsonProto(stream, filename, result, src_loc);
+    });
+  }
+  // Only the first buffer gets inspected and then the same stream gets parsed in the chosen format,
+  // so the file is read and parsed exactly once.
+  return ParseFile(filename, "proto file", src_loc, [&](auto& stream) {
+    return ParseProto(SniffProtoStreamFormat(stream), stream, filename, result, src_loc);
+  });
+}
+
 }  // namespace proto_internal
 
+bool HasGzipExtension(std::string_view filename) {
+  return filename.ends_with(kGzipExtension);
+}
+
 bool HasBinaryProtoExtension(std::string_view filename) {
+  filename = StripGzipExtension(filename);
   return filename.ends_with(".binpb") ||  // NL
          filename.ends_with(".pb");
 }
 
 bool HasTextProtoExtension(std::string_view filename) {
+  filename = StripGzipExtension(filename);
   return filename.ends_with(".txtpb") ||  // NL
          filename.ends_with(".textproto");
 }
 
+bool HasJsonProtoExtension(std::string_view filename) {
+  return StripGzipExtension(filename).ends_with(".json");
+}
+
+ProtoFileFormat SniffProtoFileFormat(std::string_view head) {
+  static constexpr std::size_t kMaxSniffBytes = 256;
+  const bool truncated = head.size() > kMaxSniffBytes;
+  head = head.substr(0, kMaxSniffBytes);
+  // The text and JSON formats never contain control characters outside of whitespace, while the
+  // binary format almost always has some among its tags and lengths.
+  for (const char chr : head) {
+    const auto byte = static_cast<unsigned char>(chr);
+    if ((byte < 0x20 && !std::isspace(byte)) || byte == 0x7F) {  // NOLINT(*-magic-numbers)
+      return ProtoFileFormat::kBinary;
+    }
+  }
+  // Binary data can still be printable, e.g. a string field numbered 4 to 15 with 32 to 126 bytes.
+  if (DecodesAsWireFormat(head, truncated)) {
+    return ProtoFileFormat::kBinary;
+  }
+  const std::size_t start = head.find_first_not_of(" \t\n\r\f\v");
+  if (start == std::string_view::npos) {
+    return head.empty() ? ProtoFileFormat::kBinary : ProtoFileFormat::kText;
+  }
+  // A text proto starts with a field name, an extension `[` or a comment, but never with `{`.
+  return head[start] == '{' ? ProtoFileFormat::kJson : ProtoFileFormat::kText;
+}
+
 absl::Status WriteBinaryProtoFile(
     const std::filesystem::path& filename,
     const ::google::protobuf::Message& proto,
     const std::source_location& src_loc) {
-  std::ofstream output(filename, std::ios::binary);
-  if (output.good() && proto.SerializeToOstream(&output)) {
-    output.close();
-    if (output.good()) {
-      return absl::OkStatus();
-    }
+  return WriteBinaryProtoFile(filename, proto, WriteProtoFileOptions{}, src_loc);
+}
+
+absl::Status WriteBinaryProtoFile(
+    const std::filesystem::path& filename,
+    const ::google::protobuf::Message& proto,
+    const WriteProtoFileOptions& options,
+    const std::source_location& src_loc) {
+  if (WriteFile(filename, options, [&proto](::google::protobuf::io::ZeroCopyOutputStream& output) {
+        return proto.SerializeToZeroCopyStream(&output);
+      })) {
+    return absl::OkStatus();
   }
   return absl::AbortedError(absl::StrFormat("Cannot write binary proto file '%s' @ %s.", filename, SrcLoc(src_loc)));
 }
@@ -110,8 +489,17 @@ absl::Status WriteTextProtoFile(
     const std::filesystem::path& filename,
     const ::google::protobuf::Message& proto,
     const std::source_location& src_loc) {
-  std::ofstream output(filename, std::ios::binary);
-  if (output.good() && PrintTextMessage(proto, output)) {
+  return WriteTextProtoFile(filename, proto, WriteProtoFileOptions{}, src_loc);
+}
+
+absl::Status WriteTextProtoFile(
+    const std::filesystem::path& filename,
+    const ::google::protobuf::Message& proto,
+    const WriteProtoFileOptions& options,
+    const std::source_location& src_loc) {
+  if (WriteFile(filename, options, [&proto](::google::protobuf::io::ZeroCopyOutputStream& output) {
+        return ::google::protobuf::TextFormat::Print(proto, &output);
+      })) {
     return absl::OkStatus();
   }
   return absl::AbortedError(absl::StrFormat("Cannot write text proto file '%s' @ %s.", filename, SrcLoc(src_loc)));
@@ -20,22 +20,35 @@
 #include <filesystem>
 #include <optional>
 #include <source_location>
+#include <string_view>
 
 #include "absl/log/absl_log.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "google/protobuf/arena.h"
 #include "google/protobuf/message.h"
 #include "mbo/proto/file_impl.h"  // IWYU pragma: export
 
 // Functionality for reading and writing protos:
-// - functions        Has(Binary|Text)ProtoExtension
+// - functions        Has(Gzip|Binary|Text|Json)ProtoExtension
+// - enum/function    ProtoFileFormat, SniffProtoFileFormat
 // - concept          IsProtoType
-// - struct/function  Read(Binary|Text)ProtoFile(::(As|OrDie|OrNullopt))?
+// - struct           ReadBinaryProtoFileOptions
+// - struct           WriteProtoFileOptions
+// - struct/function  Read(Binary|Text)?ProtoFile(::(As|OrDie|OrNullopt))?
 // - struct/function  Write(Binary|Text)ProtoFile
 
 namespace mbo::proto {
 
-// Identifies binary proto filenames.
+// Identifies gzip compressed filenames (".gz"). Such files are transparently decompressed when
+// read and compressed when written by the functions in this header.
+bool HasGzipExtension(std::string_view filename);
+
+inline bool HasGzipExtension(const std::same_as<std::filesystem::path> auto& filename) {
+  return HasGzipExtension(filename.native());
+}
+
+// Identifies binary proto filenames, optionally followed by ".gz".
 // See https://protobuf.dev/programming-guides/techniques/
 // See https://en.wikipedia.org/wiki/Filename_extension (extension with dot)
 // Added [".pb"] which is also fairly common.
@@ -45,7 +58,7 @@ inline bool HasBinaryProtoExtension(const std::same_as<std::filesystem::path> au
   return HasBinaryProtoExtension(filename.native());
 }
 
-// Identifies text proto filenames.
+// Identifies text proto filenames, optionally followed by ".gz".
 // See https://protobuf.dev/programming-guides/techniques/
 // See https://en.wikipedia.org/wiki/Filename_extension (extension with dot)
 bool HasTextProtoExtension(std::string_view filename);
@@ -54,86 +67,194 @@ inline bool HasTextProtoExtension(const std::same_as<std::filesystem::path> auto
   return HasTextProtoExtension(filename.native());
 }
 
+// Identifies JSON proto filenames (".json"), optionally followed by ".gz".
+bool HasJsonProtoExtension(std::string_view filename);
+
+inline bool HasJsonProtoExtension(const std::same_as<std::filesystem::path> auto& filename) {
+  return HasJsonProtoExtension(filename.native());
+}
+
+// The serialization formats of proto files.
+enum class ProtoFileFormat {
+  kBinary,
+  kText,
+  kJson,
+};
+
+// Guesses the format of proto data from its first bytes (at most 256 are inspected).
+// - Any control character other than whitespace means binary.
+// - So does data that decodes as a sequence of binary field tags, lengths and values.
+// - Otherwise data whose first non whitespace character is `{` is JSON.
+// - Everything else is text.
+// Very short text may decode as binary fields, e.g. `h1`, but real text protos practically never do.
+ProtoFileFormat SniffProtoFileFormat(std::string_view head);
+
 // Concept that identifies Proto types as opposed to the base proto `Message`.
 template<typename ProtoType>
 concept IsProtoType =
     std::derived_from<ProtoType, ::google::protobuf::Message> && !std::same_as<ProtoType, ::google::protobuf::Message>;
 
-// Type erasure proto reader for binary proto files.
-//
-// Example:
-//
-// ```c++
-// const MyProto proto = ReadBinaryProtoFile(proto_filename);
-// const absl::StatusOr<MyProto> proto_or_error = ReadBinaryProtoFile(proto_filename);
-// const std::optional<MyProto> proto_or_nullopt = ReadBinaryProtoFile(proto_filename);
-// ```
-//
-//
-// In the above the first call requires the file to be readable as a `MyProto`.
-// The program will abort with a check violation if the file cannot be read.
-//
-// The second call returns either the read protocol buffer or an error status.
-// In this version the return value forces the caller to handle any errors.
-//
-// The third call returns either the read protocol buffer ot std::nullopt.
-// In this verion the caller is responsible for error handling.
-//
-// The class also supports static direct typed access by functions whose
-// addresses can be taken.
-class ReadBinaryProtoFile {
+// Options for reading binary proto files.
+struct ReadBinaryProtoFileOptions {
+  // Parse regular files straight from a read-only memory mapping instead of copying them through
+  // an input stream buffer. Files that cannot be mapped (e.g. pipes or character devices) are read
+  // through the stream based path.
+  bool memory_map = false;
+};
+
+// Options for reading text proto files. There are none yet, but they give all proto file readers the
+// same interface.
+struct ReadTextProtoFileOptions {};
+
+// Options for writing binary and text proto files.
+struct WriteProtoFileOptions {
+  // Write into a new temporary file next to the target and rename it onto the target once all
+  // data was written. Readers then either see the previous or the new complete file, never a
+  // partially written one.
+  bool atomic = false;
+
+  // Call `fsync` on the written file before it is closed (and renamed). In atomic mode the
+  // directory gets synced as well, so that the rename is durable.
+  bool fsync = false;
+
+  // Size of the write buffer in bytes. Values <= 0 select protobuf's default block size.
+  int buffer_size = 256 << 10;  // NOLINT(*-magic-numbers)
+};
+
+namespace proto_internal {
+
+// The reading interface shared by `ReadBinaryProtoFile`, `ReadTextProtoFile` and `ReadProtoFile`:
+// static typed `As`, `OrNullopt` and `OrDie` functions (with and without arena) and the type erased
+// conversions. The `Derived` class provides the `Read` function that parses a file with `Options`
+// and its `kName` for messages.
+template<typename Derived, typename Options>
+class ProtoFileReader {
  public:
   // Static read function - so it's address can be taken.
   template<IsProtoType ProtoType>
   static absl::StatusOr<ProtoType> As(
       const std::filesystem::path& filename,
+      const Options& options,
       const std::source_location& src_loc = std::source_location::current()) {
     ProtoType result;
-    const auto status = proto_internal::ReadBinaryProtoFile(filename, result, src_loc);
+    const auto status = Derived::Read(filename, result, options, src_loc);
     if (!status.ok()) {
       return status;
     }
     return result;
   }
 
+  // Static read function - so it's address can be taken.
+  template<IsProtoType ProtoType>
+  static absl::StatusOr<ProtoType> As(
+      const std::filesystem::path& filename,
+      const std::source_location& src_loc = std::source_location::current()) {
+    return As<ProtoType>(filename, Options{}, src_loc);
+  }
+
   // Static read function - so it's address can be taken.
   template<IsProtoType ProtoType>
   static std::optional<ProtoType> OrNullopt(
       const std::filesystem::path& filename,
+      const Options& options,
       const std::source_location& src_loc = std::source_location::current()) {
-    if (auto result = As<ProtoType>(filename, src_loc); result.ok()) {
+    if (auto result = As<ProtoType>(filename, options, src_loc); result.ok()) {
       return *std::move(result);
     }
     return std::nullopt;
   }
 
+  // Static read function - so it's address can be taken.
+  template<IsProtoType ProtoType>
+  static std::optional<ProtoType> OrNullopt(
+      const std::filesystem::path& filename,
+      const std::source_location& src_loc = std::source_location::current()) {
+    return OrNullopt<ProtoType>(filename, Options{}, src_loc);
+  }
+
   // Static read function - so it's address can be taken.
   template<IsProtoType ProtoType>
   static ProtoType OrDie(
       const std::filesystem::path& filename,
+      const Options& options,
+      const std::source_location& src_loc = std::source_location::current()) {
+    return *As<ProtoType>(filename, options, src_loc);
+  }
+
+  // Static read function - so it's address can be taken.
+  template<IsProtoType ProtoType>
+  static ProtoType OrDie(
+      const std::filesystem::path& filename,
+      const std::source_location& src_loc = std::source_location::current()) {
+    return OrDie<ProtoType>(filename, Options{}, src_loc);
+  }
+
+  // Static read function that creates the result on `arena` - so it's address can be taken.
+  // The returned message is owned by `arena`, or by the caller if `arena` is nullptr.
+  template<IsProtoType ProtoType>
+  static absl::StatusOr<ProtoType*> As(
+      ::google::protobuf::Arena* arena,
+      const std::filesystem::path& filename,
+      const Options& options,
       const std::source_location& src_loc = std::source_location::current()) {
-    return *As<ProtoType>(filename, src_loc);
+    return proto_internal::ReadOnArena<ProtoType>(arena, [&](ProtoType& result) {
+      return Derived::Read(filename, result, options, src_loc);
+    });
   }
 
-  ReadBinaryProtoFile() = delete;
+  // Static read function that creates the result on `arena` - so it's address can be taken.
+  template<IsProtoType ProtoType>
+  static absl::StatusOr<ProtoType*> As(
+      ::google::protobuf::Arena* arena,
+      const std::filesystem::path& filename,
+      const std::source_location& src_loc = std::source_location::current()) {
+    return As<ProtoType>(arena, filename, Options{}, src_loc);
+  }
 
-  explicit ReadBinaryProtoFile(
+  // Static read function that creates the result on `arena` - so it's address can be taken.
+  template<IsProtoType ProtoType>
+  static ProtoType* OrDie(
+      ::google::protobuf::Arena* arena,
+      const std::filesystem::path& filename,
+      const Options& options,
+      const std::source_location& src_loc = std::source_location::current()) {
+    return *As<ProtoType>(arena, filename, options, src_loc);
+  }
+
+  // Static read function that creates the result on `arena` - so it's address can be taken.
+  template<IsProtoType ProtoType>
+  static ProtoType* OrDie(
+      ::google::protobuf::Arena* arena,
+      const std::filesystem::path& filename,
+      const std::source_location& src_loc = std::source_location::current()) {
+    return *As<ProtoType>(arena, filename, src_loc);
+  }
+
+  ProtoFileReader() = delete;
+
+  explicit ProtoFileReader(
       std::filesystem::path filename,
       const std::source_location& src_loc = std::source_location::current())
       : filename_(std::move(filename)), src_loc_(src_loc) {}
 
-  ReadBinaryProtoFile(const ReadBinaryProtoFile&) = delete;
-  ReadBinaryProtoFile& operator=(const ReadBinaryProtoFile&) = delete;
-  ReadBinaryProtoFile(ReadBinaryProtoFile&&) = delete;
-  ReadBinaryProtoFile& operator=(ReadBinaryProtoFile&&) = delete;
+  ProtoFileReader(
+      std::filesystem::path filename,
+      const Options& options,
+      const std::source_location& src_loc = std::source_location::current())
+      : filename_(std::move(filename)), options_(options), src_loc_(src_loc) {}
 
-  ~ReadBinaryProtoFile() { ABSL_LOG_IF(DFATAL, !converted_) << "ReadBinaryProtoFile has not read the file."; }
+  ProtoFileReader(const ProtoFileReader&) = delete;
+  ProtoFileReader& operator=(const ProtoFileReader&) = delete;
+  ProtoFileReader(ProtoFileReader&&) = delete;
+  ProtoFileReader& operator=(ProtoFileReader&&) = delete;
+
+  ~ProtoFileReader() { ABSL_LOG_IF(DFATAL, !converted_) << Derived::kName << " has not read the file."; }
 
   template<int&..., IsProtoType ProtoType>
   operator absl::StatusOr<ProtoType>() const {  // NOLINT(*-explicit-*)
     converted_ = true;
     ProtoType result;
-    const auto status = proto_internal::ReadBinaryProtoFile(filename_, result, src_loc_);
+    const auto status = Derived::Read(filename_, result, options_, src_loc_);
     if (!status.ok()) {
       return status;
     }
@@ -159,24 +280,88 @@ class ReadBinaryProtoFile {
 
  private:
   const std::filesystem::path filename_;
+  const Options options_{};
   const std::source_location src_loc_;
   mutable bool converted_ = false;
 };
 
-// Writes a binary proto file.
+}  // namespace proto_internal
+
+// Type erasure proto reader for binary proto files.
+//
+// Files with a gzip extension (see `HasGzipExtension`) are decompressed while being parsed.
+//
+// Example:
+//
+// ```c++
+// const MyProto proto = ReadBinaryProtoFile(proto_filename);
+// const absl::StatusOr<MyProto> proto_or_error = ReadBinaryProtoFile(proto_filename);
+// const std::optional<MyProto> proto_or_nullopt = ReadBinaryProtoFile(proto_filename);
+// const MyProto mapped = ReadBinaryProtoFile(proto_filename, {.memory_map = true});
+// MyProto* on_arena = ReadBinaryProtoFile::OrDie<MyProto>(&arena, proto_filename);
+// ```
+//
+//
+// In the above the first call requires the file to be readable as a `MyProto`.
+// The program will abort with a check violation if the file cannot be read.
+//
+// The second call returns either the read protocol buffer or an error status.
+// In this version the return value forces the caller to handle any errors.
+//
+// The third call returns either the read protocol buffer ot std::nullopt.
+// In this verion the caller is responsible for error handling.
+//
+// The fourth call parses the file straight from a read-only memory mapping,
+// see `ReadBinaryProtoFileOptions`.
+//
+// The fifth call creates the message on the given `google::protobuf::Arena`.
+// The static functions `As` and `OrDie` have overloads that take an arena as
+// first argument.
+//
+// The class also supports static direct typed access by functions whose
+// addresses can be taken.
+class ReadBinaryProtoFile final
+    : public proto_internal::ProtoFileReader<ReadBinaryProtoFile, ReadBinaryProtoFileOptions> {
+ public:
+  using ProtoFileReader::ProtoFileReader;
+
+ private:
+  friend ProtoFileReader;
+
+  static constexpr std::string_view kName = "ReadBinaryProtoFile";
+
+  static absl::Status Read(
+      const std::filesystem::path& filename,
+      ::google::protobuf::Message& result,
+      const ReadBinaryProtoFileOptions& options,
+      const std::source_location& src_loc) {
+    return proto_internal::ReadBinaryProtoFile(filename, result, options, src_loc);
+  }
+};
+
+// Writes a binary proto file, gzip compressed if `filename` has a gzip extension.
+absl::Status WriteBinaryProtoFile(
+    const std::filesystem::path& filename,
+    const ::google::protobuf::Message& proto,
+    const std::source_location& src_loc = std::source_location::current());
+
 absl::Status WriteBinaryProtoFile(
     const std::filesystem::path& filename,
     const ::google::protobuf::Message& proto,
+    const WriteProtoFileOptions& options,
     const std::source_location& src_loc = std::source_location::current());
 
 // Type erasure proto reader for text proto files.
 //
+// Files with a gzip extension (see `HasGzipExtension`) are decompressed while being parsed.
+//
 // Example:
 //
 // ```c++
 // const MyProto proto = ReadTextProtoFile(filename);
 // const absl::StatusOr<MyProto> proto_or_error = ReadTextProtoFile(filename);
 // const std::optional<MyProto> proto_or_nullopt = ReadTextProtoFile(filename);
+// MyProto* on_arena = ReadTextProtoFile::OrDie<MyProto>(&arena, filename);
 // ```
 //
 // In the above the first call requires the file to be readable as a `MyProto`.
@@ -188,97 +373,78 @@ absl::Status WriteBinaryProtoFile(
 // The third call returns either the read protocol buffer ot std::nullopt.
 // In this verion the caller is responsible for error handling.
 //
+// The fourth call creates the message on the given `google::protobuf::Arena`.
+// The static functions `As` and `OrDie` have overloads that take an arena as
+// first argument.
+//
 // The class also supports static direct typed access by functions whose
 // addresses can be taken.
 
-class ReadTextProtoFile {
+class ReadTextProtoFile final : public proto_internal::ProtoFileReader<ReadTextProtoFile, ReadTextProtoFileOptions> {
  public:
-  // Static read function - so it's address can be taken.
-  template<IsProtoType ProtoType>
-  static absl::StatusOr<ProtoType> As(
-      const std::filesystem::path& filename,
-      const std::source_location& src_loc = std::source_location::current()) {
-    ProtoType result;
-    const auto status = proto_internal::ReadTextProtoFile(filename, result, src_loc);
-    if (!status.ok()) {
-      return status;
-    }
-    return result;
-  }
+  using ProtoFileReader::ProtoFileReader;
 
-  // Static read function - so it's address can be taken.
-  template<IsProtoType ProtoType>
-  static std::optional<ProtoType> OrNullopt(
-      const std::filesystem::path& filename,
-      const std::source_location& src_loc = std::source_location::current()) {
-    if (auto result = As<ProtoType>(filename, src_loc); result.ok()) {
-      return *std::move(result);
-    }
-    return std::nullopt;
-  }
+ private:
+  friend ProtoFileReader;
 
-  // Static read function - so it's address can be taken.
-  template<IsProtoType ProtoType>
-  static ProtoType OrDie(
+  static constexpr std::string_view kName = "ReadTextProtoFile";
+
+  static absl::Status Read(
       const std::filesystem::path& filename,
-      const std::source_location& src_loc = std::source_location::current()) {
-    return *As<ProtoType>(filename, src_loc);
+      ::google::protobuf::Message& result,
+      const ReadTextProtoFileOptions& /* options */,
+      const std::source_location& src_loc) {
+    return proto_internal::ReadTextProtoFile(filename, result, src_loc);
   }
+};
 
-  ReadTextProtoFile() = delete;
-
-  explicit ReadTextProtoFile(
-      std::filesystem::path filename,
-      const std::source_location& src_loc = std::source_location::current())
-      : filename_(std::move(filename)), src_loc_(src_loc) {}
+// Writes a text proto file, gzip compressed if `filename` has a gzip extension.
+absl::Status WriteTextProtoFile(
+    const std::filesystem::path& filename,
+    const ::google::protobuf::Message& proto,
+    const std::source_location& src_loc = std::source_location::current());
 
-  ReadTextProtoFile(const ReadTextProtoFile&) = delete;
-  ReadTextProtoFile& operator=(const ReadTextProtoFile&) = delete;
-  ReadTextProtoFile(ReadTextProtoFile&&) = delete;
-  ReadTextProtoFile& operator=(ReadTextProtoFile&&) = delete;
+absl::Status WriteTextProtoFile(
+    const std::filesystem::path& filename,
+    const ::google::protobuf::Message& proto,
+    const WriteProtoFileOptions& options,
+    const std::source_location& src_loc = std::source_location::current());
 
-  ~ReadTextProtoFile() { ABSL_LOG_IF(DFATAL, !converted_) << "ReadTextProtoFile has not read the file."; }
+// Type erasure proto reader for proto files in any supported format.
+//
+// The format is determined by the extension: `HasBinaryProtoExtension`,
+// `HasTextProtoExtension` or `HasJsonProtoExtension`. Files with any other
+// extension are inspected using `SniffProtoFileFormat` on the first buffer of
+// the input, which is then parsed in the detected format. So every file is read
+// and parsed only once. The `options` apply to binary files that are identified
+// by their extension. Gzip compressed files are supported as well.
+//
+// Example:
+//
+// ```c++
+// const MyProto proto = ReadProtoFile(proto_filename);
+// const absl::StatusOr<MyProto> proto_or_error = ReadProtoFile(proto_filename);
+// const std::optional<MyProto> proto_or_nullopt = ReadProtoFile(proto_filename);
+// MyProto* on_arena = ReadProtoFile::OrDie<MyProto>(&arena, proto_filename);
+// ```
+class ReadProtoFile final : public proto_internal::ProtoFileReader<ReadProtoFile, ReadBinaryProtoFileOptions> {
+ public:
+  using ProtoFileReader::ProtoFileReader;
 
-  template<int&..., IsProtoType ProtoType>
-  operator absl::StatusOr<ProtoType>() const {  // NOLINT(*-explicit-*)
-    converted_ = true;
-    ProtoType result;
-    const auto status = proto_internal::ReadTextProtoFile(filename_, result, src_loc_);
-    if (!status.ok()) {
-      return status;
-    }
-    return result;
-  }
+ private:
+  friend ProtoFileReader;
 
-  template<int&..., IsProtoType ProtoType>
-  operator std::optional<ProtoType>() const {  // NOLINT(*-explicit-*)
-    absl::StatusOr<ProtoType> proto = *this;
-    if (!proto.ok()) {
-      return std::nullopt;
-    }
-    return *proto;
-  }
+  static constexpr std::string_view kName = "ReadProtoFile";
 
-  template<int&..., IsProtoType ProtoType>
-  operator ProtoType() const {  // NOLINT(*-explicit-*)
-    absl::StatusOr<ProtoType> proto = *this;
-    ABSL_LOG_IF(FATAL, !proto.ok()).AtLocation(src_loc_.file_name(), static_cast<int>(src_loc_.line()))
-        << proto.status();
-    return *proto;
+  static absl::Status Read(
+      const std::filesystem::path& filename,
+      ::google::protobuf::Message& result,
+      const ReadBinaryProtoFileOptions& options,
+      const std::source_location& src_loc) {
+    return proto_internal::ReadProtoFile(filename, result, options, src_loc);
   }
-
- private:
-  const std::filesystem::path filename_;
-  const std::source_location src_loc_;
-  mutable bool converted_ = false;
 };
 
-// Writes a text proto file.
-absl::Status WriteTextProtoFile(
-    const std::filesystem::path& filename,
-    const ::google::protobuf::Message& proto,
-    const std::source_location& src_loc = std::source_location::current());
-
 }  // namespace mbo::proto
 
 #endif  // MBO_PROTO_FILE_H_
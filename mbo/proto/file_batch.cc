@@ -0,0 +1,70 @@
+// SPDX-FileCopyrightText: Copyright (c) The helly25/mbo authors (helly25.com)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mbo/proto/file_batch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <filesystem>
+#include <source_location>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "absl/log/absl_check.h"
+#include "absl/status/status.h"
+#include "google/protobuf/message.h"
+#include "mbo/proto/file.h"
+
+namespace mbo::proto::proto_internal {
+
+void ReadProtoFiles(
+    std::span<const std::filesystem::path> filenames,
+    std::span<::google::protobuf::Message* const> results,
+    std::span<absl::Status> statuses,
+    const ReadProtoFilesOptions& options,
+    const std::source_location& src_loc) {
+  ABSL_CHECK_EQ(filenames.size(), results.size());
+  ABSL_CHECK_EQ(filenames.size(), statuses.size());
+  // Files vary a lot in size, so workers grab the next file as they become idle rather than being
+  // assigned a fixed slice up front.
+  std::atomic<std::size_t> next{0};
+  const auto worker = [&] {
+    for (std::size_t index = next++; index < filenames.size(); index = next++) {
+      statuses[index] = ReadProtoFile(filenames[index], *results[index], options.binary, src_loc);
+    }
+  };
+  std::size_t num_threads = options.max_threads;
+  if (num_threads == 0) {
+    num_threads = std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+  }
+  num_threads = std::min(num_threads, filenames.size());
+  if (num_threads <= 1) {
+    worker();
+    return;
+  }
+  std::vector<std::thread> threads;
+  threads.reserve(num_threads - 1);
+  for (std::size_t thread = 1; thread < num_threads; ++thread) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
+
+}  // namespace mbo::proto::proto_internal
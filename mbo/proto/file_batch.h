@@ -0,0 +1,109 @@
+// SPDX-FileCopyrightText: Copyright (c) The helly25/mbo authors (helly25.com)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MBO_PROTO_FILE_BATCH_H_
+#define MBO_PROTO_FILE_BATCH_H_
+
+#include <cstddef>
+#include <filesystem>
+#include <source_location>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "google/protobuf/message.h"
+#include "mbo/proto/file.h"
+
+// Functionality for reading many proto files concurrently:
+// - struct    ReadProtoFilesOptions
+// - function  ReadProtoFiles
+
+namespace mbo::proto {
+
+// Options for reading many proto files at once.
+struct ReadProtoFilesOptions {
+  // Maximum number of worker threads. If 0, then `std::thread::hardware_concurrency` is used.
+  // The number of workers never exceeds the number of files. With a single worker all files are
+  // read on the calling thread.
+  std::size_t max_threads = 0;
+
+  // Options for files with a binary proto extension, see `ReadProtoFile`.
+  ReadBinaryProtoFileOptions binary;
+};
+
+namespace proto_internal {
+
+// Reads `filenames[i]` into `*results[i]` and stores the outcome in `statuses[i]`. All spans must
+// have the same size. Each file is read as by `ReadProtoFile`.
+void ReadProtoFiles(
+    std::span<const std::filesystem::path> filenames,
+    std::span<::google::protobuf::Message* const> results,
+    std::span<absl::Status> statuses,
+    const ReadProtoFilesOptions& options,
+    const std::source_location& src_loc);
+
+}  // namespace proto_internal
+
+// Reads all `filenames` as `ProtoType` using a pool of worker threads.
+//
+// Each file is read as by `ReadProtoFile`, which picks the format by extension or by inspecting the
+// first bytes of the file. The results are returned in the order of the input, with one
+// `absl::StatusOr` per file, so that a single bad file does not prevent the others from being loaded.
+//
+// Example:
+//
+// ```c++
+// const std::vector<std::filesystem::path> shards = ...;
+// for (absl::StatusOr<MyProto>& shard : ReadProtoFiles<MyProto>(shards, {.max_threads = 16})) {
+//   ...
+// }
+// ```
+template<IsProtoType ProtoType>
+std::vector<absl::StatusOr<ProtoType>> ReadProtoFiles(
+    std::span<const std::filesystem::path> filenames,
+    const ReadProtoFilesOptions& options,
+    const std::source_location& src_loc = std::source_location::current()) {
+  std::vector<ProtoType> protos(filenames.size());
+  std::vector<::google::protobuf::Message*> pointers;
+  pointers.reserve(protos.size());
+  for (ProtoType& proto : protos) {
+    pointers.push_back(&proto);
+  }
+  std::vector<absl::Status> statuses(filenames.size());
+  proto_internal::ReadProtoFiles(filenames, pointers, statuses, options, src_loc);
+  std::vector<absl::StatusOr<ProtoType>> results;
+  results.reserve(filenames.size());
+  for (std::size_t index = 0; index < filenames.size(); ++index) {
+    if (statuses[index].ok()) {
+      results.emplace_back(std::move(protos[index]));
+    } else {
+      results.emplace_back(std::move(statuses[index]));
+    }
+  }
+  return results;
+}
+
+template<IsProtoType ProtoType>
+std::vector<absl::StatusOr<ProtoType>> ReadProtoFiles(
+    std::span<const std::filesystem::path> filenames,
+    const std::source_location& src_loc = std::source_location::current()) {
+  return ReadProtoFiles<ProtoType>(filenames, ReadProtoFilesOptions{}, src_loc);
+}
+
+}  // namespace mbo::proto
+
+#endif  // MBO_PROTO_FILE_BATCH_H_
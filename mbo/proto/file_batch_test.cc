@@ -0,0 +1,115 @@
+// SPDX-FileCopyrightText: Copyright (c) The helly25/mbo authors (helly25.com)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mbo/proto/file_batch.h"
+
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "absl/strings/str_format.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "mbo/proto/file.h"
+#include "mbo/proto/matchers.h"
+#include "mbo/proto/status_matchers.h"
+#include "mbo/proto/tests/simple_message.pb.h"
+
+namespace mbo::proto {
+namespace {
+// NOLINTBEGIN(*-magic-numbers)
+
+using ::mbo::proto::EqualsProto;
+using ::mbo::proto::tests::SimpleMessage;
+using ::testing::ElementsAre;
+using ::testing::HasSubstr;
+using ::testing::SizeIs;
+
+struct FileBatchTest : ::testing::Test {
+  // Writes `count` files alternating between binary and text format.
+  static std::vector<std::filesystem::path> WriteFiles(std::size_t count) {
+    std::vector<std::filesystem::path> filenames;
+    for (std::size_t index = 0; index < count; ++index) {
+      SimpleMessage proto;
+      proto.set_one(static_cast<int>(index));
+      if (index % 2 == 0) {
+        filenames.emplace_back(absl::StrFormat("batch_%d.binpb", index));
+        EXPECT_THAT(WriteBinaryProtoFile(filenames.back(), proto), IsOk());
+      } else {
+        filenames.emplace_back(absl::StrFormat("batch_%d.txtpb", index));
+        EXPECT_THAT(WriteTextProtoFile(filenames.back(), proto), IsOk());
+      }
+    }
+    return filenames;
+  }
+};
+
+TEST_F(FileBatchTest, ReadInOrder) {
+  const std::vector<std::filesystem::path> filenames = WriteFiles(50);
+  for (std::size_t max_threads : {0, 1, 4, 100}) {
+    const std::vector<absl::StatusOr<SimpleMessage>> results =
+        ReadProtoFiles<SimpleMessage>(filenames, {.max_threads = max_threads});
+    ASSERT_THAT(results, SizeIs(filenames.size())) << "max_threads: " << max_threads;
+    for (std::size_t index = 0; index < results.size(); ++index) {
+      SimpleMessage expected;
+      expected.set_one(static_cast<int>(index));
+      EXPECT_THAT(results[index], IsOkAndHolds(EqualsProto(expected)))
+          << "max_threads: " << max_threads << ", file: " << filenames[index];
+    }
+  }
+}
+
+TEST_F(FileBatchTest, MemoryMapped) {
+  const std::vector<std::filesystem::path> filenames = WriteFiles(4);
+  const std::vector<absl::StatusOr<SimpleMessage>> results =
+      ReadProtoFiles<SimpleMessage>(filenames, {.binary = {.memory_map = true}});
+  EXPECT_THAT(
+      results, ElementsAre(
+                   IsOkAndHolds(EqualsProto("one: 0")), IsOkAndHolds(EqualsProto("one: 1")),
+                   IsOkAndHolds(EqualsProto("one: 2")), IsOkAndHolds(EqualsProto("one: 3"))));
+}
+
+TEST_F(FileBatchTest, Errors) {
+  std::vector<std::filesystem::path> filenames = WriteFiles(2);
+  filenames.insert(filenames.begin() + 1, "DoesNotExist.binpb");
+  filenames.emplace_back("DoesNotExist.extension");
+  const std::vector<absl::StatusOr<SimpleMessage>> results = ReadProtoFiles<SimpleMessage>(filenames);
+  EXPECT_THAT(
+      results,
+      ElementsAre(
+          IsOkAndHolds(EqualsProto("one: 0")),
+          StatusIs(absl::StatusCode::kNotFound, HasSubstr("Cannot open 'DoesNotExist.binpb'")),
+          IsOkAndHolds(EqualsProto("one: 1")),
+          StatusIs(absl::StatusCode::kNotFound, HasSubstr("Cannot open 'DoesNotExist.extension'"))));
+}
+
+TEST_F(FileBatchTest, SniffedFormat) {
+  SimpleMessage proto;
+  proto.set_one(25);
+  ASSERT_THAT(WriteBinaryProtoFile("batch.binpb", proto), IsOk());
+  std::filesystem::rename("batch.binpb", "batch.data");
+  const std::vector<std::filesystem::path> filenames = {"batch.data"};
+  EXPECT_THAT(ReadProtoFiles<SimpleMessage>(filenames), ElementsAre(IsOkAndHolds(EqualsProto(proto))));
+}
+
+TEST_F(FileBatchTest, Empty) {
+  EXPECT_THAT(ReadProtoFiles<SimpleMessage>({}), SizeIs(0));
+}
+
+// NOLINTEND(*-magic-numbers)
+}  // namespace
+}  // namespace mbo::proto
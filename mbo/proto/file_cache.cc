@@ -0,0 +1,93 @@
+// SPDX-FileCopyrightText: Copyright (c) The helly25/mbo authors (helly25.com)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mbo/proto/file_cache.h"
+
+#include <sys/stat.h>
+
+#include <filesystem>
+#include <memory>
+#include <source_location>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_format.h"
+#include "absl/synchronization/mutex.h"
+#include "google/protobuf/message.h"
+#include "mbo/proto/file.h"
+
+namespace mbo::proto {
+
+using ::mbo::proto::proto_internal::SrcLoc;
+
+ProtoFileCache& ProtoFileCache::Global() {
+  static ProtoFileCache* const kCache = new ProtoFileCache();  // NOLINT(*-owning-memory)
+  return *kCache;
+}
+
+void ProtoFileCache::Clear() {
+  const absl::MutexLock lock(&mutex_);
+  entries_.clear();
+}
+
+ProtoFileCacheStats ProtoFileCache::Stats() const {
+  return {.hits = hits_.load(), .misses = misses_.load()};
+}
+
+absl::StatusOr<std::shared_ptr<const ::google::protobuf::Message>> ProtoFileCache::Read(
+    const std::filesystem::path& filename,
+    const ::google::protobuf::Message& prototype,
+    const std::source_location& src_loc) {
+  std::error_code error;
+  std::filesystem::path canonical = std::filesystem::canonical(filename, error);
+  struct stat info{};
+  if (error || ::stat(canonical.c_str(), &info) != 0) {
+    ++misses_;
+    return absl::NotFoundError(absl::StrFormat("Cannot open '%s' @ %s", filename, SrcLoc(src_loc)));
+  }
+  // The stamp is taken before the file is read. If the file changes while it is being read, then
+  // the next lookup sees a different stamp and reads it again.
+  const FileStamp stamp{
+      .mtime = proto_internal::ModificationTimeNanos(info),
+      .size = static_cast<std::uintmax_t>(info.st_size),
+      .device = static_cast<std::uintmax_t>(info.st_dev),
+      .inode = static_cast<std::uintmax_t>(info.st_ino),
+  };
+  Key key(std::move(canonical).native(), prototype.GetDescriptor());
+  {
+    const absl::ReaderMutexLock lock(&mutex_);
+    if (const auto it = entries_.find(key); it != entries_.end() && it->second.stamp == stamp) {
+      ++hits_;
+      return it->second.proto;
+    }
+  }
+  ++misses_;
+  // Read the canonical path that was stamped, so a symlink that gets retargeted in the meantime
+  // cannot put the content of another file under this key.
+  std::shared_ptr<::google::protobuf::Message> proto(prototype.New());
+  if (absl::Status status = proto_internal::ReadProtoFile(key.first, *proto, {}, src_loc); !status.ok()) {
+    return status;
+  }
+  const absl::MutexLock lock(&mutex_);
+  Entry& entry = entries_[std::move(key)];
+  entry.stamp = stamp;
+  entry.proto = std::move(proto);
+  return entry.proto;
+}
+
+}  // namespace mbo::proto
@@ -0,0 +1,130 @@
+// SPDX-FileCopyrightText: Copyright (c) The helly25/mbo authors (helly25.com)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MBO_PROTO_FILE_CACHE_H_
+#define MBO_PROTO_FILE_CACHE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <source_location>
+#include <string>
+#include <utility>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
+#include "google/protobuf/descriptor.h"
+#include "google/protobuf/message.h"
+#include "mbo/proto/file.h"
+
+// Functionality for sharing parsed proto files:
+// - struct  ProtoFileCacheStats
+// - class   ProtoFileCache
+
+namespace mbo::proto {
+
+// Counters of a `ProtoFileCache`.
+struct ProtoFileCacheStats {
+  std::size_t hits = 0;    // Lookups answered from the cache.
+  std::size_t misses = 0;  // Lookups that read the file (including failed reads).
+};
+
+// Cache of parsed proto files that hands out immutable shared snapshots.
+//
+// Entries are keyed by the canonical path of the file and the message type. Each lookup `stat`s
+// the file and re-reads it if its modification time, size or inode changed, so the cache never
+// returns content older than the file at the time of the lookup. Previously returned snapshots stay
+// valid for as long as they are referenced. Errors are not cached.
+//
+// Files are read from their canonical path as by `ReadProtoFile`, so their format is picked by the
+// extension of the symlink target or by inspecting their first bytes.
+//
+// The cache is thread-safe and hits only take a shared lock. Concurrent misses for the same file may
+// read it more than once.
+//
+// Example:
+//
+// ```c++
+// absl::StatusOr<std::shared_ptr<const MyConfig>> config =
+//     ProtoFileCache::Global().Read<MyConfig>("config.txtpb");
+// ```
+class ProtoFileCache final {
+ public:
+  // The process-wide cache.
+  static ProtoFileCache& Global();
+
+  ProtoFileCache() = default;
+
+  ProtoFileCache(const ProtoFileCache&) = delete;
+  ProtoFileCache& operator=(const ProtoFileCache&) = delete;
+  ProtoFileCache(ProtoFileCache&&) = delete;
+  ProtoFileCache& operator=(ProtoFileCache&&) = delete;
+
+  ~ProtoFileCache() = default;
+
+  // Returns the parsed content of `filename`, reading the file only if it is not cached or if it
+  // changed since it was cached.
+  template<IsProtoType ProtoType>
+  absl::StatusOr<std::shared_ptr<const ProtoType>> Read(
+      const std::filesystem::path& filename,
+      const std::source_location& src_loc = std::source_location::current()) {
+    absl::StatusOr<std::shared_ptr<const ::google::protobuf::Message>> result =
+        Read(filename, ProtoType::default_instance(), src_loc);
+    if (!result.ok()) {
+      return result.status();
+    }
+    return std::static_pointer_cast<const ProtoType>(*std::move(result));
+  }
+
+  // Removes all entries. Snapshots already handed out remain valid.
+  void Clear();
+
+  ProtoFileCacheStats Stats() const;
+
+ private:
+  struct FileStamp {
+    bool operator==(const FileStamp&) const = default;
+
+    std::int64_t mtime = 0;  // Nanoseconds since the epoch.
+    std::uintmax_t size = 0;
+    std::uintmax_t device = 0;
+    std::uintmax_t inode = 0;
+  };
+
+  struct Entry {
+    FileStamp stamp;
+    std::shared_ptr<const ::google::protobuf::Message> proto;
+  };
+
+  using Key = std::pair<std::string, const ::google::protobuf::Descriptor*>;
+
+  absl::StatusOr<std::shared_ptr<const ::google::protobuf::Message>> Read(
+      const std::filesystem::path& filename,
+      const ::google::protobuf::Message& prototype,
+      const std::source_location& src_loc);
+
+  mutable absl::Mutex mutex_;
+  absl::flat_hash_map<Key, Entry> entries_ ABSL_GUARDED_BY(mutex_);
+  std::atomic<std::size_t> hits_{0};
+  std::atomic<std::size_t> misses_{0};
+};
+
+}  // namespace mbo::proto
+
+#endif  // MBO_PROTO_FILE_CACHE_H_
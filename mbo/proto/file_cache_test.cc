@@ -0,0 +1,159 @@
+// SPDX-FileCopyrightText: Copyright (c) The helly25/mbo authors (helly25.com)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mbo/proto/file_cache.h"
+
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <ios>
+#include <memory>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "mbo/proto/file.h"
+#include "mbo/proto/matchers.h"
+#include "mbo/proto/status_matchers.h"
+#include "mbo/proto/tests/simple_message.pb.h"
+#include "mbo/proto/tests/test.pb.h"
+
+namespace mbo::proto {
+namespace {
+// NOLINTBEGIN(*-magic-numbers)
+
+using ::mbo::proto::EqualsProto;
+using ::mbo::proto::tests::SimpleMessage;
+using ::mbo::proto::tests::TestMessage2;
+using ::testing::AllOf;
+using ::testing::Field;
+using ::testing::HasSubstr;
+using ::testing::Pointee;
+
+MATCHER_P2(StatsAre, hits, misses, "") {
+  return ExplainMatchResult(
+      ::testing::AllOf(Field(&ProtoFileCacheStats::hits, hits), Field(&ProtoFileCacheStats::misses, misses)), arg,
+      result_listener);
+}
+
+struct FileCacheTest : ::testing::Test {
+  [[nodiscard]] static bool WriteFile(const std::filesystem::path& filename, std::string_view data) {
+    std::ofstream output(filename, std::ios::binary);
+    if (output.good()) {
+      output << data;
+      output.close();
+    }
+    return output.good();
+  }
+
+  ProtoFileCache cache;
+};
+
+TEST_F(FileCacheTest, HitAndMiss) {
+  ASSERT_TRUE(WriteFile("cache.txtpb", "one: 25"));
+  const absl::StatusOr<std::shared_ptr<const SimpleMessage>> first = cache.Read<SimpleMessage>("cache.txtpb");
+  ASSERT_THAT(first, IsOkAndHolds(Pointee(EqualsProto("one: 25"))));
+  EXPECT_THAT(cache.Stats(), StatsAre(0, 1));
+  const absl::StatusOr<std::shared_ptr<const SimpleMessage>> second = cache.Read<SimpleMessage>("./cache.txtpb");
+  ASSERT_THAT(second, IsOk());
+  EXPECT_THAT(second->get(), first->get());  // Same canonical path.
+  EXPECT_THAT(cache.Stats(), StatsAre(1, 1));
+  // A different type is a different entry.
+  EXPECT_THAT(cache.Read<TestMessage2>("cache.txtpb"), StatusIs(absl::StatusCode::kAborted, HasSubstr("cache.txtpb")));
+  EXPECT_THAT(cache.Stats(), StatsAre(1, 2));
+  cache.Clear();
+  EXPECT_THAT(cache.Read<SimpleMessage>("cache.txtpb"), IsOkAndHolds(Pointee(EqualsProto("one: 25"))));
+  EXPECT_THAT(cache.Stats(), StatsAre(1, 3));
+}
+
+TEST_F(FileCacheTest, Invalidation) {
+  ASSERT_TRUE(WriteFile("cache.txtpb", "one: 25"));
+  const absl::StatusOr<std::shared_ptr<const SimpleMessage>> first = cache.Read<SimpleMessage>("cache.txtpb");
+  ASSERT_THAT(first, IsOkAndHolds(Pointee(EqualsProto("one: 25"))));
+  // Size changes.
+  ASSERT_TRUE(WriteFile("cache.txtpb", "one: 25 two: 42"));
+  const absl::StatusOr<std::shared_ptr<const SimpleMessage>> second = cache.Read<SimpleMessage>("cache.txtpb");
+  ASSERT_THAT(second, IsOkAndHolds(Pointee(EqualsProto("one: 25 two: 42"))));
+  EXPECT_THAT(*first, Pointee(EqualsProto("one: 25")));  // Old snapshots stay valid.
+  // Same size but a new inode.
+  ASSERT_TRUE(WriteFile("cache.tmp", "one: 33 two: 42"));
+  std::filesystem::rename("cache.tmp", "cache.txtpb");
+  EXPECT_THAT(cache.Read<SimpleMessage>("cache.txtpb"), IsOkAndHolds(Pointee(EqualsProto("one: 33 two: 42"))));
+  EXPECT_THAT(cache.Stats(), StatsAre(0, 3));
+}
+
+TEST_F(FileCacheTest, Symlink) {
+  ASSERT_TRUE(WriteFile("cache_a.txtpb", "one: 25"));
+  ASSERT_TRUE(WriteFile("cache_b.txtpb", "one: 33"));
+  std::filesystem::remove("cache_link.txtpb");
+  std::filesystem::create_symlink("cache_a.txtpb", "cache_link.txtpb");
+  EXPECT_THAT(cache.Read<SimpleMessage>("cache_link.txtpb"), IsOkAndHolds(Pointee(EqualsProto("one: 25"))));
+  EXPECT_THAT(cache.Read<SimpleMessage>("cache_a.txtpb"), IsOkAndHolds(Pointee(EqualsProto("one: 25"))));
+  EXPECT_THAT(cache.Stats(), StatsAre(1, 1));
+  std::filesystem::remove("cache_link.txtpb");
+  std::filesystem::create_symlink("cache_b.txtpb", "cache_link.txtpb");
+  EXPECT_THAT(cache.Read<SimpleMessage>("cache_link.txtpb"), IsOkAndHolds(Pointee(EqualsProto("one: 33"))));
+  EXPECT_THAT(cache.Read<SimpleMessage>("cache_a.txtpb"), IsOkAndHolds(Pointee(EqualsProto("one: 25"))));
+  EXPECT_THAT(cache.Stats(), StatsAre(2, 2));
+}
+
+TEST_F(FileCacheTest, Errors) {
+  EXPECT_THAT(
+      cache.Read<SimpleMessage>("DoesNotExist.txtpb"),
+      StatusIs(absl::StatusCode::kNotFound, HasSubstr("Cannot open 'DoesNotExist.txtpb'")));
+  ASSERT_TRUE(WriteFile("broken.json", "{"));
+  EXPECT_THAT(
+      cache.Read<SimpleMessage>("broken.json"),
+      StatusIs(
+          absl::StatusCode::kAborted, AllOf(HasSubstr("Cannot parse JSON proto file '"), HasSubstr("/broken.json'"))));
+  ASSERT_TRUE(WriteFile("broken.txtpb", "one: "));
+  EXPECT_THAT(cache.Read<SimpleMessage>("broken.txtpb"), StatusIs(absl::StatusCode::kAborted, HasSubstr("broken")));
+  // Errors are not cached.
+  EXPECT_THAT(cache.Read<SimpleMessage>("broken.txtpb"), StatusIs(absl::StatusCode::kAborted, HasSubstr("broken")));
+  EXPECT_THAT(cache.Stats(), StatsAre(0, 4));
+}
+
+TEST_F(FileCacheTest, Concurrent) {
+  SimpleMessage message;
+  message.set_one(25);
+  ASSERT_THAT(WriteBinaryProtoFile("cache.pb", message), IsOk());
+  static constexpr std::size_t kThreads = 8;
+  static constexpr std::size_t kReads = 100;
+  std::vector<std::thread> threads;
+  for (std::size_t thread = 0; thread < kThreads; ++thread) {
+    threads.emplace_back([this, &message] {
+      for (std::size_t read = 0; read < kReads; ++read) {
+        EXPECT_THAT(cache.Read<SimpleMessage>("cache.pb"), IsOkAndHolds(Pointee(EqualsProto(message))));
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  const ProtoFileCacheStats stats = cache.Stats();
+  EXPECT_THAT(stats.hits + stats.misses, kThreads * kReads);
+  EXPECT_THAT(stats.misses, ::testing::AllOf(::testing::Ge(1), ::testing::Le(kThreads)));
+}
+
+TEST_F(FileCacheTest, Global) {
+  EXPECT_THAT(&ProtoFileCache::Global(), &ProtoFileCache::Global());
+}
+
+// NOLINTEND(*-magic-numbers)
+}  // namespace
+}  // namespace mbo::proto
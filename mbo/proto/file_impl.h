@@ -18,24 +18,83 @@
 
 // IWYU pragma: private, include "mbo/proto/file.h"
 
+#include <sys/stat.h>
+
+#include <cstdint>
 #include <filesystem>
 #include <source_location>
+#include <string>
+#include <string_view>
 
+#include "absl/functional/function_ref.h"
 #include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "google/protobuf/arena.h"
+#include "google/protobuf/io/zero_copy_stream.h"
 #include "google/protobuf/message.h"
 
+namespace mbo::proto {
+
+class SilentErrorCollector;
+struct ReadBinaryProtoFileOptions;
+
+}  // namespace mbo::proto
+
 namespace mbo::proto::proto_internal {
 
+// Formats `src_loc` as "file:line" for error messages.
+std::string SrcLoc(const std::source_location& src_loc);
+
+// Returns the modification time from `info` in nanoseconds since the epoch.
+std::int64_t ModificationTimeNanos(const struct stat& info);
+
 absl::Status ReadBinaryProtoFile(
+    const std::filesystem::path& filename,
+    ::google::protobuf::Message& result,
+    const ReadBinaryProtoFileOptions& options,
+    const std::source_location& src_loc);
+
+absl::Status ReadTextProtoFile(
     const std::filesystem::path& filename,
     ::google::protobuf::Message& result,
     const std::source_location& src_loc);
 
+// Same as above but records parse errors into `error_collector`.
 absl::Status ReadTextProtoFile(
     const std::filesystem::path& filename,
     ::google::protobuf::Message& result,
+    SilentErrorCollector& error_collector,
     const std::source_location& src_loc);
 
+// Opens `filename` and calls `parse` with its content, which gets decompressed if `filename` has a
+// gzip extension. The `kind` names the file kind for error messages.
+absl::Status ParseFile(
+    const std::filesystem::path& filename,
+    std::string_view kind,
+    const std::source_location& src_loc,
+    absl::FunctionRef<absl::Status(::google::protobuf::io::ZeroCopyInputStream&)> parse);
+
+// Reads `filename` as binary, text or JSON proto, see `ReadProtoFile` in "mbo/proto/file.h".
+absl::Status ReadProtoFile(
+    const std::filesystem::path& filename,
+    ::google::protobuf::Message& result,
+    const ReadBinaryProtoFileOptions& binary_options,
+    const std::source_location& src_loc);
+
+// Creates a `ProtoType` on `arena` and reads it using `read`. If reading fails, then a heap allocated
+// message (`arena == nullptr`) gets deleted, while an arena allocated one is left to the arena.
+template<typename ProtoType, typename ReadFunc>
+absl::StatusOr<ProtoType*> ReadOnArena(::google::protobuf::Arena* arena, ReadFunc&& read) {
+  ProtoType* result = ::google::protobuf::Arena::Create<ProtoType>(arena);
+  if (absl::Status status = read(*result); !status.ok()) {
+    if (arena == nullptr) {
+      delete result;  // NOLINT(cppcoreguidelines-owning-memory)
+    }
+    return status;
+  }
+  return result;
+}
+
 }  // namespace mbo::proto::proto_internal
 
 #endif  // MBO_PROTO_FILE_IMPL_H_
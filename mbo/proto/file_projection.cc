@@ -0,0 +1,205 @@
+// SPDX-FileCopyrightText: Copyright (c) The helly25/mbo authors (helly25.com)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mbo/proto/file_projection.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <optional>
+#include <source_location>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/strip.h"
+#include "google/protobuf/descriptor.h"
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/io/gzip_stream.h"
+#include "google/protobuf/io/zero_copy_stream.h"
+#include "google/protobuf/io/zero_copy_stream_impl.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
+#include "google/protobuf/message.h"
+#include "google/protobuf/wire_format_lite.h"
+#include "mbo/proto/file.h"
+
+namespace mbo::proto {
+namespace {
+
+using ::google::protobuf::internal::WireFormatLite;
+using ::mbo::proto::proto_internal::SrcLoc;
+
+// The selected fields of a message by field number. A node without fields selects everything.
+struct Projection {
+  absl::flat_hash_map<int, Projection> fields;
+  bool complete = false;
+};
+
+absl::Status AddFieldPath(
+    std::string_view field_path,
+    const ::google::protobuf::Descriptor& root_descriptor,
+    Projection& root,
+    const std::source_location& src_loc) {
+  const ::google::protobuf::Descriptor* descriptor = &root_descriptor;
+  Projection* projection = &root;
+  std::string_view input = field_path;
+  for (bool last = false; !last;) {
+    const std::size_t dot = input.find('.');
+    std::string_view name = input.substr(0, dot);
+    last = dot == std::string_view::npos;
+    input.remove_prefix(last ? input.size() : dot + 1);
+    if (descriptor == nullptr) {
+      return absl::InvalidArgumentError(absl::StrFormat(
+          "Cannot project field path '%s' through a non message field @ %s.", field_path, SrcLoc(src_loc)));
+    }
+    const ::google::protobuf::FieldDescriptor* field = nullptr;
+    if (absl::ConsumePrefix(&name, "(") && absl::ConsumeSuffix(&name, ")")) {
+      field = descriptor->file()->pool()->FindExtensionByName(std::string(name));
+      if (field != nullptr && field->containing_type() != descriptor) {
+        field = nullptr;
+      }
+    } else if (name.find('[') == std::string_view::npos) {
+      field = descriptor->FindFieldByName(std::string(name));
+    }
+    if (field == nullptr) {
+      return absl::InvalidArgumentError(absl::StrFormat(
+          "Cannot project field path '%s': No field '%s' in '%s' @ %s.", field_path, name, descriptor->full_name(),
+          SrcLoc(src_loc)));
+    }
+    projection = &projection->fields[field->number()];
+    descriptor = field->message_type();
+  }
+  projection->complete = true;
+  projection->fields.clear();
+  return absl::OkStatus();
+}
+
+absl::StatusOr<Projection> MakeProjection(
+    const std::vector<std::string>& field_paths,
+    const ::google::protobuf::Descriptor& descriptor,
+    const std::source_location& src_loc) {
+  Projection projection;
+  for (const std::string& field_path : field_paths) {
+    if (absl::Status status = AddFieldPath(field_path, descriptor, projection, src_loc); !status.ok()) {
+      return status;
+    }
+  }
+  return projection;
+}
+
+// Copies the fields selected by `projection` from `input` to `output` in wire format. Returns false
+// if the input is not valid wire format.
+bool Project(
+    ::google::protobuf::io::CodedInputStream& input,
+    const Projection& projection,
+    ::google::protobuf::io::CodedOutputStream& output) {
+  while (true) {
+    const std::uint32_t tag = input.ReadTag();
+    if (tag == 0) {
+      return input.ConsumedEntireMessage();
+    }
+    const auto found = projection.fields.find(WireFormatLite::GetTagFieldNumber(tag));
+    if (found == projection.fields.end()) {
+      if (!WireFormatLite::SkipField(&input, tag)) {
+        return false;
+      }
+      continue;
+    }
+    // Groups are always copied completely.
+    if (found->second.complete || WireFormatLite::GetTagWireType(tag) != WireFormatLite::WIRETYPE_LENGTH_DELIMITED) {
+      if (!WireFormatLite::SkipField(&input, tag, &output)) {
+        return false;
+      }
+      continue;
+    }
+    std::uint32_t length = 0;
+    if (!input.ReadVarint32(&length) || length > static_cast<std::uint32_t>(std::numeric_limits<int>::max())) {
+      return false;
+    }
+    const ::google::protobuf::io::CodedInputStream::Limit limit = input.PushLimit(static_cast<int>(length));
+    std::string sub_message;
+    {
+      ::google::protobuf::io::StringOutputStream sub_stream(&sub_message);
+      ::google::protobuf::io::CodedOutputStream sub_output(&sub_stream);
+      if (!Project(input, found->second, sub_output)) {
+        return false;
+      }
+    }
+    input.PopLimit(limit);
+    output.WriteTag(tag);
+    output.WriteVarint32(static_cast<std::uint32_t>(sub_message.size()));
+    output.WriteString(sub_message);
+  }
+}
+
+// Projects all of `stream`. If `size` is known, then it must match the number of bytes consumed,
+// since skipping by seeking does not notice when a field extends past the end of the file.
+bool ProjectStream(
+    ::google::protobuf::io::ZeroCopyInputStream& stream,
+    const Projection& projection,
+    std::optional<off_t> size,
+    std::string& projected) {
+  ::google::protobuf::io::CodedInputStream input(&stream);
+  ::google::protobuf::io::StringOutputStream output_stream(&projected);
+  ::google::protobuf::io::CodedOutputStream output(&output_stream);
+  return Project(input, projection, output) && (!size.has_value() || input.CurrentPosition() == *size);
+}
+
+}  // namespace
+
+namespace proto_internal {
+
+absl::Status ReadBinaryProtoFileFields(
+    const std::filesystem::path& filename,
+    const std::vector<std::string>& field_paths,
+    ::google::protobuf::Message& result,
+    const std::source_location& src_loc) {
+  const absl::StatusOr<Projection> projection = MakeProjection(field_paths, *result.GetDescriptor(), src_loc);
+  if (!projection.ok()) {
+    return projection.status();
+  }
+  const int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);  // NOLINT(*-vararg)
+  if (fd < 0) {
+    return absl::NotFoundError(absl::StrFormat("Cannot open '%s' @ %s", filename, SrcLoc(src_loc)));
+  }
+  struct stat st{};
+  const bool is_regular = ::fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+  // Skipping large fields of an uncompressed file seeks over them instead of reading them.
+  ::google::protobuf::io::FileInputStream input(fd);
+  input.SetCloseOnDelete(true);
+  std::string projected;
+  bool projected_ok = false;
+  if (HasGzipExtension(filename)) {
+    ::google::protobuf::io::GzipInputStream gzip(&input, ::google::protobuf::io::GzipInputStream::GZIP);
+    projected_ok = ProjectStream(gzip, *projection, std::nullopt, projected) && gzip.ZlibErrorCode() >= 0;
+  } else {
+    projected_ok = ProjectStream(input, *projection, is_regular ? std::optional(st.st_size) : std::nullopt, projected);
+  }
+  if (!projected_ok || !result.ParsePartialFromString(projected)) {
+    return absl::AbortedError(absl::StrFormat("Cannot parse binary proto file '%s' @%s.", filename, SrcLoc(src_loc)));
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace proto_internal
+}  // namespace mbo::proto
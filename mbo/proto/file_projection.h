@@ -0,0 +1,78 @@
+// SPDX-FileCopyrightText: Copyright (c) The helly25/mbo authors (helly25.com)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MBO_PROTO_FILE_PROJECTION_H_
+#define MBO_PROTO_FILE_PROJECTION_H_
+
+#include <filesystem>
+#include <source_location>
+#include <string>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "google/protobuf/message.h"
+#include "mbo/proto/file.h"
+
+// Functionality for reading only some fields of a binary proto file:
+// - function  ReadBinaryProtoFileFields
+
+namespace mbo::proto::proto_internal {
+
+absl::Status ReadBinaryProtoFileFields(
+    const std::filesystem::path& filename,
+    const std::vector<std::string>& field_paths,
+    ::google::protobuf::Message& result,
+    const std::source_location& src_loc);
+
+}  // namespace mbo::proto::proto_internal
+
+namespace mbo::proto {
+
+// Reads only the fields selected by `field_paths` from the binary proto file `filename`.
+//
+// The field paths use the syntax of `IgnoringFieldPaths` in "mbo/proto/matchers.h": A dot
+// separated list of field names or parenthesized extension names, e.g. `header.version` or
+// `(my.package.ext).id`. A path selects the complete field it ends in. All intermediate fields must
+// be message fields and of those only the selected sub fields will be read. Index subscripts are
+// not supported.
+//
+// The wire format is walked without parsing: Fields that are not selected are skipped by their tag
+// and length, so large repeated payloads are neither decoded nor allocated. Files with a `.gz`
+// extension still have to be decompressed completely.
+//
+// Since unselected fields are missing, the result is not checked for required fields.
+//
+// Example:
+//
+// ```c++
+// const absl::StatusOr<MyProto> header = ReadBinaryProtoFileFields<MyProto>(filename, {"header"});
+// ```
+template<IsProtoType ProtoType>
+absl::StatusOr<ProtoType> ReadBinaryProtoFileFields(
+    const std::filesystem::path& filename,
+    const std::vector<std::string>& field_paths,
+    const std::source_location& src_loc = std::source_location::current()) {
+  ProtoType result;
+  if (absl::Status status = proto_internal::ReadBinaryProtoFileFields(filename, field_paths, result, src_loc);
+      !status.ok()) {
+    return status;
+  }
+  return result;
+}
+
+}  // namespace mbo::proto
+
+#endif  // MBO_PROTO_FILE_PROJECTION_H_
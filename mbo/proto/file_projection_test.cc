@@ -0,0 +1,124 @@
+// SPDX-FileCopyrightText: Copyright (c) The helly25/mbo authors (helly25.com)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mbo/proto/file_projection.h"
+
+#include <fstream>
+#include <ios>
+#include <string>
+#include <string_view>
+
+#include "absl/status/statusor.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "mbo/proto/file.h"
+#include "mbo/proto/matchers.h"
+#include "mbo/proto/parse_text_proto.h"
+#include "mbo/proto/status_matchers.h"
+#include "mbo/proto/tests/test.pb.h"
+
+namespace mbo::proto {
+namespace {
+// NOLINTBEGIN(*-magic-numbers)
+
+using ::mbo::proto::EqualsProto;
+using ::mbo::proto::tests::TestMessage2;
+using ::testing::HasSubstr;
+
+struct FileProjectionTest : ::testing::Test {
+  static TestMessage2 MakeMessage() {
+    return ParseTextProtoOrDie(R"pb(
+      num: [ 1, 2, 3 ]
+      one { name: "one" num: 1 val: 1.5 }
+      more { name: "a" num: 2 }
+      more { name: "b" num: 3 val: 2.5 }
+    )pb");
+  }
+};
+
+TEST_F(FileProjectionTest, SelectFields) {
+  ASSERT_THAT(WriteBinaryProtoFile("test.binpb", MakeMessage()), IsOk());
+  EXPECT_THAT(
+      ReadBinaryProtoFileFields<TestMessage2>("test.binpb", {}), IsOkAndHolds(EqualsProto(TestMessage2())));
+  EXPECT_THAT(
+      ReadBinaryProtoFileFields<TestMessage2>("test.binpb", {"num"}),
+      IsOkAndHolds(EqualsProto(R"pb(num: [ 1, 2, 3 ])pb")));
+  EXPECT_THAT(
+      ReadBinaryProtoFileFields<TestMessage2>("test.binpb", {"one"}),
+      IsOkAndHolds(EqualsProto(R"pb(one { name: "one" num: 1 val: 1.5 })pb")));
+  EXPECT_THAT(
+      ReadBinaryProtoFileFields<TestMessage2>("test.binpb", {"one.num", "more.name"}),
+      IsOkAndHolds(EqualsProto(R"pb(
+        one { num: 1 }
+        more { name: "a" }
+        more { name: "b" }
+      )pb")));
+  // A complete field wins over its sub fields regardless of the order.
+  EXPECT_THAT(
+      ReadBinaryProtoFileFields<TestMessage2>("test.binpb", {"more.num", "more"}),
+      IsOkAndHolds(EqualsProto(R"pb(
+        more { name: "a" num: 2 }
+        more { name: "b" num: 3 val: 2.5 }
+      )pb")));
+  EXPECT_THAT(
+      ReadBinaryProtoFileFields<TestMessage2>("test.binpb", {"more", "more.num"}),
+      IsOkAndHolds(EqualsProto(R"pb(
+        more { name: "a" num: 2 }
+        more { name: "b" num: 3 val: 2.5 }
+      )pb")));
+}
+
+TEST_F(FileProjectionTest, Gzip) {
+  ASSERT_THAT(WriteBinaryProtoFile("test.binpb.gz", MakeMessage()), IsOk());
+  EXPECT_THAT(
+      ReadBinaryProtoFileFields<TestMessage2>("test.binpb.gz", {"more.val"}),
+      IsOkAndHolds(EqualsProto(R"pb(
+        more {}
+        more { val: 2.5 }
+      )pb")));
+}
+
+TEST_F(FileProjectionTest, Errors) {
+  EXPECT_THAT(
+      ReadBinaryProtoFileFields<TestMessage2>("DoesNotExist.binpb", {"num"}),
+      StatusIs(absl::StatusCode::kNotFound, HasSubstr("Cannot open 'DoesNotExist.binpb'")));
+  ASSERT_THAT(WriteBinaryProtoFile("test.binpb", MakeMessage()), IsOk());
+  EXPECT_THAT(
+      ReadBinaryProtoFileFields<TestMessage2>("test.binpb", {"nope"}),
+      StatusIs(absl::StatusCode::kInvalidArgument, HasSubstr("No field 'nope' in 'mbo.proto.tests.TestMessage2'")));
+  EXPECT_THAT(
+      ReadBinaryProtoFileFields<TestMessage2>("test.binpb", {"one.nope"}),
+      StatusIs(absl::StatusCode::kInvalidArgument, HasSubstr("No field 'nope' in 'mbo.proto.tests.TestMessage'")));
+  EXPECT_THAT(
+      ReadBinaryProtoFileFields<TestMessage2>("test.binpb", {"num.nope"}),
+      StatusIs(absl::StatusCode::kInvalidArgument, HasSubstr("through a non message field")));
+  EXPECT_THAT(
+      ReadBinaryProtoFileFields<TestMessage2>("test.binpb", {"more[0]"}),
+      StatusIs(absl::StatusCode::kInvalidArgument, HasSubstr("No field 'more[0]'")));
+  {
+    std::ofstream output("corrupt.binpb", std::ios::binary | std::ios::trunc);
+    output << std::string_view("\x12\x05\x08", 3);  // Field `one` announces 5 bytes but has only 1.
+  }
+  EXPECT_THAT(
+      ReadBinaryProtoFileFields<TestMessage2>("corrupt.binpb", {"one.num"}),
+      StatusIs(absl::StatusCode::kAborted, HasSubstr("Cannot parse binary proto file 'corrupt.binpb'")));
+  EXPECT_THAT(
+      ReadBinaryProtoFileFields<TestMessage2>("corrupt.binpb", {"num"}),
+      StatusIs(absl::StatusCode::kAborted, HasSubstr("Cannot parse binary proto file 'corrupt.binpb'")));
+}
+
+// NOLINTEND(*-magic-numbers)
+}  // namespace
+}  // namespace mbo::proto
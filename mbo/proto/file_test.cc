@@ -15,11 +15,20 @@
 
 #include "mbo/proto/file.h"
 
+#include <sys/stat.h>
+
 #include <filesystem>
 #include <fstream>
 #include <ios>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
 
 #include "gmock/gmock.h"
+#include "google/protobuf/arena.h"
 #include "gtest/gtest.h"
 #include "mbo/proto/matchers.h"
 #include "mbo/proto/status_matchers.h"
@@ -37,6 +46,14 @@ using ::testing::Not;
 using ::testing::Optional;
 
 struct FileProtoTest : ::testing::Test {
+  // A valid gzip header followed by an invalid deflate block.
+  static constexpr std::string_view kCorruptGzip{"\x1F\x8B\x08\x00\x00\x00\x00\x00\x00\x03\xFF\xFF\xFF", 13};
+
+  [[nodiscard]] static std::string ReadFile(const std::filesystem::path& filename) {
+    std::ifstream input(filename, std::ios::binary);
+    return {std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>()};
+  }
+
   [[nodiscard]] static bool WriteFile(const std::filesystem::path& filename, std::string_view data) {
     std::ofstream output(filename, std::ios::binary);
     if (output.good()) {
@@ -73,6 +90,144 @@ TEST_F(FileProtoTest, BinaryProtoError) {
       StatusIs(absl::StatusCode::kAborted, HasSubstr("Cannot parse binary proto file 'SomeFile.pb'")));
 }
 
+TEST_F(FileProtoTest, BinaryProtoMemoryMapped) {
+  mbo::proto::tests::SimpleMessage message;
+  message.set_one(25);
+  message.add_two(33);
+  message.add_two(42);
+  ASSERT_THAT(WriteBinaryProtoFile("test.pb", message), IsOk());
+  static constexpr ReadBinaryProtoFileOptions kOptions{.memory_map = true};
+  const absl::StatusOr<SimpleMessage> result_or_status = ReadBinaryProtoFile("test.pb", kOptions);
+  EXPECT_THAT(result_or_status, IsOkAndHolds(EqualsProto(message)));
+  const std::optional<SimpleMessage> result_or_nullopt = ReadBinaryProtoFile("test.pb", kOptions);
+  EXPECT_THAT(result_or_nullopt, Optional(EqualsProto(message)));
+  EXPECT_THAT(SimpleMessage(ReadBinaryProtoFile("test.pb", kOptions)), EqualsProto(message));
+  EXPECT_THAT(ReadBinaryProtoFile::As<SimpleMessage>("test.pb", kOptions), IsOkAndHolds(EqualsProto(message)));
+  EXPECT_THAT(ReadBinaryProtoFile::OrNullopt<SimpleMessage>("test.pb", kOptions), Optional(EqualsProto(message)));
+  EXPECT_THAT(ReadBinaryProtoFile::OrDie<SimpleMessage>("test.pb", kOptions), EqualsProto(message));
+  // Empty files cannot be mapped but are valid empty messages.
+  ASSERT_TRUE(WriteFile("empty.pb", ""));
+  EXPECT_THAT(ReadBinaryProtoFile::As<SimpleMessage>("empty.pb", kOptions), IsOkAndHolds(EqualsProto("")));
+}
+
+TEST_F(FileProtoTest, BinaryProtoMemoryMappedError) {
+  static constexpr ReadBinaryProtoFileOptions kOptions{.memory_map = true};
+  EXPECT_THAT(
+      ReadBinaryProtoFile::As<SimpleMessage>("DoesNotExist.pb", kOptions),
+      StatusIs(absl::StatusCode::kNotFound, HasSubstr("Cannot open 'DoesNotExist.pb'")));
+  ASSERT_TRUE(WriteFile("SomeFile.pb", "\xFF"));
+  EXPECT_THAT(
+      ReadBinaryProtoFile::As<SimpleMessage>("SomeFile.pb", kOptions),
+      StatusIs(absl::StatusCode::kAborted, HasSubstr("Cannot parse binary proto file 'SomeFile.pb'")));
+}
+
+TEST_F(FileProtoTest, BinaryProtoMemoryMappedFallback) {
+  // A named pipe cannot be mapped, so reading falls back to the stream based path.
+  const std::filesystem::path fifo = "test.fifo";
+  std::filesystem::remove(fifo);
+  ASSERT_EQ(::mkfifo(fifo.c_str(), 0600), 0);
+  mbo::proto::tests::SimpleMessage message;
+  message.set_one(25);
+  message.add_two(42);
+  std::thread writer([&] { ASSERT_THAT(WriteBinaryProtoFile(fifo, message), IsOk()); });
+  EXPECT_THAT(
+      ReadBinaryProtoFile::As<SimpleMessage>(fifo, {.memory_map = true}), IsOkAndHolds(EqualsProto(message)));
+  writer.join();
+  std::filesystem::remove(fifo);
+}
+
+TEST_F(FileProtoTest, BinaryProtoOnArena) {
+  mbo::proto::tests::SimpleMessage message;
+  message.set_one(25);
+  message.add_two(33);
+  ASSERT_THAT(WriteBinaryProtoFile("test.pb", message), IsOk());
+  ::google::protobuf::Arena arena;
+  const absl::StatusOr<SimpleMessage*> result = ReadBinaryProtoFile::As<SimpleMessage>(&arena, "test.pb");
+  ASSERT_THAT(result, IsOk());
+  EXPECT_THAT(**result, EqualsProto(message));
+  EXPECT_THAT((*result)->GetArena(), &arena);
+  const SimpleMessage* const mapped =
+      ReadBinaryProtoFile::OrDie<SimpleMessage>(&arena, "test.pb", {.memory_map = true});
+  EXPECT_THAT(*mapped, EqualsProto(message));
+  EXPECT_THAT(mapped->GetArena(), &arena);
+  EXPECT_THAT(
+      ReadBinaryProtoFile::As<SimpleMessage>(&arena, "DoesNotExist.pb"),
+      StatusIs(absl::StatusCode::kNotFound, HasSubstr("Cannot open 'DoesNotExist.pb'")));
+  // Without an arena the caller owns the result.
+  const std::unique_ptr<SimpleMessage> owned(ReadBinaryProtoFile::OrDie<SimpleMessage>(nullptr, "test.pb"));
+  EXPECT_THAT(*owned, EqualsProto(message));
+}
+
+TEST_F(FileProtoTest, BinaryProtoGzip) {
+  mbo::proto::tests::SimpleMessage message;
+  message.set_one(25);
+  for (int i = 0; i < 100; ++i) {
+    message.add_two(42);
+  }
+  ASSERT_THAT(WriteBinaryProtoFile("test.pb.gz", message), IsOk());
+  const std::string data = ReadFile("test.pb.gz");
+  ASSERT_THAT(data.size(), ::testing::Gt(2));
+  EXPECT_THAT(data.substr(0, 2), "\x1F\x8B");  // Gzip magic
+  EXPECT_THAT(data.size(), ::testing::Lt(message.ByteSizeLong()));
+  EXPECT_THAT(ReadBinaryProtoFile::As<SimpleMessage>("test.pb.gz"), IsOkAndHolds(EqualsProto(message)));
+  EXPECT_THAT(
+      ReadBinaryProtoFile::As<SimpleMessage>("test.pb.gz", {.memory_map = true}), IsOkAndHolds(EqualsProto(message)));
+  ASSERT_TRUE(WriteFile("SomeFile.pb.gz", kCorruptGzip));
+  EXPECT_THAT(
+      ReadBinaryProtoFile::As<SimpleMessage>("SomeFile.pb.gz"),
+      StatusIs(absl::StatusCode::kAborted, HasSubstr("Cannot parse binary proto file 'SomeFile.pb.gz'")));
+  EXPECT_THAT(
+      ReadBinaryProtoFile::As<SimpleMessage>("SomeFile.pb.gz", {.memory_map = true}),
+      StatusIs(absl::StatusCode::kAborted, HasSubstr("Cannot parse binary proto file 'SomeFile.pb.gz'")));
+}
+
+TEST_F(FileProtoTest, WriteAtomic) {
+  static constexpr WriteProtoFileOptions kOptions{.atomic = true, .fsync = true};
+  const std::filesystem::path dir = "atomic";
+  std::filesystem::remove_all(dir);
+  ASSERT_TRUE(std::filesystem::create_directory(dir));
+  mbo::proto::tests::SimpleMessage message;
+  message.set_one(25);
+  ASSERT_THAT(WriteBinaryProtoFile(dir / "test.pb", message, kOptions), IsOk());
+  EXPECT_THAT(ReadBinaryProtoFile::As<SimpleMessage>(dir / "test.pb"), IsOkAndHolds(EqualsProto(message)));
+  // Replace the existing file.
+  message.add_two(42);
+  ASSERT_THAT(WriteBinaryProtoFile(dir / "test.pb", message, kOptions), IsOk());
+  EXPECT_THAT(ReadBinaryProtoFile::As<SimpleMessage>(dir / "test.pb"), IsOkAndHolds(EqualsProto(message)));
+  // Replacing keeps the permissions of the existing file.
+  static constexpr auto kPerms = std::filesystem::perms::owner_read | std::filesystem::perms::owner_write;
+  std::filesystem::permissions(dir / "test.pb", kPerms);
+  ASSERT_THAT(WriteBinaryProtoFile(dir / "test.pb", message, kOptions), IsOk());
+  EXPECT_THAT(std::filesystem::status(dir / "test.pb").permissions(), kPerms);
+  ASSERT_THAT(WriteTextProtoFile(dir / "test.txtpb.gz", message, kOptions), IsOk());
+  EXPECT_THAT(ReadTextProtoFile::As<SimpleMessage>(dir / "test.txtpb.gz"), IsOkAndHolds(EqualsProto(message)));
+  // No temporary files are left behind.
+  std::vector<std::string> files;
+  for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+    files.push_back(entry.path().filename());
+  }
+  EXPECT_THAT(files, ::testing::UnorderedElementsAre("test.pb", "test.txtpb.gz"));
+  EXPECT_THAT(
+      WriteBinaryProtoFile(dir / "missing" / "test.pb", message, kOptions),
+      StatusIs(absl::StatusCode::kAborted, HasSubstr("Cannot write binary proto file 'atomic/missing/test.pb'")));
+  EXPECT_THAT(
+      WriteTextProtoFile(dir / "missing" / "test.txtpb", message, kOptions),
+      StatusIs(absl::StatusCode::kAborted, HasSubstr("Cannot write text proto file 'atomic/missing/test.txtpb'")));
+  std::filesystem::remove_all(dir);
+}
+
+TEST_F(FileProtoTest, WriteBufferSize) {
+  mbo::proto::tests::SimpleMessage message;
+  for (int i = 0; i < 1000; ++i) {
+    message.add_two(i);
+  }
+  for (const int buffer_size : {-1, 0, 1, 7, 1 << 20}) {
+    ASSERT_THAT(WriteBinaryProtoFile("buffer.pb", message, {.buffer_size = buffer_size}), IsOk());
+    EXPECT_THAT(ReadBinaryProtoFile::As<SimpleMessage>("buffer.pb"), IsOkAndHolds(EqualsProto(message)))
+        << "buffer_size: " << buffer_size;
+  }
+}
+
 TEST_F(FileProtoTest, TextProto) {
   mbo::proto::tests::SimpleMessage message;
   message.set_one(25);
@@ -99,6 +254,39 @@ TEST_F(FileProtoTest, TextProtoError) {
       StatusIs(absl::StatusCode::kAborted, HasSubstr("Cannot parse text proto file 'SomeFile.textproto'")));
 }
 
+TEST_F(FileProtoTest, TextProtoGzip) {
+  mbo::proto::tests::SimpleMessage message;
+  message.set_one(25);
+  message.add_two(33);
+  message.add_two(42);
+  ASSERT_THAT(WriteTextProtoFile("test.txtpb.gz", message), IsOk());
+  EXPECT_THAT(ReadFile("test.txtpb.gz").substr(0, 2), "\x1F\x8B");  // Gzip magic
+  EXPECT_THAT(ReadTextProtoFile::As<SimpleMessage>("test.txtpb.gz"), IsOkAndHolds(EqualsProto(message)));
+  ASSERT_TRUE(WriteFile("SomeFile.txtpb.gz", kCorruptGzip));
+  EXPECT_THAT(
+      ReadTextProtoFile::As<SimpleMessage>("SomeFile.txtpb.gz"),
+      StatusIs(absl::StatusCode::kAborted, HasSubstr("Cannot parse text proto file 'SomeFile.txtpb.gz'")));
+}
+
+TEST_F(FileProtoTest, TextProtoOnArena) {
+  mbo::proto::tests::SimpleMessage message;
+  message.set_one(25);
+  message.add_two(33);
+  ASSERT_THAT(WriteTextProtoFile("test.textproto", message), IsOk());
+  ::google::protobuf::Arena arena;
+  const absl::StatusOr<SimpleMessage*> result = ReadTextProtoFile::As<SimpleMessage>(&arena, "test.textproto");
+  ASSERT_THAT(result, IsOk());
+  EXPECT_THAT(**result, EqualsProto(message));
+  EXPECT_THAT((*result)->GetArena(), &arena);
+  const SimpleMessage* const other = ReadTextProtoFile::OrDie<SimpleMessage>(&arena, "test.textproto");
+  EXPECT_THAT(*other, EqualsProto(message));
+  EXPECT_THAT(other->GetArena(), &arena);
+  ASSERT_TRUE(WriteFile("SomeFile.textproto", "\xFF"));
+  EXPECT_THAT(
+      ReadTextProtoFile::As<SimpleMessage>(nullptr, "SomeFile.textproto"),
+      StatusIs(absl::StatusCode::kAborted, HasSubstr("Cannot parse text proto file 'SomeFile.textproto'")));
+}
+
 MATCHER(IsBinaryProtoExtension, "") {
   return HasBinaryProtoExtension(arg);
 }
@@ -109,7 +297,8 @@ MATCHER(IsTextProtoExtension, "") {
 
 TEST_F(FileProtoTest, HasBinaryProtoExtension) {
   // True: binary proto
-  for (std::string_view filename : {".binpb", ".pb", "file.binpb", "dir.foo/file.pb", "..pb"}) {
+  for (std::string_view filename :
+       {".binpb", ".pb", "file.binpb", "dir.foo/file.pb", "..pb", "file.binpb.gz", ".pb.gz"}) {
     EXPECT_THAT(filename, IsBinaryProtoExtension());
   }
   // Type handling
@@ -134,7 +323,8 @@ TEST_F(FileProtoTest, HasBinaryProtoExtension) {
 
 TEST_F(FileProtoTest, HasTextProtoExtension) {
   // True: text proto
-  for (std::string_view filename : {".txtpb", ".textproto", "file.txtpb", "dir.foo/file.txtpb", "..txtpb"}) {
+  for (std::string_view filename :
+       {".txtpb", ".textproto", "file.txtpb", "dir.foo/file.txtpb", "..txtpb", "file.txtpb.gz", ".textproto.gz"}) {
     EXPECT_THAT(filename, IsTextProtoExtension());
   }
   // Type handling
@@ -160,6 +350,114 @@ TEST_F(FileProtoTest, HasTextProtoExtension) {
   }
 }
 
+TEST_F(FileProtoTest, HasGzipExtension) {
+  for (std::string_view filename : {".gz", "file.gz", "file.pb.gz", "file.txtpb.gz"}) {
+    EXPECT_TRUE(HasGzipExtension(filename)) << filename;
+  }
+  for (std::string_view filename : {"gz", "file.pb", "file.gz.pb", "file.gzip", ".tgz"}) {
+    EXPECT_FALSE(HasGzipExtension(filename)) << filename;
+  }
+  EXPECT_TRUE(HasGzipExtension(std::filesystem::path("file.pb.gz")));
+  EXPECT_FALSE(HasBinaryProtoExtension(".gz"));
+  EXPECT_FALSE(HasTextProtoExtension(".gz"));
+}
+
+TEST_F(FileProtoTest, HasJsonProtoExtension) {
+  for (std::string_view filename : {".json", "file.json", "file.json.gz"}) {
+    EXPECT_TRUE(HasJsonProtoExtension(filename)) << filename;
+  }
+  for (std::string_view filename : {"json", "file.pb", "file.txtpb", "file.jsonl", ".gz"}) {
+    EXPECT_FALSE(HasJsonProtoExtension(filename)) << filename;
+  }
+  EXPECT_TRUE(HasJsonProtoExtension(std::filesystem::path("file.json")));
+}
+
+TEST_F(FileProtoTest, SniffProtoFileFormat) {
+  EXPECT_THAT(SniffProtoFileFormat(""), ProtoFileFormat::kBinary);
+  EXPECT_THAT(SniffProtoFileFormat("\x08\x19"), ProtoFileFormat::kBinary);
+  EXPECT_THAT(SniffProtoFileFormat(std::string_view("\x0A\x00", 2)), ProtoFileFormat::kBinary);
+  EXPECT_THAT(SniffProtoFileFormat("one: 25"), ProtoFileFormat::kText);
+  EXPECT_THAT(SniffProtoFileFormat("# comment\n\tone: 25\r\n"), ProtoFileFormat::kText);
+  EXPECT_THAT(SniffProtoFileFormat("[ext] { }"), ProtoFileFormat::kText);
+  EXPECT_THAT(SniffProtoFileFormat("  \n"), ProtoFileFormat::kText);
+  EXPECT_THAT(SniffProtoFileFormat("{\"one\": 25}"), ProtoFileFormat::kJson);
+  EXPECT_THAT(SniffProtoFileFormat(" \n {}"), ProtoFileFormat::kJson);
+  // Printable binary data: A field #4 with 40 bytes.
+  const std::string printable = "\"(" + std::string(40, 'a');
+  EXPECT_THAT(SniffProtoFileFormat(printable), ProtoFileFormat::kBinary);
+  EXPECT_THAT(SniffProtoFileFormat(printable.substr(0, 30)), ProtoFileFormat::kText);
+  std::string long_printable;
+  for (int i = 0; i < 10; ++i) {
+    long_printable += printable;
+  }
+  EXPECT_THAT(SniffProtoFileFormat(long_printable), ProtoFileFormat::kBinary);
+}
+
+TEST_F(FileProtoTest, ReadProtoFile) {
+  mbo::proto::tests::SimpleMessage message;
+  message.set_one(25);
+  message.add_two(33);
+  message.add_two(42);
+  // By extension.
+  ASSERT_THAT(WriteBinaryProtoFile("any.pb", message), IsOk());
+  ASSERT_THAT(WriteTextProtoFile("any.txtpb", message), IsOk());
+  ASSERT_TRUE(WriteFile("any.json", R"({"one": 25, "two": [33, 42]})"));
+  for (const std::filesystem::path filename : {"any.pb", "any.txtpb", "any.json"}) {
+    EXPECT_THAT(ReadProtoFile::As<SimpleMessage>(filename), IsOkAndHolds(EqualsProto(message))) << filename;
+  }
+  // By content.
+  ASSERT_THAT(WriteBinaryProtoFile("binary.pb.gz", message), IsOk());
+  std::filesystem::rename("any.pb", "binary.data");
+  std::filesystem::rename("any.txtpb", "text.data");
+  std::filesystem::rename("any.json", "json.data");
+  std::filesystem::rename("binary.pb.gz", "binary.data.gz");
+  for (const std::filesystem::path filename : {"binary.data", "text.data", "json.data", "binary.data.gz"}) {
+    EXPECT_THAT(ReadProtoFile::As<SimpleMessage>(filename), IsOkAndHolds(EqualsProto(message))) << filename;
+  }
+  // Type-erased interface.
+  const absl::StatusOr<SimpleMessage> result_or_status = ReadProtoFile("text.data");
+  EXPECT_THAT(result_or_status, IsOkAndHolds(EqualsProto(message)));
+  const std::optional<SimpleMessage> result_or_nullopt = ReadProtoFile("json.data");
+  EXPECT_THAT(result_or_nullopt, Optional(EqualsProto(message)));
+  EXPECT_THAT(SimpleMessage(ReadProtoFile("binary.data")), EqualsProto(message));
+  ::google::protobuf::Arena arena;
+  EXPECT_THAT(ReadProtoFile::OrDie<SimpleMessage>(&arena, "binary.data")->GetArena(), &arena);
+  // Binary files without control characters, here an unknown field #4 with 40 bytes.
+  ASSERT_TRUE(WriteFile("printable.data", "\"(" + std::string(40, 'a')));
+  const absl::StatusOr<SimpleMessage> printable = ReadProtoFile::As<SimpleMessage>("printable.data");
+  ASSERT_THAT(printable, IsOk());
+  EXPECT_THAT(printable->ByteSizeLong(), 42);
+  // Empty files are empty messages.
+  ASSERT_TRUE(WriteFile("empty.data", ""));
+  EXPECT_THAT(ReadProtoFile::As<SimpleMessage>("empty.data"), IsOkAndHolds(EqualsProto("")));
+}
+
+TEST_F(FileProtoTest, ReadProtoFileError) {
+  EXPECT_THAT(
+      ReadProtoFile::As<SimpleMessage>("DoesNotExist.data"),
+      StatusIs(absl::StatusCode::kNotFound, HasSubstr("Cannot open 'DoesNotExist.data'")));
+  ASSERT_TRUE(WriteFile("broken.json", R"({"one": "x"})"));
+  EXPECT_THAT(
+      ReadProtoFile::As<SimpleMessage>("broken.json"),
+      StatusIs(absl::StatusCode::kAborted, HasSubstr("Cannot parse JSON proto file 'broken.json'")));
+  std::filesystem::rename("broken.json", "broken.data");
+  EXPECT_THAT(
+      ReadProtoFile::As<SimpleMessage>("broken.data"),
+      StatusIs(absl::StatusCode::kAborted, HasSubstr("Cannot parse JSON proto file 'broken.data'")));
+  ASSERT_TRUE(WriteFile("broken.data", "one: x"));
+  EXPECT_THAT(
+      ReadProtoFile::As<SimpleMessage>("broken.data"),
+      StatusIs(absl::StatusCode::kAborted, HasSubstr("Cannot parse text proto file 'broken.data'")));
+  ASSERT_TRUE(WriteFile("broken.data", "\x08\xFF"));  // Truncated varint.
+  EXPECT_THAT(
+      ReadProtoFile::As<SimpleMessage>("broken.data"),
+      StatusIs(absl::StatusCode::kAborted, HasSubstr("Cannot parse binary proto file 'broken.data'")));
+  ASSERT_TRUE(WriteFile("broken.data.gz", kCorruptGzip));
+  EXPECT_THAT(
+      ReadProtoFile::As<SimpleMessage>("broken.data.gz"),
+      StatusIs(absl::StatusCode::kAborted, HasSubstr("Cannot parse proto file 'broken.data.gz'")));
+}
+
 // NOLINTEND(*-magic-numbers)
 }  // namespace
 }  // namespace mbo::proto
@@ -0,0 +1,258 @@
+// SPDX-FileCopyrightText: Copyright (c) The helly25/mbo authors (helly25.com)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mbo/proto/float_compare.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <type_traits>
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace mbo::proto::proto_internal {
+namespace {
+
+// The comparison parameters converted to the value type.
+template<typename T>
+struct Tolerance {
+  bool approximate = false;
+  bool treat_nan_as_equal = false;
+  T fraction = 0;
+  T margin = 0;
+};
+
+template<typename T>
+Tolerance<T> MakeTolerance(const FloatComparison& comparison) {
+  Tolerance<T> tolerance{
+      .approximate = comparison.approximate,
+      .treat_nan_as_equal = comparison.treat_nan_as_equal,
+  };
+  if (comparison.has_tolerance) {
+    tolerance.fraction = static_cast<T>(comparison.fraction);
+    tolerance.margin = static_cast<T>(comparison.margin);
+  } else {
+    // Without a tolerance values are equal if they differ by less than 32 epsilon. That is the
+    // same as at most the next smaller value.
+    tolerance.margin = std::nextafter(32 * std::numeric_limits<T>::epsilon(), T{0});  // NOLINT(*-magic-numbers)
+  }
+  return tolerance;
+}
+
+template<typename T>
+bool ScalarEqual(T lhs, T rhs, const Tolerance<T>& tolerance) {
+  if (lhs == rhs) {
+    return true;
+  }
+  if (tolerance.treat_nan_as_equal && std::isnan(lhs) && std::isnan(rhs)) {
+    return true;
+  }
+  if (!tolerance.approximate || !std::isfinite(lhs) || !std::isfinite(rhs)) {
+    return false;
+  }
+  return std::abs(lhs - rhs) <= std::max(tolerance.margin, tolerance.fraction * std::max(std::abs(lhs), std::abs(rhs)));
+}
+
+// Compares all complete vectors of `Ops::kWidth` values. The `Ops` provide the vector operations
+// for one instruction set and value type. Returns the number of compared values, or `size` + 1 if a
+// pair of values differs.
+template<typename Ops, typename T = typename Ops::Scalar>
+std::size_t VectorsEqual(const T* lhs, const T* rhs, std::size_t size, const Tolerance<T>& tolerance) {
+  using Vec = typename Ops::Vec;
+  const Vec max_value = Ops::Set(std::numeric_limits<T>::max());
+  const Vec fraction = Ops::Set(tolerance.fraction);
+  const Vec margin = Ops::Set(tolerance.margin);
+  std::size_t index = 0;
+  for (; index + Ops::kWidth <= size; index += Ops::kWidth) {
+    const Vec lhs_values = Ops::Load(lhs + index);
+    const Vec rhs_values = Ops::Load(rhs + index);
+    Vec equal = Ops::Equal(lhs_values, rhs_values);
+    if (tolerance.treat_nan_as_equal) {
+      equal = Ops::Or(equal, Ops::And(Ops::IsNaN(lhs_values), Ops::IsNaN(rhs_values)));
+    }
+    if (tolerance.approximate) {
+      const Vec lhs_abs = Ops::Abs(lhs_values);
+      const Vec rhs_abs = Ops::Abs(rhs_values);
+      const Vec finite = Ops::And(Ops::LessEqual(lhs_abs, max_value), Ops::LessEqual(rhs_abs, max_value));
+      const Vec limit = Ops::Max(margin, Ops::Mul(fraction, Ops::Max(lhs_abs, rhs_abs)));
+      const Vec within = Ops::LessEqual(Ops::Abs(Ops::Sub(lhs_values, rhs_values)), limit);
+      equal = Ops::Or(equal, Ops::And(finite, within));
+    }
+    if (!Ops::AllTrue(equal)) {
+      return size + 1;
+    }
+  }
+  return index;
+}
+
+#if defined(__AVX__)
+
+struct FloatOps {
+  using Scalar = float;
+  using Vec = __m256;
+  static constexpr std::size_t kWidth = 8;
+
+  static Vec Load(const float* values) { return _mm256_loadu_ps(values); }
+
+  static Vec Set(float value) { return _mm256_set1_ps(value); }
+
+  static Vec Abs(Vec values) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0F), values); }
+
+  static Vec Sub(Vec lhs, Vec rhs) { return _mm256_sub_ps(lhs, rhs); }
+
+  static Vec Mul(Vec lhs, Vec rhs) { return _mm256_mul_ps(lhs, rhs); }
+
+  static Vec Max(Vec lhs, Vec rhs) { return _mm256_max_ps(lhs, rhs); }
+
+  static Vec Equal(Vec lhs, Vec rhs) { return _mm256_cmp_ps(lhs, rhs, _CMP_EQ_OQ); }
+
+  static Vec LessEqual(Vec lhs, Vec rhs) { return _mm256_cmp_ps(lhs, rhs, _CMP_LE_OQ); }
+
+  static Vec IsNaN(Vec values) { return _mm256_cmp_ps(values, values, _CMP_UNORD_Q); }
+
+  static Vec And(Vec lhs, Vec rhs) { return _mm256_and_ps(lhs, rhs); }
+
+  static Vec Or(Vec lhs, Vec rhs) { return _mm256_or_ps(lhs, rhs); }
+
+  static bool AllTrue(Vec mask) { return _mm256_movemask_ps(mask) == 0xFF; }  // NOLINT(*-magic-numbers)
+};
+
+struct DoubleOps {
+  using Scalar = double;
+  using Vec = __m256d;
+  static constexpr std::size_t kWidth = 4;
+
+  static Vec Load(const double* values) { return _mm256_loadu_pd(values); }
+
+  static Vec Set(double value) { return _mm256_set1_pd(value); }
+
+  static Vec Abs(Vec values) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), values); }
+
+  static Vec Sub(Vec lhs, Vec rhs) { return _mm256_sub_pd(lhs, rhs); }
+
+  static Vec Mul(Vec lhs, Vec rhs) { return _mm256_mul_pd(lhs, rhs); }
+
+  static Vec Max(Vec lhs, Vec rhs) { return _mm256_max_pd(lhs, rhs); }
+
+  static Vec Equal(Vec lhs, Vec rhs) { return _mm256_cmp_pd(lhs, rhs, _CMP_EQ_OQ); }
+
+  static Vec LessEqual(Vec lhs, Vec rhs) { return _mm256_cmp_pd(lhs, rhs, _CMP_LE_OQ); }
+
+  static Vec IsNaN(Vec values) { return _mm256_cmp_pd(values, values, _CMP_UNORD_Q); }
+
+  static Vec And(Vec lhs, Vec rhs) { return _mm256_and_pd(lhs, rhs); }
+
+  static Vec Or(Vec lhs, Vec rhs) { return _mm256_or_pd(lhs, rhs); }
+
+  static bool AllTrue(Vec mask) { return _mm256_movemask_pd(mask) == 0xF; }  // NOLINT(*-magic-numbers)
+};
+
+#elif defined(__SSE2__)
+
+struct FloatOps {
+  using Scalar = float;
+  using Vec = __m128;
+  static constexpr std::size_t kWidth = 4;
+
+  static Vec Load(const float* values) { return _mm_loadu_ps(values); }
+
+  static Vec Set(float value) { return _mm_set1_ps(value); }
+
+  static Vec Abs(Vec values) { return _mm_andnot_ps(_mm_set1_ps(-0.0F), values); }
+
+  static Vec Sub(Vec lhs, Vec rhs) { return _mm_sub_ps(lhs, rhs); }
+
+  static Vec Mul(Vec lhs, Vec rhs) { return _mm_mul_ps(lhs, rhs); }
+
+  static Vec Max(Vec lhs, Vec rhs) { return _mm_max_ps(lhs, rhs); }
+
+  static Vec Equal(Vec lhs, Vec rhs) { return _mm_cmpeq_ps(lhs, rhs); }
+
+  static Vec LessEqual(Vec lhs, Vec rhs) { return _mm_cmple_ps(lhs, rhs); }
+
+  static Vec IsNaN(Vec values) { return _mm_cmpunord_ps(values, values); }
+
+  static Vec And(Vec lhs, Vec rhs) { return _mm_and_ps(lhs, rhs); }
+
+  static Vec Or(Vec lhs, Vec rhs) { return _mm_or_ps(lhs, rhs); }
+
+  static bool AllTrue(Vec mask) { return _mm_movemask_ps(mask) == 0xF; }  // NOLINT(*-magic-numbers)
+};
+
+struct DoubleOps {
+  using Scalar = double;
+  using Vec = __m128d;
+  static constexpr std::size_t kWidth = 2;
+
+  static Vec Load(const double* values) { return _mm_loadu_pd(values); }
+
+  static Vec Set(double value) { return _mm_set1_pd(value); }
+
+  static Vec Abs(Vec values) { return _mm_andnot_pd(_mm_set1_pd(-0.0), values); }
+
+  static Vec Sub(Vec lhs, Vec rhs) { return _mm_sub_pd(lhs, rhs); }
+
+  static Vec Mul(Vec lhs, Vec rhs) { return _mm_mul_pd(lhs, rhs); }
+
+  static Vec Max(Vec lhs, Vec rhs) { return _mm_max_pd(lhs, rhs); }
+
+  static Vec Equal(Vec lhs, Vec rhs) { return _mm_cmpeq_pd(lhs, rhs); }
+
+  static Vec LessEqual(Vec lhs, Vec rhs) { return _mm_cmple_pd(lhs, rhs); }
+
+  static Vec IsNaN(Vec values) { return _mm_cmpunord_pd(values, values); }
+
+  static Vec And(Vec lhs, Vec rhs) { return _mm_and_pd(lhs, rhs); }
+
+  static Vec Or(Vec lhs, Vec rhs) { return _mm_or_pd(lhs, rhs); }
+
+  static bool AllTrue(Vec mask) { return _mm_movemask_pd(mask) == 0x3; }  // NOLINT(*-magic-numbers)
+};
+
+#endif  // defined(__AVX__) || defined(__SSE2__)
+
+template<typename T>
+bool FloatsEqualImpl(const T* lhs, const T* rhs, std::size_t size, const FloatComparison& comparison) {
+  const Tolerance<T> tolerance = MakeTolerance<T>(comparison);
+  std::size_t index = 0;
+#if defined(__AVX__) || defined(__SSE2__)
+  using Ops = std::conditional_t<std::is_same_v<T, float>, FloatOps, DoubleOps>;
+  index = VectorsEqual<Ops>(lhs, rhs, size, tolerance);
+  if (index > size) {
+    return false;
+  }
+#endif  // defined(__AVX__) || defined(__SSE2__)
+  for (; index < size; ++index) {
+    if (!ScalarEqual(lhs[index], rhs[index], tolerance)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+bool FloatsEqual(const float* lhs, const float* rhs, std::size_t size, const FloatComparison& comparison) {
+  return FloatsEqualImpl(lhs, rhs, size, comparison);
+}
+
+bool FloatsEqual(const double* lhs, const double* rhs, std::size_t size, const FloatComparison& comparison) {
+  return FloatsEqualImpl(lhs, rhs, size, comparison);
+}
+
+}  // namespace mbo::proto::proto_internal
@@ -0,0 +1,48 @@
+// SPDX-FileCopyrightText: Copyright (c) The helly25/mbo authors (helly25.com)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MBO_PROTO_FLOAT_COMPARE_H_
+#define MBO_PROTO_FLOAT_COMPARE_H_
+
+// IWYU pragma: private
+
+#include <cstddef>
+
+namespace mbo::proto::proto_internal {
+
+// How floating point values are compared. This follows the semantics of
+// `google::protobuf::util::DefaultFieldComparator`.
+struct FloatComparison {
+  // Compare approximately rather than exactly.
+  bool approximate = false;
+
+  // Two NaNs are equal.
+  bool treat_nan_as_equal = false;
+
+  // Approximate comparison uses `fraction` and `margin` rather than a fixed small epsilon. Two finite
+  // values are equal if they differ by at most `margin` or by at most `fraction` of the larger one.
+  bool has_tolerance = false;
+  double fraction = 0.0;
+  double margin = 0.0;
+};
+
+// Returns whether `lhs[i]` and `rhs[i]` compare equal for all `i` in [0, `size`). The values get
+// compared in bulk using AVX or SSE2 vectors where the target supports them.
+bool FloatsEqual(const float* lhs, const float* rhs, std::size_t size, const FloatComparison& comparison);
+bool FloatsEqual(const double* lhs, const double* rhs, std::size_t size, const FloatComparison& comparison);
+
+}  // namespace mbo::proto::proto_internal
+
+#endif  // MBO_PROTO_FLOAT_COMPARE_H_
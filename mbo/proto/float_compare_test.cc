@@ -0,0 +1,149 @@
+// SPDX-FileCopyrightText: Copyright (c) The helly25/mbo authors (helly25.com)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mbo/proto/float_compare.h"
+
+#include <cstddef>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "google/protobuf/descriptor.h"
+#include "google/protobuf/util/field_comparator.h"
+#include "gtest/gtest.h"
+#include "mbo/proto/tests/test.pb.h"
+
+namespace mbo::proto::proto_internal {
+namespace {
+
+using ::google::protobuf::util::DefaultFieldComparator;
+using ::google::protobuf::util::FieldComparator;
+using ::mbo::proto::tests::TestFloats;
+
+struct Setting {
+  std::string name;
+  FloatComparison comparison;
+};
+
+std::vector<Setting> Settings() {
+  return {
+      {"Exact", {}},
+      {"ExactNaN", {.treat_nan_as_equal = true}},
+      {"Approximate", {.approximate = true}},
+      {"ApproximateNaN", {.approximate = true, .treat_nan_as_equal = true}},
+      {"Margin", {.approximate = true, .has_tolerance = true, .margin = 0.01}},
+      {"Fraction", {.approximate = true, .has_tolerance = true, .fraction = 0.01}},
+      {"FractionOrMargin", {.approximate = true, .has_tolerance = true, .fraction = 0.05, .margin = 1.0}},
+      {"FractionNaN", {.approximate = true, .treat_nan_as_equal = true, .has_tolerance = true, .fraction = 0.1}},
+  };
+}
+
+std::vector<double> Values() {
+  constexpr double kInf = std::numeric_limits<double>::infinity();
+  constexpr double kEps = std::numeric_limits<double>::epsilon();
+  constexpr float kFloatEps = std::numeric_limits<float>::epsilon();
+  return {
+      0.0,
+      -0.0,
+      1.0,
+      -1.0,
+      1.0 + 31 * kEps,
+      1.0 + 33 * kEps,
+      1.0 + 31 * kFloatEps,
+      1.0 + 33 * kFloatEps,
+      1.005,
+      1.02,
+      1.1,
+      2.0,
+      0.5,
+      0.505,
+      100.0,
+      100.9,
+      104.0,
+      1e10,
+      1.01e10,
+      1e-300,
+      std::numeric_limits<double>::denorm_min(),
+      std::numeric_limits<double>::max(),
+      std::numeric_limits<float>::max(),
+      kInf,
+      -kInf,
+      std::numeric_limits<double>::quiet_NaN(),
+  };
+}
+
+// Compares the `value` of `field` in `lhs` and `rhs` the way the MessageDifferencer does.
+bool ComparatorEqual(
+    const FloatComparison& comparison,
+    const TestFloats& lhs,
+    const TestFloats& rhs,
+    const ::google::protobuf::FieldDescriptor* field) {
+  DefaultFieldComparator comparator;
+  comparator.set_float_comparison(
+      comparison.approximate ? DefaultFieldComparator::APPROXIMATE : DefaultFieldComparator::EXACT);
+  comparator.set_treat_nan_as_equal(comparison.treat_nan_as_equal);
+  if (comparison.has_tolerance) {
+    comparator.SetDefaultFractionAndMargin(comparison.fraction, comparison.margin);
+  }
+  return comparator.Compare(lhs, rhs, field, 0, 0, nullptr) == FieldComparator::SAME;
+}
+
+template<typename T>
+void ExpectSameAsComparator(const ::google::protobuf::FieldDescriptor* field) {
+  const std::vector<double> values = Values();
+  for (const Setting& setting : Settings()) {
+    for (const double lhs_value : values) {
+      for (const double rhs_value : values) {
+        TestFloats lhs;
+        TestFloats rhs;
+        lhs.add_floats(static_cast<float>(lhs_value));
+        rhs.add_floats(static_cast<float>(rhs_value));
+        lhs.add_doubles(lhs_value);
+        rhs.add_doubles(rhs_value);
+        const bool expected = ComparatorEqual(setting.comparison, lhs, rhs, field);
+        const auto lhs_scalar = static_cast<T>(lhs_value);
+        const auto rhs_scalar = static_cast<T>(rhs_value);
+        EXPECT_EQ(FloatsEqual(&lhs_scalar, &rhs_scalar, 1, setting.comparison), expected)
+            << setting.name << ": " << lhs_scalar << " vs " << rhs_scalar;
+
+        // Also exercise the vectorized comparison with the pair at different positions.
+        for (const std::size_t position : {0, 5, 16, 30}) {
+          std::vector<T> lhs_values(31, T{1});
+          std::vector<T> rhs_values(31, T{1});
+          lhs_values[position] = lhs_scalar;
+          rhs_values[position] = rhs_scalar;
+          EXPECT_EQ(FloatsEqual(lhs_values.data(), rhs_values.data(), lhs_values.size(), setting.comparison), expected)
+              << setting.name << ": " << lhs_scalar << " vs " << rhs_scalar << " @ " << position;
+        }
+      }
+    }
+  }
+}
+
+TEST(FloatCompareTest, FloatSameAsFieldComparator) {
+  ExpectSameAsComparator<float>(TestFloats::descriptor()->FindFieldByName("floats"));
+}
+
+TEST(FloatCompareTest, DoubleSameAsFieldComparator) {
+  ExpectSameAsComparator<double>(TestFloats::descriptor()->FindFieldByName("doubles"));
+}
+
+TEST(FloatCompareTest, Empty) {
+  EXPECT_TRUE(FloatsEqual(static_cast<const double*>(nullptr), nullptr, 0, {}));
+}
+
+}  // namespace
+}  // namespace mbo::proto::proto_internal
@@ -0,0 +1,174 @@
+// SPDX-FileCopyrightText: Copyright (c) The helly25/mbo authors (helly25.com)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Writes a corpus of random messages created by `MessageGenerator`, see "mbo/proto/message_generator.h".
+//
+// Usage:
+//   generate_proto_corpus --message=<full.Name> --descriptor_set=<file> [--descriptor_set=<file>...]
+//                         --output=<file> [--count=<n>] [--seed=<n>] [--target_bytes=<n>] [--max_depth=<n>]
+//                         [--min_repeated=<n>] [--max_repeated=<n>] [--field_presence=<p>]
+//                         [--max_string_length=<n>] [--float_min=<x>] [--float_max=<x>]
+//                         [--float_nan_fraction=<p>]
+//
+// The extension of `--output` selects a binary (e.g. `.pb`) or a text (e.g. `.txtpb`) proto file,
+// optionally gzip compressed (`.gz`). With `--count` greater than one, the index of each message is
+// inserted before the extension: `corpus.pb` becomes `corpus-0.pb`, `corpus-1.pb`, ... Message `i`
+// uses seed `seed + i`, so every file can be reproduced on its own.
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "google/protobuf/descriptor.h"
+#include "google/protobuf/descriptor_database.h"
+#include "google/protobuf/dynamic_message.h"
+#include "google/protobuf/message.h"
+#include "mbo/proto/descriptor_sets.h"
+#include "mbo/proto/file.h"
+#include "mbo/proto/message_generator.h"
+
+namespace mbo::proto {
+namespace {
+
+struct Args {
+  std::string message;
+  std::vector<std::filesystem::path> descriptor_sets;
+  std::filesystem::path output;
+  std::size_t count = 1;
+  MessageGeneratorOptions options;
+};
+
+template<typename T>
+bool ParseNumber(std::string_view text, T& value) {
+  if constexpr (std::is_same_v<T, double>) {
+    return absl::SimpleAtod(text, &value);
+  } else {
+    return absl::SimpleAtoi(text, &value);
+  }
+}
+
+absl::StatusOr<Args> ParseArgs(int argc, char** argv) {
+  Args args;
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view arg = argv[i];  // NOLINT(*-pointer-arithmetic)
+    const std::size_t pos = arg.find('=');
+    const std::string_view name = arg.substr(0, pos);
+    const std::string_view value = pos == std::string_view::npos ? "" : arg.substr(pos + 1);
+    bool valid = pos != std::string_view::npos;
+    if (name == "--message") {
+      args.message = value;
+    } else if (name == "--descriptor_set") {
+      args.descriptor_sets.emplace_back(value);
+    } else if (name == "--output") {
+      args.output = value;
+    } else if (name == "--count") {
+      valid = valid && ParseNumber(value, args.count);
+    } else if (name == "--seed") {
+      valid = valid && ParseNumber(value, args.options.seed);
+    } else if (name == "--target_bytes") {
+      valid = valid && ParseNumber(value, args.options.target_bytes);
+    } else if (name == "--max_depth") {
+      valid = valid && ParseNumber(value, args.options.max_depth);
+    } else if (name == "--min_repeated") {
+      valid = valid && ParseNumber(value, args.options.min_repeated);
+    } else if (name == "--max_repeated") {
+      valid = valid && ParseNumber(value, args.options.max_repeated);
+    } else if (name == "--field_presence") {
+      valid = valid && ParseNumber(value, args.options.field_presence);
+    } else if (name == "--max_string_length") {
+      valid = valid && ParseNumber(value, args.options.max_string_length);
+    } else if (name == "--float_min") {
+      valid = valid && ParseNumber(value, args.options.float_min);
+    } else if (name == "--float_max") {
+      valid = valid && ParseNumber(value, args.options.float_max);
+    } else if (name == "--float_nan_fraction") {
+      valid = valid && ParseNumber(value, args.options.float_nan_fraction);
+    } else {
+      return absl::InvalidArgumentError(absl::StrFormat("Unknown argument '%s'.", arg));
+    }
+    if (!valid) {
+      return absl::InvalidArgumentError(absl::StrFormat("Invalid argument '%s'.", arg));
+    }
+  }
+  if (args.message.empty() || args.output.empty() || args.descriptor_sets.empty()) {
+    return absl::InvalidArgumentError("Flags --message, --output and --descriptor_set are required.");
+  }
+  if (!HasBinaryProtoExtension(args.output) && !HasTextProtoExtension(args.output)) {
+    return absl::InvalidArgumentError(
+        absl::StrFormat("Cannot determine binary or text format from extension of '%s'.", args.output));
+  }
+  return args;
+}
+
+// Inserts `-<index>` before the extension(s) of `output`.
+std::filesystem::path IndexedFilename(const std::filesystem::path& output, std::size_t index) {
+  const std::string basename = output.filename().string();
+  const std::size_t dot = basename.find('.');
+  return output.parent_path() /
+         absl::StrCat(basename.substr(0, dot), "-", index, dot == std::string::npos ? "" : basename.substr(dot));
+}
+
+absl::Status Run(const Args& args) {
+  ::google::protobuf::SimpleDescriptorDatabase database;
+  if (absl::Status status = proto_internal::LoadDescriptorSets(args.descriptor_sets, database); !status.ok()) {
+    return status;
+  }
+  const ::google::protobuf::DescriptorPool pool(&database);
+  const ::google::protobuf::Descriptor* descriptor = pool.FindMessageTypeByName(args.message);
+  if (descriptor == nullptr) {
+    return absl::NotFoundError(absl::StrFormat("Cannot find message type '%s'.", args.message));
+  }
+  ::google::protobuf::DynamicMessageFactory factory(&pool);
+  const std::unique_ptr<::google::protobuf::Message> message(factory.GetPrototype(descriptor)->New());
+  for (std::size_t index = 0; index < args.count; ++index) {
+    MessageGeneratorOptions options = args.options;
+    options.seed += index;
+    MessageGenerator(options).Fill(*message);
+    const std::filesystem::path filename = args.count == 1 ? args.output : IndexedFilename(args.output, index);
+    const absl::Status status = HasBinaryProtoExtension(filename) ? WriteBinaryProtoFile(filename, *message)
+                                                                  : WriteTextProtoFile(filename, *message);
+    if (!status.ok()) {
+      return status;
+    }
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace
+}  // namespace mbo::proto
+
+int main(int argc, char** argv) {
+  const absl::StatusOr<mbo::proto::Args> args = mbo::proto::ParseArgs(argc, argv);
+  if (!args.ok()) {
+    std::cerr << args.status() << "\n";
+    return 1;
+  }
+  if (const absl::Status status = mbo::proto::Run(*args); !status.ok()) {
+    std::cerr << status << "\n";
+    return 1;
+  }
+  return 0;
+}
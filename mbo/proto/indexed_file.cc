@@ -0,0 +1,212 @@
+// SPDX-FileCopyrightText: Copyright (c) The helly25/mbo authors (helly25.com)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mbo/proto/indexed_file.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <source_location>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "absl/log/absl_log.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_format.h"
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/io/zero_copy_stream_impl.h"
+#include "google/protobuf/message.h"
+#include "mbo/proto/file.h"
+#include "mbo/proto/mapped_file.h"
+
+namespace mbo::proto {
+namespace {
+
+using ::mbo::proto::proto_internal::SrcLoc;
+
+constexpr std::string_view kMagic = "MBOPBIDX";
+constexpr std::size_t kFooterSize = 2 * sizeof(std::uint64_t) + kMagic.size();
+
+std::uint64_t ReadFixed64(std::string_view data, std::size_t offset) {
+  std::uint64_t value = 0;
+  ::google::protobuf::io::CodedInputStream::ReadLittleEndian64FromArray(
+      reinterpret_cast<const std::uint8_t*>(data.data() + offset), &value);  // NOLINT(*-reinterpret-cast)
+  return value;
+}
+
+}  // namespace
+
+absl::StatusOr<IndexedProtoFileWriter> IndexedProtoFileWriter::Open(
+    const std::filesystem::path& filename,
+    const std::source_location& src_loc) {
+  // NOLINTNEXTLINE(*-vararg)
+  const int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+  if (fd < 0) {
+    return absl::AbortedError(absl::StrFormat("Cannot open '%s' for writing @ %s.", filename, SrcLoc(src_loc)));
+  }
+  return IndexedProtoFileWriter(filename, src_loc, fd);
+}
+
+IndexedProtoFileWriter::IndexedProtoFileWriter(
+    std::filesystem::path filename,
+    const std::source_location& src_loc,
+    int fd)
+    : filename_(std::move(filename)),
+      src_loc_(src_loc),
+      output_(std::make_unique<::google::protobuf::io::FileOutputStream>(fd)) {}
+
+IndexedProtoFileWriter::IndexedProtoFileWriter(IndexedProtoFileWriter&&) noexcept = default;
+
+IndexedProtoFileWriter::~IndexedProtoFileWriter() {
+  if (output_ != nullptr) {
+    const absl::Status status = Close();
+    ABSL_LOG_IF(ERROR, !status.ok()) << status;
+  }
+}
+
+absl::Status IndexedProtoFileWriter::Write(const ::google::protobuf::Message& message) {
+  if (output_ == nullptr) {
+    return absl::FailedPreconditionError(
+        absl::StrFormat("Cannot write to closed file '%s' @ %s.", filename_, SrcLoc(src_loc_)));
+  }
+  const auto offset = static_cast<std::uint64_t>(output_->ByteCount());
+  {
+    ::google::protobuf::io::CodedOutputStream coded(output_.get());
+    coded.WriteVarint64(message.ByteSizeLong());
+    if (!message.SerializeToCodedStream(&coded) || coded.HadError()) {
+      return absl::AbortedError(absl::StrFormat(
+          "Cannot write indexed proto #%d to file '%s' @ %s.", offsets_.size(), filename_, SrcLoc(src_loc_)));
+    }
+  }
+  offsets_.push_back(offset);
+  return absl::OkStatus();
+}
+
+absl::Status IndexedProtoFileWriter::Close() {
+  if (output_ == nullptr) {
+    return absl::FailedPreconditionError(
+        absl::StrFormat("Cannot close already closed file '%s' @ %s.", filename_, SrcLoc(src_loc_)));
+  }
+  const std::unique_ptr<::google::protobuf::io::FileOutputStream> output = std::move(output_);
+  bool written = false;
+  {
+    const auto index_offset = static_cast<std::uint64_t>(output->ByteCount());
+    ::google::protobuf::io::CodedOutputStream coded(output.get());
+    for (const std::uint64_t offset : offsets_) {
+      coded.WriteLittleEndian64(offset);
+    }
+    coded.WriteLittleEndian64(index_offset);
+    coded.WriteLittleEndian64(offsets_.size());
+    coded.WriteRaw(kMagic.data(), static_cast<int>(kMagic.size()));
+    written = !coded.HadError();
+  }
+  if (!output->Close() || !written) {
+    return absl::AbortedError(
+        absl::StrFormat("Cannot write indexed proto file '%s' @ %s.", filename_, SrcLoc(src_loc_)));
+  }
+  return absl::OkStatus();
+}
+
+absl::StatusOr<IndexedProtoFile> IndexedProtoFile::Open(
+    const std::filesystem::path& filename,
+    const std::source_location& src_loc) {
+  const int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);  // NOLINT(*-vararg)
+  if (fd < 0) {
+    return absl::NotFoundError(absl::StrFormat("Cannot open '%s' @ %s", filename, SrcLoc(src_loc)));
+  }
+  std::optional<proto_internal::MappedFile> mapped =
+      proto_internal::MappedFile::Map(fd, proto_internal::MappedFile::Access::kRandom);
+  ::close(fd);
+  if (!mapped.has_value()) {
+    return absl::FailedPreconditionError(
+        absl::StrFormat("Cannot memory map indexed proto file '%s' @ %s.", filename, SrcLoc(src_loc)));
+  }
+  const std::string_view data = mapped->data();
+  if (data.size() < kFooterSize || !data.ends_with(kMagic)) {
+    return absl::DataLossError(
+        absl::StrFormat("Cannot find index of indexed proto file '%s' @ %s.", filename, SrcLoc(src_loc)));
+  }
+  const std::size_t footer = data.size() - kFooterSize;
+  const std::uint64_t index_offset = ReadFixed64(data, footer);
+  const std::uint64_t size = ReadFixed64(data, footer + sizeof(std::uint64_t));
+  if (index_offset > footer || size != (footer - index_offset) / sizeof(std::uint64_t)
+      || (footer - index_offset) % sizeof(std::uint64_t) != 0) {
+    return absl::DataLossError(
+        absl::StrFormat("Cannot read corrupt index of indexed proto file '%s' @ %s.", filename, SrcLoc(src_loc)));
+  }
+  return IndexedProtoFile(
+      filename, src_loc, *std::move(mapped), static_cast<std::size_t>(index_offset), static_cast<std::size_t>(size));
+}
+
+IndexedProtoFile::IndexedProtoFile(
+    std::filesystem::path filename,
+    const std::source_location& src_loc,
+    proto_internal::MappedFile mapped,
+    std::size_t index_offset,
+    std::size_t size)
+    : filename_(std::move(filename)),
+      src_loc_(src_loc),
+      mapped_(std::move(mapped)),
+      index_offset_(index_offset),
+      size_(size) {}
+
+absl::StatusOr<std::string_view> IndexedProtoFile::ReadRaw(std::size_t index) const {
+  if (index >= size_) {
+    return absl::OutOfRangeError(absl::StrFormat(
+        "Cannot read record #%d of %d records from indexed proto file '%s' @ %s.", index, size_, filename_,
+        SrcLoc(src_loc_)));
+  }
+  const std::string_view data = mapped_.data();
+  const std::uint64_t offset = ReadFixed64(data, index_offset_ + index * sizeof(std::uint64_t));
+  if (offset < index_offset_) {
+    const std::string_view record = data.substr(offset, index_offset_ - offset);
+    ::google::protobuf::io::CodedInputStream input(
+        reinterpret_cast<const std::uint8_t*>(record.data()),  // NOLINT(*-reinterpret-cast)
+        static_cast<int>(std::min<std::size_t>(record.size(), std::numeric_limits<int>::max())));
+    std::uint64_t length = 0;
+    if (input.ReadVarint64(&length)) {
+      const auto start = static_cast<std::size_t>(input.CurrentPosition());
+      if (length <= record.size() - start) {
+        return record.substr(start, static_cast<std::size_t>(length));
+      }
+    }
+  }
+  return absl::DataLossError(absl::StrFormat(
+      "Cannot read corrupt record #%d from indexed proto file '%s' @ %s.", index, filename_, SrcLoc(src_loc_)));
+}
+
+absl::Status IndexedProtoFile::Read(std::size_t index, ::google::protobuf::Message& result) const {
+  const absl::StatusOr<std::string_view> record = ReadRaw(index);
+  if (!record.ok()) {
+    return record.status();
+  }
+  if (record->size() > static_cast<std::size_t>(std::numeric_limits<int>::max())
+      || !result.ParseFromArray(record->data(), static_cast<int>(record->size()))) {
+    return absl::AbortedError(absl::StrFormat(
+        "Cannot parse record #%d from indexed proto file '%s' @ %s.", index, filename_, SrcLoc(src_loc_)));
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace mbo::proto
@@ -0,0 +1,162 @@
+// SPDX-FileCopyrightText: Copyright (c) The helly25/mbo authors (helly25.com)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MBO_PROTO_INDEXED_FILE_H_
+#define MBO_PROTO_INDEXED_FILE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <source_location>
+#include <string_view>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "google/protobuf/io/zero_copy_stream_impl.h"
+#include "google/protobuf/message.h"
+#include "mbo/proto/file.h"
+#include "mbo/proto/mapped_file.h"
+
+// Functionality for proto record files with random access by ordinal:
+// - class  IndexedProtoFileWriter
+// - class  IndexedProtoFile
+//
+// The file format consists of:
+// - The data section: All records as length-delimited messages (varint size followed by the
+//   message). So the data section alone is a file that `ReadDelimitedProtoFile` can read.
+// - The index: One fixed64 (little endian) file offset per record.
+// - The footer: The fixed64 offset of the index, the fixed64 number of records and an 8 byte magic.
+
+namespace mbo::proto {
+
+// Writes an indexed proto record file.
+//
+// Example:
+//
+// ```c++
+// absl::StatusOr<IndexedProtoFileWriter> writer = IndexedProtoFileWriter::Open(filename);
+// if (!writer.ok()) {
+//   return writer.status();
+// }
+// for (const MyProto& record : records) {
+//   if (absl::Status status = writer->Write(record); !status.ok()) {
+//     return status;
+//   }
+// }
+// return writer->Close();
+// ```
+class IndexedProtoFileWriter final {
+ public:
+  // Creates (or truncates) `filename` for writing.
+  static absl::StatusOr<IndexedProtoFileWriter> Open(
+      const std::filesystem::path& filename,
+      const std::source_location& src_loc = std::source_location::current());
+
+  IndexedProtoFileWriter() = delete;
+
+  IndexedProtoFileWriter(const IndexedProtoFileWriter&) = delete;
+  IndexedProtoFileWriter& operator=(const IndexedProtoFileWriter&) = delete;
+  IndexedProtoFileWriter(IndexedProtoFileWriter&&) noexcept;
+  IndexedProtoFileWriter& operator=(IndexedProtoFileWriter&&) = delete;
+
+  // Closes the file if it was not closed explicitly. Errors will only be logged.
+  ~IndexedProtoFileWriter();
+
+  // Appends `message` as the next record.
+  absl::Status Write(const ::google::protobuf::Message& message);
+
+  // Writes the index and the footer and closes the file. Without this the file is not readable as
+  // an indexed file (but the data section is still a readable delimited file).
+  absl::Status Close();
+
+ private:
+  IndexedProtoFileWriter(std::filesystem::path filename, const std::source_location& src_loc, int fd);
+
+  std::filesystem::path filename_;
+  std::source_location src_loc_;
+  std::unique_ptr<::google::protobuf::io::FileOutputStream> output_;
+  std::vector<std::uint64_t> offsets_;
+};
+
+// Read-only random access to an indexed proto record file through a memory mapping.
+//
+// Opening the file only validates the footer. Each `Read`/`Get` parses only the requested record,
+// so the cost does not depend on the number or size of the other records.
+//
+// Example:
+//
+// ```c++
+// absl::StatusOr<IndexedProtoFile> file = IndexedProtoFile::Open(filename);
+// if (!file.ok()) {
+//   return file.status();
+// }
+// absl::StatusOr<MyProto> last = file->Get<MyProto>(file->size() - 1);
+// ```
+class IndexedProtoFile final {
+ public:
+  static absl::StatusOr<IndexedProtoFile> Open(
+      const std::filesystem::path& filename,
+      const std::source_location& src_loc = std::source_location::current());
+
+  IndexedProtoFile() = delete;
+
+  IndexedProtoFile(const IndexedProtoFile&) = delete;
+  IndexedProtoFile& operator=(const IndexedProtoFile&) = delete;
+  IndexedProtoFile(IndexedProtoFile&&) noexcept = default;
+  IndexedProtoFile& operator=(IndexedProtoFile&&) = delete;
+
+  ~IndexedProtoFile() = default;
+
+  // The number of records.
+  std::size_t size() const { return size_; }  // NOLINT(readability-identifier-naming)
+
+  bool empty() const { return size_ == 0; }  // NOLINT(readability-identifier-naming)
+
+  // Returns the serialized record at `index`.
+  absl::StatusOr<std::string_view> ReadRaw(std::size_t index) const;
+
+  // Parses the record at `index` into `result`.
+  absl::Status Read(std::size_t index, ::google::protobuf::Message& result) const;
+
+  // Returns the record at `index` parsed as a `ProtoType`.
+  template<IsProtoType ProtoType>
+  absl::StatusOr<ProtoType> Get(std::size_t index) const {
+    ProtoType result;
+    if (absl::Status status = Read(index, result); !status.ok()) {
+      return status;
+    }
+    return result;
+  }
+
+ private:
+  IndexedProtoFile(
+      std::filesystem::path filename,
+      const std::source_location& src_loc,
+      proto_internal::MappedFile mapped,
+      std::size_t index_offset,
+      std::size_t size);
+
+  std::filesystem::path filename_;
+  std::source_location src_loc_;
+  proto_internal::MappedFile mapped_;
+  std::size_t index_offset_;
+  std::size_t size_;
+};
+
+}  // namespace mbo::proto
+
+#endif  // MBO_PROTO_INDEXED_FILE_H_
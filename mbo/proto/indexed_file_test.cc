@@ -0,0 +1,183 @@
+// SPDX-FileCopyrightText: Copyright (c) The helly25/mbo authors (helly25.com)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mbo/proto/indexed_file.h"
+
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <ios>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "mbo/proto/delimited_file.h"
+#include "mbo/proto/matchers.h"
+#include "mbo/proto/status_matchers.h"
+#include "mbo/proto/tests/simple_message.pb.h"
+
+namespace mbo::proto {
+namespace {
+// NOLINTBEGIN(*-magic-numbers)
+
+using ::mbo::proto::EqualsProto;
+using ::mbo::proto::tests::SimpleMessage;
+using ::testing::ElementsAre;
+using ::testing::Gt;
+using ::testing::HasSubstr;
+using ::testing::SizeIs;
+
+struct IndexedFileTest : ::testing::Test {
+  static std::vector<SimpleMessage> MakeRecords(int count) {
+    std::vector<SimpleMessage> records;
+    for (int i = 0; i < count; ++i) {
+      SimpleMessage& record = records.emplace_back();
+      record.set_one(i);
+      for (int j = 0; j < i % 3; ++j) {
+        record.add_two(j);
+      }
+    }
+    return records;
+  }
+
+  static void WriteRecords(const std::filesystem::path& filename, const std::vector<SimpleMessage>& records) {
+    absl::StatusOr<IndexedProtoFileWriter> writer = IndexedProtoFileWriter::Open(filename);
+    ASSERT_THAT(writer, IsOk());
+    for (const SimpleMessage& record : records) {
+      ASSERT_THAT(writer->Write(record), IsOk());
+    }
+    ASSERT_THAT(writer->Close(), IsOk());
+  }
+
+  static std::string ReadContent(const std::filesystem::path& filename) {
+    std::ifstream input(filename, std::ios::binary);
+    return {std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>()};
+  }
+
+  static void WriteContent(const std::filesystem::path& filename, std::string_view content) {
+    std::ofstream output(filename, std::ios::binary | std::ios::trunc);
+    output << content;
+  }
+};
+
+TEST_F(IndexedFileTest, WriteAndRead) {
+  const std::vector<SimpleMessage> records = MakeRecords(10);
+  WriteRecords("test.indexed.pb", records);
+  const absl::StatusOr<IndexedProtoFile> file = IndexedProtoFile::Open("test.indexed.pb");
+  ASSERT_THAT(file, IsOk());
+  ASSERT_THAT(file->size(), records.size());
+  EXPECT_FALSE(file->empty());
+  // Random access in any order.
+  for (std::size_t i = records.size(); i > 0; --i) {
+    EXPECT_THAT(file->Get<SimpleMessage>(i - 1), IsOkAndHolds(EqualsProto(records[i - 1])));
+  }
+  SimpleMessage record;
+  ASSERT_THAT(file->Read(4, record), IsOk());
+  EXPECT_THAT(record, EqualsProto(records[4]));
+  EXPECT_THAT(file->ReadRaw(4), IsOkAndHolds(records[4].SerializeAsString()));
+}
+
+TEST_F(IndexedFileTest, Empty) {
+  WriteRecords("empty.indexed.pb", {});
+  const absl::StatusOr<IndexedProtoFile> file = IndexedProtoFile::Open("empty.indexed.pb");
+  ASSERT_THAT(file, IsOk());
+  EXPECT_THAT(file->size(), 0);
+  EXPECT_TRUE(file->empty());
+  EXPECT_THAT(file->Get<SimpleMessage>(0), StatusIs(absl::StatusCode::kOutOfRange, HasSubstr("record #0 of 0")));
+}
+
+TEST_F(IndexedFileTest, DataSectionIsDelimited) {
+  const std::vector<SimpleMessage> records = MakeRecords(3);
+  WriteRecords("test.indexed.pb", records);
+  const std::string content = ReadContent("test.indexed.pb");
+  // Dropping the index and footer (3 offsets plus 24 bytes) leaves a delimited file.
+  WriteContent("test.delimited.pb", std::string_view(content).substr(0, content.size() - 3 * 8 - 24));
+  std::vector<int> ones;
+  ReadDelimitedProtoFile<SimpleMessage> reader("test.delimited.pb");
+  for (const SimpleMessage& record : reader) {
+    ones.push_back(record.one());
+  }
+  EXPECT_THAT(reader.status(), IsOk());
+  EXPECT_THAT(ones, ElementsAre(0, 1, 2));
+}
+
+TEST_F(IndexedFileTest, WriterErrors) {
+  absl::StatusOr<IndexedProtoFileWriter> writer = IndexedProtoFileWriter::Open("test.indexed.pb");
+  ASSERT_THAT(writer, IsOk());
+  ASSERT_THAT(writer->Close(), IsOk());
+  EXPECT_THAT(
+      writer->Write(SimpleMessage()), StatusIs(absl::StatusCode::kFailedPrecondition, HasSubstr("closed file")));
+  EXPECT_THAT(writer->Close(), StatusIs(absl::StatusCode::kFailedPrecondition, HasSubstr("closed file")));
+  EXPECT_THAT(
+      IndexedProtoFileWriter::Open("does/not/exist.pb"),
+      StatusIs(absl::StatusCode::kAborted, HasSubstr("Cannot open 'does/not/exist.pb' for writing")));
+}
+
+TEST_F(IndexedFileTest, ReaderErrors) {
+  EXPECT_THAT(
+      IndexedProtoFile::Open("DoesNotExist.pb"),
+      StatusIs(absl::StatusCode::kNotFound, HasSubstr("Cannot open 'DoesNotExist.pb'")));
+  WriteContent("short.pb", "MBOPBIDX");
+  EXPECT_THAT(
+      IndexedProtoFile::Open("short.pb"), StatusIs(absl::StatusCode::kDataLoss, HasSubstr("Cannot find index")));
+
+  const std::vector<SimpleMessage> records = MakeRecords(3);
+  WriteRecords("test.indexed.pb", records);
+  const std::string content = ReadContent("test.indexed.pb");
+  ASSERT_THAT(content, SizeIs(Gt(24)));
+  {
+    std::string broken = content;
+    broken.back() = 'x';
+    WriteContent("broken.pb", broken);
+    EXPECT_THAT(
+        IndexedProtoFile::Open("broken.pb"), StatusIs(absl::StatusCode::kDataLoss, HasSubstr("Cannot find index")));
+  }
+  {
+    std::string broken = content;
+    broken[broken.size() - 16] = 42;  // Wrong record count.
+    WriteContent("broken.pb", broken);
+    EXPECT_THAT(
+        IndexedProtoFile::Open("broken.pb"),
+        StatusIs(absl::StatusCode::kDataLoss, HasSubstr("Cannot read corrupt index")));
+  }
+  {
+    std::string broken = content;
+    broken[broken.size() - 24 - 8] = 120;  // Last record offset points into the index.
+    WriteContent("broken.pb", broken);
+    const absl::StatusOr<IndexedProtoFile> file = IndexedProtoFile::Open("broken.pb");
+    ASSERT_THAT(file, IsOk());
+    EXPECT_THAT(file->Get<SimpleMessage>(1), IsOkAndHolds(EqualsProto(records[1])));
+    EXPECT_THAT(
+        file->Get<SimpleMessage>(2),
+        StatusIs(absl::StatusCode::kDataLoss, HasSubstr("Cannot read corrupt record #2")));
+  }
+  {
+    std::string broken = content;
+    broken[0] = 2;  // The first record claims 2 bytes: the field tag and a truncated varint.
+    broken[2] = static_cast<char>(0x80);
+    WriteContent("broken.pb", broken);
+    const absl::StatusOr<IndexedProtoFile> file = IndexedProtoFile::Open("broken.pb");
+    ASSERT_THAT(file, IsOk());
+    EXPECT_THAT(
+        file->Get<SimpleMessage>(0), StatusIs(absl::StatusCode::kAborted, HasSubstr("Cannot parse record #0")));
+  }
+}
+
+// NOLINTEND(*-magic-numbers)
+}  // namespace
+}  // namespace mbo::proto
@@ -0,0 +1,50 @@
+// SPDX-FileCopyrightText: Copyright (c) The helly25/mbo authors (helly25.com)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mbo/proto/mapped_file.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <cstddef>
+#include <optional>
+
+namespace mbo::proto::proto_internal {
+
+std::optional<MappedFile> MappedFile::Map(int fd, Access access) {
+  struct stat info{};
+  if (::fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size < 0) {
+    return std::nullopt;
+  }
+  const auto size = static_cast<std::size_t>(info.st_size);
+  if (size == 0) {
+    return MappedFile(nullptr, 0);  // Mapping zero bytes is an error, but the file is still valid.
+  }
+  void* const addr = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (addr == MAP_FAILED) {  // NOLINT(*-cstyle-cast,*-int-to-ptr)
+    return std::nullopt;
+  }
+  // The hint is advisory and errors are ignored.
+  ::madvise(addr, size, access == Access::kSequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+  return MappedFile(addr, size);
+}
+
+MappedFile::~MappedFile() {
+  if (addr_ != nullptr) {
+    ::munmap(addr_, size_);
+  }
+}
+
+}  // namespace mbo::proto::proto_internal
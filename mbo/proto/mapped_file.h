@@ -0,0 +1,62 @@
+// SPDX-FileCopyrightText: Copyright (c) The helly25/mbo authors (helly25.com)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MBO_PROTO_MAPPED_FILE_H_
+#define MBO_PROTO_MAPPED_FILE_H_
+
+// IWYU pragma: private
+
+#include <cstddef>
+#include <optional>
+#include <string_view>
+#include <utility>
+
+namespace mbo::proto::proto_internal {
+
+// Read-only memory mapping of a complete regular file.
+class MappedFile final {
+ public:
+  // How the mapping will be accessed. This is only an advisory hint to the kernel.
+  enum class Access {
+    kSequential,
+    kRandom,
+  };
+
+  // Maps the file opened as `fd`. Returns std::nullopt if the file is not a regular file or if it
+  // cannot be mapped for any other reason. The descriptor may be closed once this returns.
+  static std::optional<MappedFile> Map(int fd, Access access = Access::kSequential);
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  MappedFile(MappedFile&& other) noexcept
+      : addr_(std::exchange(other.addr_, nullptr)), size_(std::exchange(other.size_, 0)) {}
+
+  MappedFile& operator=(MappedFile&&) = delete;
+
+  ~MappedFile();
+
+  std::string_view data() const { return {static_cast<const char*>(addr_), size_}; }
+
+ private:
+  MappedFile(void* addr, std::size_t size) : addr_(addr), size_(size) {}
+
+  void* addr_;
+  std::size_t size_;
+};
+
+}  // namespace mbo::proto::proto_internal
+
+#endif  // MBO_PROTO_MAPPED_FILE_H_
@@ -15,25 +15,41 @@
 
 #include "mbo/proto/matchers.h"
 
+#include <algorithm>
+#include <array>
+#include <cmath>
 #include <cstddef>
+#include <cstdint>
+#include <limits>
 #include <memory>
+#include <numeric>
+#include <queue>
 #include <sstream>
 #include <string>
 #include <string_view>
+#include <utility>
 #include <vector>
 
+#include "absl/container/flat_hash_set.h"
+#include "absl/hash/hash.h"
 #include "absl/log/absl_check.h"
 #include "absl/log/absl_log.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/strip.h"
 #include "absl/strings/substitute.h"
+#include "absl/synchronization/mutex.h"
 #include "google/protobuf/descriptor.h"
+#include "google/protobuf/io/coded_stream.h"
 #include "google/protobuf/io/tokenizer.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
 #include "google/protobuf/message.h"
+#include "google/protobuf/reflection.h"
+#include "google/protobuf/repeated_field.h"
 // #include "google/protobuf/stubs/common.h"  // Via tokenizer.h
 #include "google/protobuf/text_format.h"
 #include "google/protobuf/util/field_comparator.h"
 #include "gtest/gtest.h"
+#include "mbo/proto/float_compare.h"
 #include "re2/re2.h"
 
 namespace mbo::proto::internal {
@@ -78,6 +94,20 @@ bool ParsePartialFromAscii(const std::string& pb_ascii, ::google::protobuf::Mess
   return parser.ParseFromString(std::string(pb_ascii), proto);
 }
 
+const ExpectedProtoCache::Entry& ExpectedProtoCache::Get(const ::google::protobuf::Message& arg) const {
+  const absl::MutexLock lock(&mutex_);
+  std::unique_ptr<const Entry>& entry = entries_[arg.GetDescriptor()];
+  if (entry == nullptr) {
+    auto parsed = std::make_unique<Entry>();
+    std::unique_ptr<::google::protobuf::Message> proto(arg.New());
+    if (ParsePartialFromAscii(text_, proto.get(), &parsed->error_text)) {
+      parsed->proto = std::move(proto);
+    }
+    entry = std::move(parsed);
+  }
+  return *entry;
+}
+
 // Returns true iff `lhs` and `rhs` can be compared (i.e. have the same descriptor).
 bool ProtoComparable(const ::google::protobuf::Message& lhs, const ::google::protobuf::Message& rhs) {
   return lhs.GetDescriptor() == rhs.GetDescriptor();
@@ -118,24 +148,10 @@ std::vector<const ::google::protobuf::FieldDescriptor*> GetFieldDescriptors(
   return ignore_descriptors;
 }
 
-// Sets the ignored fields corresponding to ignore_fields in differencer. Dies
-// if any is invalid.
-void SetIgnoredFieldsOrDie(
-    const ::google::protobuf::Descriptor& root_descriptor,
-    const std::vector<std::string>& ignore_fields,
-    ::google::protobuf::util::MessageDifferencer* differencer) {
-  if (!ignore_fields.empty()) {
-    const std::vector<const ::google::protobuf::FieldDescriptor*> ignore_descriptors =
-        GetFieldDescriptors(&root_descriptor, ignore_fields);
-    for (const auto& ignore_descriptor : ignore_descriptors) {
-      differencer->IgnoreField(ignore_descriptor);
-    }
-  }
-}
-
 // A criterion that ignores a field path.
 class IgnoreFieldPathCriteria : public ::google::protobuf::util::MessageDifferencer::IgnoreCriteria {
  public:
+  // The `field_path` is referenced, not copied, and must outlive the criterion.
   explicit IgnoreFieldPathCriteria(
       const std::vector<::google::protobuf::util::MessageDifferencer::SpecificField>& field_path)
       : ignored_field_path_(field_path) {}
@@ -152,9 +168,8 @@ class IgnoreFieldPathCriteria : public ::google::protobuf::util::MessageDifferen
     for (std::size_t i = 0; i < parent_fields.size(); ++i) {
       const auto& cur_field = parent_fields[i];
       const auto& ignored_field = ignored_field_path_[i];
-      // We could compare pointers but it's not guaranteed that descriptors come
-      // from the same pool.
-      if (cur_field.field->full_name() != ignored_field.field->full_name()) {
+      // Descriptors may come from different pools, so fall back to comparing names.
+      if (!SameField(cur_field.field, ignored_field.field)) {
         return false;
       }
 
@@ -165,11 +180,17 @@ class IgnoreFieldPathCriteria : public ::google::protobuf::util::MessageDifferen
         return false;
       }
     }
-    return field->full_name() == ignored_field_path_.back().field->full_name();
+    return SameField(field, ignored_field_path_.back().field);
   }
 
  private:
-  const std::vector<::google::protobuf::util::MessageDifferencer::SpecificField> ignored_field_path_;
+  static bool SameField(
+      const ::google::protobuf::FieldDescriptor* lhs,
+      const ::google::protobuf::FieldDescriptor* rhs) {
+    return lhs == rhs || lhs->full_name() == rhs->full_name();
+  }
+
+  const std::vector<::google::protobuf::util::MessageDifferencer::SpecificField>& ignored_field_path_;
 };
 
 // Parses a field path and returns individual components.
@@ -187,9 +208,9 @@ std::vector<::google::protobuf::util::MessageDifferencer::SpecificField> ParseFi
 
   // Regular parsers. Consume() does not handle optional captures so we split it
   // in two regexps.
-  const RE2 field_regex(R"(([^.()[\]]+))");
-  const RE2 field_subscript_regex(R"(([^.()[\]]+)\[(\d+)\])");
-  const RE2 extension_regex(R"(\(([^)]+)\))");
+  static LazyRE2 field_regex = {R"(([^.()[\]]+))"};
+  static LazyRE2 field_subscript_regex = {R"(([^.()[\]]+)\[(\d+)\])"};
+  static LazyRE2 extension_regex = {R"(\(([^)]+)\))"};
 
   std::string_view input(relative_field_path);
   while (!input.empty()) {
@@ -201,7 +222,8 @@ std::vector<::google::protobuf::util::MessageDifferencer::SpecificField> ParseFi
     // Try to consume a field name. If that fails, consume an extension name.
     ::google::protobuf::util::MessageDifferencer::SpecificField field;
     std::string name;
-    if (RE2::Consume(&input, field_subscript_regex, &name, &field.index) || RE2::Consume(&input, field_regex, &name)) {
+    if (RE2::Consume(&input, *field_subscript_regex, &name, &field.index)
+        || RE2::Consume(&input, *field_regex, &name)) {
       if (field_path.empty()) {
         field.field = root_descriptor.FindFieldByName(std::string(name));
         ABSL_CHECK(field.field) << "No such field '" << name << "' in message '" << root_descriptor.full_name() << "'";
@@ -210,7 +232,7 @@ std::vector<::google::protobuf::util::MessageDifferencer::SpecificField> ParseFi
         field.field = parent.field->message_type()->FindFieldByName(std::string(name));
         ABSL_CHECK(field.field) << "No such field '" << name << "' in '" << parent.field->full_name() << "'";
       }
-    } else if (RE2::Consume(&input, extension_regex, &name)) {
+    } else if (RE2::Consume(&input, *extension_regex, &name)) {
       field.field = ::google::protobuf::DescriptorPool::generated_pool()->FindExtensionByName(name);
       ABSL_CHECK(field.field) << "No such extension '" << name << "'";
       if (field_path.empty()) {
@@ -234,33 +256,26 @@ std::vector<::google::protobuf::util::MessageDifferencer::SpecificField> ParseFi
   return field_path;
 }
 
-// Sets the ignored field paths corresponding to field_paths in differencer.
-// Dies if any path is invalid.
-void SetIgnoredFieldPathsOrDie(
-    const ::google::protobuf::Descriptor& root_descriptor,
-    const std::vector<std::string>& field_paths,
-    ::google::protobuf::util::MessageDifferencer* differencer) {
-  for (const std::string& field_path : field_paths) {
-    differencer->AddIgnoreCriteria(
-        std::make_unique<IgnoreFieldPathCriteria>(ParseFieldPathOrDie(field_path, root_descriptor)));
-  }
-}
-
 // Configures a MessageDifferencer and DefaultFieldComparator to use the logic
-// described in comp. The configured differencer is the output of this function,
-// but a FieldComparator must be provided to keep ownership clear.
+// described in comp and its resolved plan. The configured differencer is the
+// output of this function, but a FieldComparator must be provided to keep
+// ownership clear. The plan must outlive the differencer.
 void ConfigureDifferencer(
     const internal::ProtoComparison& comp,
+    const internal::ProtoComparisonPlan& plan,
     ::google::protobuf::util::DefaultFieldComparator* comparator,
-    ::google::protobuf::util::MessageDifferencer* differencer,
-    const ::google::protobuf::Descriptor* descriptor) {
+    ::google::protobuf::util::MessageDifferencer* differencer) {
   differencer->set_message_field_comparison(comp.field_comp);
   differencer->set_scope(comp.scope);
   comparator->set_float_comparison(comp.float_comp);
   comparator->set_treat_nan_as_equal(comp.treating_nan_as_equal);
   differencer->set_repeated_field_comparison(comp.repeated_field_comp);
-  SetIgnoredFieldsOrDie(*descriptor, comp.ignore_fields, differencer);
-  SetIgnoredFieldPathsOrDie(*descriptor, comp.ignore_field_paths, differencer);
+  for (const ::google::protobuf::FieldDescriptor* field : plan.ignore_fields) {
+    differencer->IgnoreField(field);
+  }
+  for (const auto& field_path : plan.ignore_field_paths) {
+    differencer->AddIgnoreCriteria(std::make_unique<IgnoreFieldPathCriteria>(field_path));
+  }
   if (comp.float_comp == internal::kProtoApproximate && (comp.has_custom_margin || comp.has_custom_fraction)) {
     // Two fields will be considered equal if they're within the fraction _or_
     // within the margin. So setting the fraction to 0.0 makes this effectively
@@ -271,29 +286,557 @@ void ConfigureDifferencer(
   differencer->set_field_comparator(comparator);
 }
 
-}  // namespace
+// Returns whether messages of type `descriptor` may hold float or double
+// values, directly or in sub messages, extensions or `Any` fields.
+bool MayHoldFloatingPoint(const ::google::protobuf::Descriptor& descriptor) {
+  absl::flat_hash_set<const ::google::protobuf::Descriptor*> seen{&descriptor};
+  std::queue<const ::google::protobuf::Descriptor*> pending({&descriptor});
+  while (!pending.empty()) {
+    const ::google::protobuf::Descriptor* const message = pending.front();
+    pending.pop();
+    if (message->extension_range_count() > 0 || message->full_name() == "google.protobuf.Any") {
+      return true;
+    }
+    for (int i = 0; i < message->field_count(); ++i) {
+      const ::google::protobuf::FieldDescriptor* const field = message->field(i);
+      switch (field->cpp_type()) {
+        case ::google::protobuf::FieldDescriptor::CPPTYPE_FLOAT:
+        case ::google::protobuf::FieldDescriptor::CPPTYPE_DOUBLE: return true;
+        case ::google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE:
+          if (seen.insert(field->message_type()).second) {
+            pending.push(field->message_type());
+          }
+          break;
+        default: break;
+      }
+    }
+  }
+  return false;
+}
 
-// Returns true iff actual and expected are comparable and match.  The
-// comp argument specifies how two are compared.
-bool ProtoCompare(
+// Serializes `message` deterministically using its cached sizes.
+std::string SerializeWithCachedSizesDeterministic(const ::google::protobuf::Message& message) {
+  std::string data;
+  {
+    ::google::protobuf::io::StringOutputStream stream(&data);
+    ::google::protobuf::io::CodedOutputStream output(&stream);
+    output.SetSerializationDeterministic(true);
+    message.SerializeWithCachedSizes(&output);
+  }
+  return data;
+}
+
+// Returns whether `lhs` and `rhs` have identical deterministic serializations.
+// The sizes are compared first, so that most differences are found without
+// serializing.
+bool SerializedEqual(const ::google::protobuf::Message& lhs, const ::google::protobuf::Message& rhs) {
+  if (lhs.ByteSizeLong() != rhs.ByteSizeLong()) {
+    return false;
+  }
+  return SerializeWithCachedSizesDeterministic(lhs) == SerializeWithCachedSizesDeterministic(rhs);
+}
+
+// Returns whether messages of type `descriptor` have repeated fields other
+// than maps, directly or in sub messages.
+bool HasRepeatedFields(const ::google::protobuf::Descriptor& descriptor) {
+  absl::flat_hash_set<const ::google::protobuf::Descriptor*> seen{&descriptor};
+  std::queue<const ::google::protobuf::Descriptor*> pending({&descriptor});
+  while (!pending.empty()) {
+    const ::google::protobuf::Descriptor* const message = pending.front();
+    pending.pop();
+    for (int i = 0; i < message->field_count(); ++i) {
+      const ::google::protobuf::FieldDescriptor* const field = message->field(i);
+      if (field->is_repeated() && !field->is_map()) {
+        return true;
+      }
+      if (field->cpp_type() == ::google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE
+          && seen.insert(field->message_type()).second) {
+        pending.push(field->message_type());
+      }
+    }
+  }
+  return false;
+}
+
+// Returns whether messages of type `descriptor` have repeated float or double
+// fields, directly or in sub messages.
+bool HasRepeatedFloatingPoint(const ::google::protobuf::Descriptor& descriptor) {
+  absl::flat_hash_set<const ::google::protobuf::Descriptor*> seen{&descriptor};
+  std::queue<const ::google::protobuf::Descriptor*> pending({&descriptor});
+  while (!pending.empty()) {
+    const ::google::protobuf::Descriptor* const message = pending.front();
+    pending.pop();
+    for (int i = 0; i < message->field_count(); ++i) {
+      const ::google::protobuf::FieldDescriptor* const field = message->field(i);
+      switch (field->cpp_type()) {
+        case ::google::protobuf::FieldDescriptor::CPPTYPE_FLOAT:
+        case ::google::protobuf::FieldDescriptor::CPPTYPE_DOUBLE:
+          if (field->is_repeated()) {
+            return true;
+          }
+          break;
+        case ::google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE:
+          if (seen.insert(field->message_type()).second) {
+            pending.push(field->message_type());
+          }
+          break;
+        default: break;
+      }
+    }
+  }
+  return false;
+}
+
+// A criterion that compares repeated float and double fields in bulk and
+// ignores them if all their values are equal. Otherwise the differencer
+// compares them value by value as usual.
+class FloatArrayCriteria : public ::google::protobuf::util::MessageDifferencer::IgnoreCriteria {
+ public:
+  explicit FloatArrayCriteria(const ProtoComparison& comp)
+      : comparison_{
+            .approximate = comp.float_comp == kProtoApproximate,
+            .treat_nan_as_equal = comp.treating_nan_as_equal,
+            .has_tolerance = comp.has_custom_margin || comp.has_custom_fraction,
+            .fraction = comp.float_fraction,
+            .margin = comp.float_margin,
+        } {}
+
+  bool IsIgnored(
+      const ::google::protobuf::Message& message1,
+      const ::google::protobuf::Message& message2,
+      const ::google::protobuf::FieldDescriptor* field,
+      const std::vector<::google::protobuf::util::MessageDifferencer::SpecificField>& /*parent_fields*/) override {
+    if (!field->is_repeated()) {
+      return false;
+    }
+    switch (field->cpp_type()) {
+      case ::google::protobuf::FieldDescriptor::CPPTYPE_FLOAT: return ValuesEqual<float>(message1, message2, *field);
+      case ::google::protobuf::FieldDescriptor::CPPTYPE_DOUBLE: return ValuesEqual<double>(message1, message2, *field);
+      default: return false;
+    }
+  }
+
+ private:
+  // Values of messages that are not generated are read into blocks through
+  // reflection, and each block gets compared as a whole.
+  static constexpr int kBlockSize = 256;
+
+  // Returns the storage of a repeated field of a generated message.
+  template<typename T>
+  static const ::google::protobuf::RepeatedField<T>& RepeatedField(
+      const ::google::protobuf::Message& message,
+      const ::google::protobuf::FieldDescriptor& field) {
+#if defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wdeprecated-declarations"
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+#endif  // defined(__clang__)
+    // `GetRepeatedFieldRef` would be the replacement, but it only provides
+    // access to single values, which costs a virtual call per value.
+    // NOLINTNEXTLINE(clang-diagnostic-deprecated-declarations)
+    return message.GetReflection()->GetRepeatedField<T>(message, &field);
+#if defined(__clang__)
+#pragma clang diagnostic pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif  // defined(__clang__)
+  }
+
+  template<typename T>
+  bool ValuesEqual(
+      const ::google::protobuf::Message& message1,
+      const ::google::protobuf::Message& message2,
+      const ::google::protobuf::FieldDescriptor& field) const {
+    if (field.file()->pool() == ::google::protobuf::DescriptorPool::generated_pool()) {
+      const ::google::protobuf::RepeatedField<T>& values1 = RepeatedField<T>(message1, field);
+      const ::google::protobuf::RepeatedField<T>& values2 = RepeatedField<T>(message2, field);
+      return values1.size() == values2.size()
+             && proto_internal::FloatsEqual(
+                 values1.data(), values2.data(), static_cast<std::size_t>(values1.size()), comparison_);
+    }
+    const auto values1 = message1.GetReflection()->GetRepeatedFieldRef<T>(message1, &field);
+    const auto values2 = message2.GetReflection()->GetRepeatedFieldRef<T>(message2, &field);
+    const int size = values1.size();
+    if (size != values2.size()) {
+      return false;
+    }
+    std::array<T, kBlockSize> block1;
+    std::array<T, kBlockSize> block2;
+    for (int begin = 0; begin < size; begin += kBlockSize) {
+      const int count = std::min(kBlockSize, size - begin);
+      for (int index = 0; index < count; ++index) {
+        block1[index] = values1.Get(begin + index);
+        block2[index] = values2.Get(begin + index);
+      }
+      if (!proto_internal::FloatsEqual(block1.data(), block2.data(), count, comparison_)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  const proto_internal::FloatComparison comparison_;
+};
+
+// Repeated fields with fewer elements are compared without sorting them first.
+constexpr int kMinSortedRepeatedFieldSize = 16;
+
+// Computes hashes of messages that are equal for any two messages which match
+// under the exact comparison settings (in full scope). Ignored fields do not
+// contribute. Singular
+// fields with default values do not contribute, so unset and default fields
+// hash the same as needed for equivalence. Repeated fields are hashed as
+// multisets. The hashes only need to be good, not exact: They decide the order
+// of elements, while the differencer still decides the match.
+class RepeatedFieldSorter {
+ public:
+  explicit RepeatedFieldSorter(const ProtoComparisonPlan& plan) {
+    skipped_fields_.insert(plan.ignore_fields.begin(), plan.ignore_fields.end());
+    for (const auto& field_path : plan.ignore_field_paths) {
+      skipped_fields_.insert(field_path.back().field);
+    }
+  }
+
+  // Returns whether `message` has a repeated field worth sorting.
+  bool HasLargeRepeatedField(const ::google::protobuf::Message& message) const {
+    const ::google::protobuf::Reflection& reflection = *message.GetReflection();
+    const ::google::protobuf::Descriptor& descriptor = *message.GetDescriptor();
+    for (int i = 0; i < descriptor.field_count(); ++i) {
+      const ::google::protobuf::FieldDescriptor* const field = descriptor.field(i);
+      if (skipped_fields_.contains(field) || field->is_map()) {
+        continue;
+      }
+      if (field->is_repeated() && !IsFloatingPoint(*field)) {
+        const int size = reflection.FieldSize(message, field);
+        if (size >= kMinSortedRepeatedFieldSize) {
+          return true;
+        }
+        if (field->cpp_type() == ::google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE) {
+          for (int index = 0; index < size; ++index) {
+            if (HasLargeRepeatedField(reflection.GetRepeatedMessage(message, field, index))) {
+              return true;
+            }
+          }
+        }
+      } else if (
+          field->cpp_type() == ::google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE
+          && reflection.HasField(message, field) && HasLargeRepeatedField(reflection.GetMessage(message, field))) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Sorts all repeated fields (except maps and floating point scalars) of
+  // `message` by element hash.
+  void Sort(::google::protobuf::Message& message) const {
+    const ::google::protobuf::Reflection& reflection = *message.GetReflection();
+    const ::google::protobuf::Descriptor& descriptor = *message.GetDescriptor();
+    for (int i = 0; i < descriptor.field_count(); ++i) {
+      const ::google::protobuf::FieldDescriptor* const field = descriptor.field(i);
+      if (skipped_fields_.contains(field) || field->is_map()) {
+        continue;
+      }
+      const bool is_message = field->cpp_type() == ::google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE;
+      if (!field->is_repeated()) {
+        if (is_message && reflection.HasField(message, field)) {
+          Sort(*reflection.MutableMessage(&message, field));
+        }
+        continue;
+      }
+      if (IsFloatingPoint(*field)) {
+        continue;  // Keeps the order the differencer would see unsorted.
+      }
+      const int size = reflection.FieldSize(message, field);
+      std::vector<std::size_t> hashes(size);
+      for (int index = 0; index < size; ++index) {
+        if (is_message) {
+          Sort(*reflection.MutableRepeatedMessage(&message, field, index));
+        }
+        hashes[index] = ElementHash(message, *field, index);
+      }
+      std::vector<int> order(size);
+      std::iota(order.begin(), order.end(), 0);
+      std::stable_sort(order.begin(), order.end(), [&hashes](int lhs, int rhs) { return hashes[lhs] < hashes[rhs]; });
+      Permute(message, field, order);
+    }
+  }
+
+ private:
+  // Moves the element at `order[i]` to index `i` for all `i`.
+  static void Permute(
+      ::google::protobuf::Message& message,
+      const ::google::protobuf::FieldDescriptor* field,
+      const std::vector<int>& order) {
+    const ::google::protobuf::Reflection& reflection = *message.GetReflection();
+    std::vector<int> position(order.size());  // Current index of each original element.
+    std::vector<int> element(order.size());   // Original element at each current index.
+    std::iota(position.begin(), position.end(), 0);
+    std::iota(element.begin(), element.end(), 0);
+    for (std::size_t index = 0; index < order.size(); ++index) {
+      const int from = position[order[index]];
+      if (from != static_cast<int>(index)) {
+        reflection.SwapElements(&message, field, static_cast<int>(index), from);
+        position[element[index]] = from;
+        element[from] = element[index];
+        position[order[index]] = static_cast<int>(index);
+        element[index] = order[index];
+      }
+    }
+  }
+
+  std::size_t MessageHash(const ::google::protobuf::Message& message) const {
+    const ::google::protobuf::Reflection& reflection = *message.GetReflection();
+    const ::google::protobuf::Descriptor& descriptor = *message.GetDescriptor();
+    std::size_t result = 0;
+    for (int i = 0; i < descriptor.field_count(); ++i) {
+      const ::google::protobuf::FieldDescriptor* const field = descriptor.field(i);
+      if (skipped_fields_.contains(field)) {
+        continue;
+      }
+      std::size_t hash = 0;
+      if (field->is_repeated()) {
+        const int size = reflection.FieldSize(message, field);
+        for (int index = 0; index < size; ++index) {
+          hash += absl::HashOf(ElementHash(message, *field, index));
+        }
+      } else {
+        hash = ElementHash(message, *field, -1);
+      }
+      if (hash != 0) {
+        result = absl::HashOf(result, field->number(), hash);
+      }
+    }
+    return result;
+  }
+
+  // Returns the hash of the element at `index`, or of the singular field if
+  // `index` is -1, in which case default values hash to 0.
+  // NOLINTNEXTLINE(readability-function-cognitive-complexity)
+  std::size_t ElementHash(
+      const ::google::protobuf::Message& message,
+      const ::google::protobuf::FieldDescriptor& field,
+      int index) const {
+    using FieldDescriptor = ::google::protobuf::FieldDescriptor;
+    const ::google::protobuf::Reflection& reflection = *message.GetReflection();
+    const bool singular = index < 0;
+    const auto hash = [singular](const auto& value, const auto& default_value) -> std::size_t {
+      return singular && value == default_value ? 0 : absl::HashOf(value);
+    };
+    switch (field.cpp_type()) {
+      case FieldDescriptor::CPPTYPE_INT32:
+        return hash(
+            singular ? reflection.GetInt32(message, &field) : reflection.GetRepeatedInt32(message, &field, index),
+            field.default_value_int32());
+      case FieldDescriptor::CPPTYPE_INT64:
+        return hash(
+            singular ? reflection.GetInt64(message, &field) : reflection.GetRepeatedInt64(message, &field, index),
+            field.default_value_int64());
+      case FieldDescriptor::CPPTYPE_UINT32:
+        return hash(
+            singular ? reflection.GetUInt32(message, &field) : reflection.GetRepeatedUInt32(message, &field, index),
+            field.default_value_uint32());
+      case FieldDescriptor::CPPTYPE_UINT64:
+        return hash(
+            singular ? reflection.GetUInt64(message, &field) : reflection.GetRepeatedUInt64(message, &field, index),
+            field.default_value_uint64());
+      case FieldDescriptor::CPPTYPE_BOOL:
+        return hash(
+            singular ? reflection.GetBool(message, &field) : reflection.GetRepeatedBool(message, &field, index),
+            field.default_value_bool());
+      case FieldDescriptor::CPPTYPE_ENUM:
+        return hash(
+            singular ? reflection.GetEnumValue(message, &field)
+                     : reflection.GetRepeatedEnumValue(message, &field, index),
+            field.default_value_enum()->number());
+      case FieldDescriptor::CPPTYPE_FLOAT:
+        return hash(
+            Normalize(
+                singular ? reflection.GetFloat(message, &field) : reflection.GetRepeatedFloat(message, &field, index)),
+            Normalize(field.default_value_float()));
+      case FieldDescriptor::CPPTYPE_DOUBLE:
+        return hash(
+            Normalize(
+                singular ? reflection.GetDouble(message, &field)
+                         : reflection.GetRepeatedDouble(message, &field, index)),
+            Normalize(field.default_value_double()));
+      case FieldDescriptor::CPPTYPE_STRING: {
+        std::string scratch;
+        const std::string& value = singular ? reflection.GetStringReference(message, &field, &scratch)
+                                            : reflection.GetRepeatedStringReference(message, &field, index, &scratch);
+        return hash(value, field.default_value_string());
+      }
+      case FieldDescriptor::CPPTYPE_MESSAGE:
+        if (singular) {
+          return reflection.HasField(message, &field) ? MessageHash(reflection.GetMessage(message, &field)) : 0;
+        }
+        return MessageHash(reflection.GetRepeatedMessage(message, &field, index));
+    }
+    return 0;
+  }
+
+  // Maps `-0.0` to `0.0` and all NaNs to one NaN, as they compare (or with
+  // TreatingNaNsAsEqual are considered) equal.
+  template<typename T>
+  static T Normalize(T value) {
+    if (value == 0) {
+      return 0;
+    }
+    return std::isnan(value) ? std::numeric_limits<T>::quiet_NaN() : value;
+  }
+
+  static bool IsFloatingPoint(const ::google::protobuf::FieldDescriptor& field) {
+    return field.cpp_type() == ::google::protobuf::FieldDescriptor::CPPTYPE_FLOAT
+           || field.cpp_type() == ::google::protobuf::FieldDescriptor::CPPTYPE_DOUBLE;
+  }
+
+  absl::flat_hash_set<const ::google::protobuf::FieldDescriptor*> skipped_fields_;
+};
+
+// Compares `actual` against `expected`. If `diff` is not nullptr, then the
+// differences are reported to it as well. Unless a mismatch is found by one of
+// the shortcuts below, that takes a single differencer pass.
+bool CompareAndReportDiff(
     const internal::ProtoComparison& comp,
+    const internal::ProtoComparisonPlan& plan,
     const ::google::protobuf::Message& actual,
-    const ::google::protobuf::Message& expected) {
-  if (!ProtoComparable(actual, expected)) {
-    return false;
+    const ::google::protobuf::Message& expected,
+    std::string* diff) {
+  // Identical messages match under any comparison settings. Otherwise the
+  // differencer decides, e.g. `-0.0` vs `0.0`, default values when comparing
+  // equivalence, or unknown fields in a different order.
+  if (plan.compare_serialized && SerializedEqual(actual, expected)) {
+    return true;
+  }
+
+  // The differencer compares float and double values one at a time. Instead,
+  // first compare with repeated float and double fields compared in bulk. Fields
+  // that are equal get ignored, which a diff would report, so a mismatch still
+  // gets explained by comparing value by value.
+  if (plan.compare_float_arrays) {
+    ::google::protobuf::util::MessageDifferencer float_differencer;
+    ::google::protobuf::util::DefaultFieldComparator float_comparator;
+    ConfigureDifferencer(comp, plan, &float_comparator, &float_differencer);
+    float_differencer.AddIgnoreCriteria(std::make_unique<FloatArrayCriteria>(comp));
+    const bool match = float_differencer.Compare(expected, actual);
+    if (match || diff == nullptr) {
+      return match;
+    }
   }
 
   ::google::protobuf::util::MessageDifferencer differencer;
   ::google::protobuf::util::DefaultFieldComparator field_comparator;
-  ConfigureDifferencer(comp, &field_comparator, &differencer, actual.GetDescriptor());
+  ConfigureDifferencer(comp, plan, &field_comparator, &differencer);
+
+  // Comparing ignoring the order of repeated fields matches elements pairwise,
+  // which is quadratic. Instead compare copies whose repeated fields are sorted
+  // by element hash, so equal elements mostly end up at the same index. Their
+  // order does not change the result. A diff would refer to the sorted indices
+  // though, so a mismatch still gets explained from the original messages.
+  if (plan.sort_repeated_fields) {
+    const RepeatedFieldSorter sorter(plan);
+    if (sorter.HasLargeRepeatedField(expected) || sorter.HasLargeRepeatedField(actual)) {
+      const std::unique_ptr<::google::protobuf::Message> sorted_expected(expected.New());
+      const std::unique_ptr<::google::protobuf::Message> sorted_actual(actual.New());
+      sorted_expected->CopyFrom(expected);
+      sorted_actual->CopyFrom(actual);
+      sorter.Sort(*sorted_expected);
+      sorter.Sort(*sorted_actual);
+      const bool match = differencer.Compare(*sorted_expected, *sorted_actual);
+      if (match || diff == nullptr) {
+        return match;
+      }
+    }
+  }
+
+  if (diff != nullptr) {
+    differencer.ReportDifferencesToString(diff);
+  }
 
   // It's important for 'expected' to be the first argument here, as
   // Compare() is not symmetric.  When we do a partial comparison,
   // only fields present in the first argument of Compare() are
-  // considered.
+  // considered. The diff is reported in terms of how the protobuf
+  // changes from the first argument to the second argument.
   return differencer.Compare(expected, actual);
 }
 
+std::string FormatDiff(std::string diff) {
+  // Removes the trailing '\n' in the diff to make the output look nicer.
+  if (!diff.empty() && *(diff.end() - 1) == '\n') {
+    diff.erase(diff.end() - 1);
+  }
+
+  return absl::StrCat("with the difference:\n", diff);
+}
+
+}  // namespace
+
+ProtoComparisonPlan MakeProtoComparisonPlan(
+    const ProtoComparison& comp,
+    const ::google::protobuf::Descriptor& descriptor) {
+  ProtoComparisonPlan plan;
+  if (!comp.ignore_fields.empty()) {
+    plan.ignore_fields = GetFieldDescriptors(&descriptor, comp.ignore_fields);
+  }
+  plan.ignore_field_paths.reserve(comp.ignore_field_paths.size());
+  for (const std::string& field_path : comp.ignore_field_paths) {
+    plan.ignore_field_paths.push_back(ParseFieldPathOrDie(field_path, descriptor));
+  }
+  plan.compare_serialized = comp.treating_nan_as_equal || !MayHoldFloatingPoint(descriptor);
+  // Sorting cannot help partial comparison, where elements on the actual side
+  // have more fields. And it would change which element an index ignores.
+  // Approximate float comparison is not transitive, so the greedy matching of
+  // the differencer could find a different verdict for a different order.
+  plan.sort_repeated_fields = comp.repeated_field_comp == kProtoCompareRepeatedFieldsIgnoringOrdering
+                              && comp.scope == kProtoFull && comp.float_comp == kProtoExact
+                              && HasRepeatedFields(descriptor)
+                              && std::none_of(
+                                  plan.ignore_field_paths.begin(), plan.ignore_field_paths.end(),
+                                  [](const auto& field_path) {
+                                    return std::any_of(field_path.begin(), field_path.end(), [](const auto& field) {
+                                      return field.index != -1;
+                                    });
+                                  });
+  plan.compare_float_arrays = comp.repeated_field_comp == kProtoCompareRepeatedFieldsRespectOrdering
+                              && HasRepeatedFloatingPoint(descriptor);
+  return plan;
+}
+
+const ProtoComparisonPlan& ProtoComparisonPlans::Get(const ::google::protobuf::Descriptor& descriptor) const {
+  const absl::MutexLock lock(&mutex_);
+  std::unique_ptr<const ProtoComparisonPlan>& plan = plans_[&descriptor];
+  if (plan == nullptr) {
+    plan = std::make_unique<const ProtoComparisonPlan>(MakeProtoComparisonPlan(comp_, descriptor));
+  }
+  return *plan;
+}
+
+// Returns true iff actual and expected are comparable and match.  The
+// comp argument specifies how two are compared.
+bool ProtoCompare(
+    const internal::ProtoComparison& comp,
+    const ::google::protobuf::Message& actual,
+    const ::google::protobuf::Message& expected) {
+  if (!ProtoComparable(actual, expected)) {
+    return false;
+  }
+  return ProtoCompare(comp, MakeProtoComparisonPlan(comp, *actual.GetDescriptor()), actual, expected);
+}
+
+bool ProtoCompare(
+    const internal::ProtoComparison& comp,
+    const ProtoComparisonPlan& plan,
+    const ::google::protobuf::Message& actual,
+    const ::google::protobuf::Message& expected) {
+  if (!ProtoComparable(actual, expected)) {
+    return false;
+  }
+  return CompareAndReportDiff(comp, plan, actual, expected, nullptr);
+}
+
 // Describes the types of the expected and the actual protocol buffer.
 std::string DescribeTypes(const ::google::protobuf::Message& expected, const ::google::protobuf::Message& actual) {
   return absl::StrCat(
@@ -315,24 +858,17 @@ std::string DescribeDiff(
     const internal::ProtoComparison& comp,
     const ::google::protobuf::Message& actual,
     const ::google::protobuf::Message& expected) {
-  ::google::protobuf::util::MessageDifferencer differencer;
-  ::google::protobuf::util::DefaultFieldComparator field_comparator;
-  ConfigureDifferencer(comp, &field_comparator, &differencer, actual.GetDescriptor());
+  return DescribeDiff(comp, MakeProtoComparisonPlan(comp, *actual.GetDescriptor()), actual, expected);
+}
 
+std::string DescribeDiff(
+    const internal::ProtoComparison& comp,
+    const ProtoComparisonPlan& plan,
+    const ::google::protobuf::Message& actual,
+    const ::google::protobuf::Message& expected) {
   std::string diff;
-  differencer.ReportDifferencesToString(&diff);
-
-  // We must put 'expected' as the first argument here, as Compare()
-  // reports the diff in terms of how the protobuf changes from the
-  // first argument to the second argument.
-  differencer.Compare(expected, actual);
-
-  // Removes the trailing '\n' in the diff to make the output look nicer.
-  if (!diff.empty() && *(diff.end() - 1) == '\n') {
-    diff.erase(diff.end() - 1);
-  }
-
-  return absl::StrCat("with the difference:\n", diff);
+  CompareAndReportDiff(comp, plan, actual, expected, &diff);
+  return FormatDiff(std::move(diff));
 }
 
 bool ProtoMatcherBase::MatchAndExplain(
@@ -352,10 +888,17 @@ bool ProtoMatcherBase::MatchAndExplain(
 
   // Protobufs of different types cannot be compared.
   const bool comparable = ProtoComparable(arg, *expected);
-  const bool match = comparable && ProtoCompare(comp(), arg, *expected);
 
   // Explaining the match result is expensive.  We don't want to waste
   // time calculating an explanation if the listener isn't interested.
+  // Otherwise the same comparison that decides the match also reports
+  // the differences, so the protobufs are only compared once.
+  std::string diff;
+  const bool match = comparable
+                     && CompareAndReportDiff(
+                         comp(), plans_->Get(*arg.GetDescriptor()), arg, *expected,
+                         listener->IsInterested() ? &diff : nullptr);
+
   if (listener->IsInterested()) {
     const char* sep = "";
     if (is_matcher_for_pointer) {
@@ -366,7 +909,7 @@ bool ProtoMatcherBase::MatchAndExplain(
     if (!comparable) {
       *listener << sep << DescribeTypes(*expected, arg);
     } else if (!match) {
-      *listener << sep << DescribeDiff(comp(), arg, *expected);
+      *listener << sep << FormatDiff(std::move(diff));
     }
   }
 
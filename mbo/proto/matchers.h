@@ -22,11 +22,16 @@
 #include <ostream>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
 #include "absl/log/absl_check.h"
+#include "absl/synchronization/mutex.h"
 #include "gmock/gmock.h"
+#include "google/protobuf/descriptor.h"
 #include "google/protobuf/message.h"
 #include "google/protobuf/util/message_differencer.h"
 #include "gtest/gtest.h"
@@ -99,6 +104,58 @@ Proto MakePartialProtoFromAscii(const std::string& str) {
 // Returns true iff `lhs` and `rhs` can be compared (i.e. have the same descriptor).
 bool ProtoComparable(const ::google::protobuf::Message& lhs, const ::google::protobuf::Message& rhs);
 
+// The ignored fields and field paths of a ProtoComparison, resolved against
+// the descriptor of the compared messages.
+struct ProtoComparisonPlan {
+  std::vector<const ::google::protobuf::FieldDescriptor*> ignore_fields;
+  std::vector<std::vector<::google::protobuf::util::MessageDifferencer::SpecificField>> ignore_field_paths;
+  // Whether messages with identical deterministic serializations are known to
+  // match, so the differencer is only needed when the bytes differ. That is
+  // not the case if they may hold NaNs which do not compare equal.
+  bool compare_serialized = false;
+  // Whether repeated fields get compared ignoring their order and both sides
+  // can be sorted by element hashes first. The differencer then finds almost
+  // all matching elements at the same index instead of searching pairwise.
+  // Only for exact comparison, where sorting cannot change the verdict.
+  bool sort_repeated_fields = false;
+  // Whether repeated float and double fields get compared in order and can be
+  // compared in bulk before the differencer compares them one at a time.
+  bool compare_float_arrays = false;
+};
+
+// Resolves the ignored fields and field paths of `comp` for messages of type
+// `descriptor`. Dies if any of them is invalid.
+ProtoComparisonPlan MakeProtoComparisonPlan(
+    const ProtoComparison& comp,
+    const ::google::protobuf::Descriptor& descriptor);
+
+// Holds the ProtoComparisonPlans of one ProtoComparison, one per message type,
+// so that repeated comparisons do not look up names or parse field paths. The
+// comparison is fixed, so the plans can never be used for another one.
+class ProtoComparisonPlans {
+ public:
+  explicit ProtoComparisonPlans(ProtoComparison comp) : comp_(std::move(comp)) {}
+
+  ProtoComparisonPlans(const ProtoComparisonPlans&) = delete;
+  ProtoComparisonPlans& operator=(const ProtoComparisonPlans&) = delete;
+  ProtoComparisonPlans(ProtoComparisonPlans&&) = delete;
+  ProtoComparisonPlans& operator=(ProtoComparisonPlans&&) = delete;
+  ~ProtoComparisonPlans() = default;
+
+  // NOLINTNEXTLINE(readability-identifier-naming)
+  const ProtoComparison& comp() const { return comp_; }
+
+  // Returns the plan for `descriptor`, creating it on first use. The plan
+  // lives as long as this object.
+  const ProtoComparisonPlan& Get(const ::google::protobuf::Descriptor& descriptor) const;
+
+ private:
+  const ProtoComparison comp_;
+  mutable absl::Mutex mutex_;
+  mutable absl::flat_hash_map<const ::google::protobuf::Descriptor*, std::unique_ptr<const ProtoComparisonPlan>> plans_
+      ABSL_GUARDED_BY(mutex_);
+};
+
 // Returns true iff actual and expected are comparable and match.  The
 // comp argument specifies how the two are compared.
 bool ProtoCompare(
@@ -106,6 +163,14 @@ bool ProtoCompare(
     const ::google::protobuf::Message& actual,
     const ::google::protobuf::Message& expected);
 
+// Overload for ProtoCompare with the ignored fields already resolved in `plan`
+// for the type of `actual`.
+bool ProtoCompare(
+    const ProtoComparison& comp,
+    const ProtoComparisonPlan& plan,
+    const ::google::protobuf::Message& actual,
+    const ::google::protobuf::Message& expected);
+
 // Overload for ProtoCompare where the expected message is specified as a text
 // proto.  If the text cannot be parsed as a message of the same type as the
 // actual message, a CHECK failure will cause the test to fail and no subsequent
@@ -127,16 +192,23 @@ std::string DescribeDiff(
     const ::google::protobuf::Message& actual,
     const ::google::protobuf::Message& expected);
 
+// Overload for DescribeDiff with the ignored fields already resolved in `plan`
+// for the type of `actual`.
+std::string DescribeDiff(
+    const ProtoComparison& comp,
+    const ProtoComparisonPlan& plan,
+    const ::google::protobuf::Message& actual,
+    const ::google::protobuf::Message& expected);
+
 // Common code for implementing EqualsProto.
 class ProtoMatcherBase {
  public:
   ProtoMatcherBase(
       bool must_be_initialized,     // Must the argument be fully initialized?
       const ProtoComparison& comp)  // How to compare the two protobufs.
-      : must_be_initialized_(must_be_initialized), comp_(new auto(comp)) {}
+      : must_be_initialized_(must_be_initialized), plans_(std::make_shared<const ProtoComparisonPlans>(comp)) {}
 
-  ProtoMatcherBase(const ProtoMatcherBase& other)
-      : must_be_initialized_(other.must_be_initialized_), comp_(new auto(*other.comp_)) {}
+  ProtoMatcherBase(const ProtoMatcherBase& other) = default;
 
   ProtoMatcherBase& operator=(const ProtoMatcherBase& other) = delete;
 
@@ -162,47 +234,53 @@ class ProtoMatcherBase {
   virtual void DeleteExpectedProto(const ::google::protobuf::Message* expected) const = 0;
 
   // Makes this matcher compare floating-points approximately.
-  void SetCompareApproximately() { comp_->float_comp = kProtoApproximate; }
+  void SetCompareApproximately() { UpdateComp([](ProtoComparison& comp) { comp.float_comp = kProtoApproximate; }); }
 
   // Makes this matcher treating NaNs as equal when comparing floating-points.
-  void SetCompareTreatingNaNsAsEqual() { comp_->treating_nan_as_equal = true; }
+  void SetCompareTreatingNaNsAsEqual() { UpdateComp([](ProtoComparison& comp) { comp.treating_nan_as_equal = true; }); }
 
   // Makes this matcher ignore string elements specified by their fully
   // qualified names, i.e., names corresponding to FieldDescriptor.full_name().
   template<class Iterator>
   void AddCompareIgnoringFields(Iterator first, Iterator last) {
-    comp_->ignore_fields.insert(comp_->ignore_fields.end(), first, last);
+    UpdateComp([&](ProtoComparison& comp) { comp.ignore_fields.insert(comp.ignore_fields.end(), first, last); });
   }
 
   // Makes this matcher ignore string elements specified by their relative
   // FieldPath.
   template<class Iterator>
   void AddCompareIgnoringFieldPaths(Iterator first, Iterator last) {
-    comp_->ignore_field_paths.insert(comp_->ignore_field_paths.end(), first, last);
+    UpdateComp([&](ProtoComparison& comp) {
+      comp.ignore_field_paths.insert(comp.ignore_field_paths.end(), first, last);
+    });
   }
 
   // Makes this matcher compare repeated fields ignoring ordering of elements.
   void SetCompareRepeatedFieldsIgnoringOrdering() {
-    comp_->repeated_field_comp = kProtoCompareRepeatedFieldsIgnoringOrdering;
+    UpdateComp([](ProtoComparison& comp) { comp.repeated_field_comp = kProtoCompareRepeatedFieldsIgnoringOrdering; });
   }
 
   // Sets the margin of error for approximate floating point comparison.
   void SetMargin(double margin) {
     ABSL_CHECK_GE(margin, 0.0) << "Using a negative margin for Approximately";
-    comp_->has_custom_margin = true;
-    comp_->float_margin = margin;
+    UpdateComp([margin](ProtoComparison& comp) {
+      comp.has_custom_margin = true;
+      comp.float_margin = margin;
+    });
   }
 
   // Sets the relative fraction of error for approximate floating point
   // comparison.
   void SetFraction(double fraction) {
     ABSL_CHECK(0.0 <= fraction && fraction < 1.0) << "Fraction for Approximately must be >= 0.0 and < 1.0";
-    comp_->has_custom_fraction = true;
-    comp_->float_fraction = fraction;
+    UpdateComp([fraction](ProtoComparison& comp) {
+      comp.has_custom_fraction = true;
+      comp.float_fraction = fraction;
+    });
   }
 
   // Makes this matcher compare protobufs partially.
-  void SetComparePartially() { comp_->scope = kProtoPartial; }
+  void SetComparePartially() { UpdateComp([](ProtoComparison& comp) { comp.scope = kProtoPartial; }); }
 
   bool MatchAndExplain(const ::google::protobuf::Message& arg, ::testing::MatchResultListener* listener) const {
     return MatchAndExplain(arg, false, listener);
@@ -215,41 +293,41 @@ class ProtoMatcherBase {
   // Describes the expected relation between the actual protobuf and
   // the expected one.
   void DescribeRelationToExpectedProto(std::ostream* os) const {
-    if (comp_->repeated_field_comp == kProtoCompareRepeatedFieldsIgnoringOrdering) {
+    if (comp().repeated_field_comp == kProtoCompareRepeatedFieldsIgnoringOrdering) {
       *os << "(ignoring repeated field ordering) ";
     }
-    if (!comp_->ignore_fields.empty()) {
+    if (!comp().ignore_fields.empty()) {
       *os << "(ignoring fields: ";
       const char* sep = "";
-      for (size_t i = 0; i < comp_->ignore_fields.size(); ++i, sep = ", ") {
-        *os << sep << comp_->ignore_fields[i];
+      for (size_t i = 0; i < comp().ignore_fields.size(); ++i, sep = ", ") {
+        *os << sep << comp().ignore_fields[i];
       }
       *os << ") ";
     }
-    if (comp_->float_comp == kProtoApproximate) {
+    if (comp().float_comp == kProtoApproximate) {
       *os << "approximately ";
-      if (comp_->has_custom_margin || comp_->has_custom_fraction) {
+      if (comp().has_custom_margin || comp().has_custom_fraction) {
         *os << "(";
-        if (comp_->has_custom_margin) {
+        if (comp().has_custom_margin) {
           std::stringstream sss;
-          sss << std::setprecision(std::numeric_limits<double>::digits10 + 2) << comp_->float_margin;
+          sss << std::setprecision(std::numeric_limits<double>::digits10 + 2) << comp().float_margin;
           *os << "absolute error of float or double fields <= " << sss.str();
         }
-        if (comp_->has_custom_margin && comp_->has_custom_fraction) {
+        if (comp().has_custom_margin && comp().has_custom_fraction) {
           *os << " or ";
         }
-        if (comp_->has_custom_fraction) {
+        if (comp().has_custom_fraction) {
           std::stringstream sss;
-          sss << std::setprecision(std::numeric_limits<double>::digits10 + 2) << comp_->float_fraction;
+          sss << std::setprecision(std::numeric_limits<double>::digits10 + 2) << comp().float_fraction;
           *os << "relative error of float or double fields <= " << sss.str();
         }
         *os << ") ";
       }
     }
 
-    *os << (comp_->scope == kProtoPartial ? "partially " : "")
-        << (comp_->field_comp == kProtoEqual ? "equal" : "equivalent")
-        << (comp_->treating_nan_as_equal ? " (treating NaNs as equal)" : "") << " to ";
+    *os << (comp().scope == kProtoPartial ? "partially " : "")
+        << (comp().field_comp == kProtoEqual ? "equal" : "equivalent")
+        << (comp().treating_nan_as_equal ? " (treating NaNs as equal)" : "") << " to ";
     PrintExpectedTo(os);
   }
 
@@ -267,7 +345,7 @@ class ProtoMatcherBase {
   bool must_be_initialized() const { return must_be_initialized_; }
 
   // NOLINTNEXTLINE(readability-identifier-naming)
-  const ProtoComparison& comp() const { return *comp_; }
+  const ProtoComparison& comp() const { return plans_->comp(); }
 
  private:
   bool MatchAndExplain(
@@ -275,8 +353,19 @@ class ProtoMatcherBase {
       bool is_matcher_for_pointer,
       ::testing::MatchResultListener* listener) const;
 
+  // Applies `update` to the comparison. The plans were made for the old one,
+  // so copies of this matcher keep them while this one starts over.
+  template<typename Update>
+  void UpdateComp(Update update) {
+    ProtoComparison comp = plans_->comp();
+    update(comp);
+    plans_ = std::make_shared<const ProtoComparisonPlans>(std::move(comp));
+  }
+
   const bool must_be_initialized_;
-  std::unique_ptr<ProtoComparison> comp_;
+  // Holds the comparison and is shared by copies of the matcher until their
+  // comparison changes.
+  std::shared_ptr<const ProtoComparisonPlans> plans_;
 };
 
 // Returns a copy of the given ::proto2 message.
@@ -321,45 +410,69 @@ class ProtoMatcher : public ProtoMatcherBase {
   const std::shared_ptr<const ::google::protobuf::Message> expected_;
 };
 
+// Holds the protobufs parsed from the text of a ProtoStringMatcher, one per
+// message type. The text is parsed once for each type it gets matched against.
+class ExpectedProtoCache {
+ public:
+  struct Entry {
+    std::unique_ptr<const ::google::protobuf::Message> proto;  // nullptr if the text doesn't parse.
+    std::string error_text;
+  };
+
+  explicit ExpectedProtoCache(std::string_view text) : text_(text) {}
+
+  ExpectedProtoCache(const ExpectedProtoCache&) = delete;
+  ExpectedProtoCache& operator=(const ExpectedProtoCache&) = delete;
+  ExpectedProtoCache(ExpectedProtoCache&&) = delete;
+  ExpectedProtoCache& operator=(ExpectedProtoCache&&) = delete;
+  ~ExpectedProtoCache() = default;
+
+  // Returns the entry for the type of `arg`, parsing the text on first use.
+  // The entry lives as long as the cache.
+  const Entry& Get(const ::google::protobuf::Message& arg) const;
+
+  // NOLINTNEXTLINE(readability-identifier-naming)
+  const std::string& text() const { return text_; }
+
+ private:
+  const std::string text_;
+  mutable absl::Mutex mutex_;
+  mutable absl::flat_hash_map<const ::google::protobuf::Descriptor*, std::unique_ptr<const Entry>> entries_
+      ABSL_GUARDED_BY(mutex_);
+};
+
 // Implements EqualsProto, where the matcher parameter is a string.
+//
+// Copies of the matcher share the parsed expected protobufs, so matching many
+// values (e.g. with `Each` or `Contains`) does not parse the text every time.
 class ProtoStringMatcher : public ProtoMatcherBase {
  public:
   ProtoStringMatcher(
       std::string_view expected,    // The text representing the expected protobuf.
       bool must_be_initialized,     // Must the argument be fully initialized?
       const ProtoComparison& comp)  // How to compare the two protobufs.
-      : ProtoMatcherBase(must_be_initialized, comp), expected_(expected) {}
+      : ProtoMatcherBase(must_be_initialized, comp), expected_(std::make_shared<const ExpectedProtoCache>(expected)) {}
 
-  // Parses the expected string as a protobuf of the same type as arg,
-  // and returns the parsed protobuf (or nullptr when the parse fails).
-  // The caller must call DeleteExpectedProto() on the return value
-  // later.
+  // Returns the expected string parsed as a protobuf of the same type as arg
+  // (or nullptr when the parse fails). The result is owned by the matcher.
   const ::google::protobuf::Message* CreateExpectedProto(
       const ::google::protobuf::Message& arg,
       ::testing::MatchResultListener* listener) const override {
-    ::google::protobuf::Message* expected_proto = arg.New();
-    std::string error_text;
-    if (ParsePartialFromAscii(expected_, expected_proto, &error_text)) {
-      return expected_proto;
-    } else {
-      delete expected_proto;  // NOLINT(cppcoreguidelines-owning-memory)
-      if (listener->IsInterested()) {
-        *listener << "where ";
-        PrintExpectedTo(listener->stream());
-        *listener << " doesn't parse as a " << arg.GetDescriptor()->full_name() << ":\n" << error_text;
-      }
-      return nullptr;
+    const ExpectedProtoCache::Entry& entry = expected_->Get(arg);
+    if (entry.proto == nullptr && listener->IsInterested()) {
+      *listener << "where ";
+      PrintExpectedTo(listener->stream());
+      *listener << " doesn't parse as a " << arg.GetDescriptor()->full_name() << ":\n" << entry.error_text;
     }
+    return entry.proto.get();
   }
 
-  void DeleteExpectedProto(const ::google::protobuf::Message* expected) const override {
-    delete expected;  // NOLINT(cppcoreguidelines-owning-memory)
-  }
+  void DeleteExpectedProto(const ::google::protobuf::Message* /* expected */) const override {}
 
-  void PrintExpectedTo(std::ostream* os) const override { *os << "<" << expected_ << ">"; }
+  void PrintExpectedTo(std::ostream* os) const override { *os << "<" << expected_->text() << ">"; }
 
  private:
-  const std::string expected_;
+  const std::shared_ptr<const ExpectedProtoCache> expected_;
 };
 
 using PolymorphicProtoMatcher = ::testing::PolymorphicMatcher<ProtoMatcher>;
@@ -579,23 +692,32 @@ class TupleProtoMatcher {
   template<typename Tuple>
   class Impl : public ::testing::MatcherInterface<Tuple> {
    public:
-    explicit Impl(const ProtoComparison& comp) : comp_(comp) {}
+    explicit Impl(const ProtoComparison& comp) : plans_(comp) {}
 
     virtual bool MatchAndExplain(Tuple args, ::testing::MatchResultListener* /* listener */) const {
       using ::testing::get;
-      return ProtoCompare(comp_, get<0>(args), get<1>(args));
+      return Compare(get<0>(args), get<1>(args));
     }
 
     virtual void DescribeTo(std::ostream* os) const {
-      *os << (comp_.field_comp == kProtoEqual ? "are equal" : "are equivalent");
+      *os << (plans_.comp().field_comp == kProtoEqual ? "are equal" : "are equivalent");
     }
 
     virtual void DescribeNegationTo(std::ostream* os) const {
-      *os << (comp_.field_comp == kProtoEqual ? "are not equal" : "are not equivalent");
+      *os << (plans_.comp().field_comp == kProtoEqual ? "are not equal" : "are not equivalent");
     }
 
    private:
-    const ProtoComparison comp_;
+    bool Compare(const ::google::protobuf::Message& actual, const ::google::protobuf::Message& expected) const {
+      return ProtoCompare(plans_.comp(), plans_.Get(*actual.GetDescriptor()), actual, expected);
+    }
+
+    template<typename Proto>
+    bool Compare(const Proto& actual, const std::string& expected) const {
+      return Compare(actual, MakePartialProtoFromAscii<Proto>(expected));
+    }
+
+    const ProtoComparisonPlans plans_;
   };
 
   std::unique_ptr<ProtoComparison> comp_;
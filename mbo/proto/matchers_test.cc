@@ -15,24 +15,41 @@
 
 #include "mbo/proto/matchers.h"
 
+#include <cmath>
+#include <memory>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include "gmock/gmock.h"
+#include "google/protobuf/descriptor.h"
+#include "google/protobuf/descriptor.pb.h"
+#include "google/protobuf/dynamic_message.h"
+#include "google/protobuf/message.h"
 #include "gtest/gtest.h"
 #include "mbo/proto/parse_text_proto.h"
+#include "mbo/proto/tests/simple_message.pb.h"
 #include "mbo/proto/tests/test.pb.h"
 
 namespace mbo::proto {
 namespace {
 
 using ::mbo::proto::ParseTextProtoOrDie;
+using ::mbo::proto::tests::SimpleMessage;
+using ::mbo::proto::tests::TestFloats;
 using ::mbo::proto::tests::TestMessage;
 using ::mbo::proto::tests::TestMessage2;
+using ::testing::AllOf;
+using ::testing::Contains;
+using ::testing::Each;
 using ::testing::EndsWith;
 using ::testing::HasSubstr;
+using ::testing::Matcher;
 using ::testing::Matches;
 using ::testing::Not;
+using ::testing::NotNull;
 using ::testing::SafeMatcherCast;
 
 template<typename T, typename M>
@@ -49,6 +66,89 @@ TEST(Matchers, EqualsProto) {
   EXPECT_THAT(GetExplanation(EqualsProto(R"pb(num: 43 name: "name")pb"), msg), EndsWith("modified: num: 43 -> 42"));
 }
 
+TEST(Matchers, EqualsProtoExplanation) {
+  const TestMessage msg = ParseTextProtoOrDie(R"pb(num: 42 name: "name")pb");
+  EXPECT_THAT(GetExplanation(EqualsProto(R"pb(num: 42 name: "name")pb"), msg), "");
+  EXPECT_THAT(
+      GetExplanation(EqualsProto(R"pb(num: 43 name: "other")pb"), &msg),
+      AllOf(
+          HasSubstr("which points to "), HasSubstr("with the difference:\n"),
+          HasSubstr("modified: name: \"other\" -> \"name\""), EndsWith("modified: num: 43 -> 42")));
+  EXPECT_THAT(
+      GetExplanation(EqualsProto(TestMessage2{}), msg),
+      "whose type should be mbo.proto.tests.TestMessage2 but actually is mbo.proto.tests.TestMessage");
+}
+
+TEST(Matchers, EqualsProtoStringForManyValues) {
+  const std::vector<TestMessage> msgs(1'000, ParseTextProtoOrDie(R"pb(num: 42)pb"));
+  EXPECT_THAT(msgs, Each(EqualsProto(R"pb(num: 42)pb")));
+  EXPECT_THAT(msgs, Not(Contains(EqualsProto(R"pb(num: 43)pb"))));
+}
+
+TEST(Matchers, EqualsProtoStringForDifferentTypes) {
+  const auto matcher = EqualsProto(R"pb(num: 42)pb");
+  const TestMessage msg1 = ParseTextProtoOrDie(R"pb(num: 42)pb");
+  const TestMessage2 msg2 = ParseTextProtoOrDie(R"pb(num: 42)pb");
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_THAT(msg1, matcher);
+    EXPECT_THAT(msg2, matcher);
+    EXPECT_THAT(TestMessage2{}, Not(matcher));
+  }
+}
+
+TEST(Matchers, EqualsProtoStringParseError) {
+  const auto matcher = EqualsProto(R"pb(unknown: 42)pb");
+  const TestMessage msg;
+  const std::string explanation = GetExplanation(matcher, msg);
+  EXPECT_THAT(explanation, HasSubstr("doesn't parse as a mbo.proto.tests.TestMessage"));
+  EXPECT_THAT(GetExplanation(matcher, msg), explanation);
+  EXPECT_THAT(msg, Not(matcher));
+}
+
+TEST(Matchers, EqualsProtoStringConcurrent) {
+  const Matcher<const TestMessage&> matcher = EqualsProto(R"pb(num: 42 name: "name")pb");
+  const TestMessage msg = ParseTextProtoOrDie(R"pb(num: 42 name: "name")pb");
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&] {
+      for (int i = 0; i < 100; ++i) {
+        EXPECT_TRUE(matcher.Matches(msg));
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
+
+TEST(Matchers, ComparisonPlanCompareSerialized) {
+  const internal::ProtoComparison comp;
+  EXPECT_TRUE(internal::MakeProtoComparisonPlan(comp, *SimpleMessage::descriptor()).compare_serialized);
+  EXPECT_FALSE(internal::MakeProtoComparisonPlan(comp, *TestMessage::descriptor()).compare_serialized);
+  EXPECT_FALSE(internal::MakeProtoComparisonPlan(comp, *TestMessage2::descriptor()).compare_serialized);
+  const internal::ProtoComparison nan_comp{.treating_nan_as_equal = true};
+  EXPECT_TRUE(internal::MakeProtoComparisonPlan(nan_comp, *TestMessage2::descriptor()).compare_serialized);
+}
+
+TEST(Matchers, EqualsProtoSerialized) {
+  SimpleMessage msg = ParseTextProtoOrDie(R"pb(one: 1 two: [ 1, 2, 3 ])pb");
+  EXPECT_THAT(msg, EqualsProto(msg));
+  EXPECT_THAT(msg, EqualsProto(R"pb(one: 1 two: [ 1, 2, 3 ])pb"));
+  EXPECT_THAT(msg, Not(EqualsProto(R"pb(one: 1 two: [ 1, 3, 2 ])pb")));
+  EXPECT_THAT(msg, IgnoringRepeatedFieldOrdering(EqualsProto(R"pb(one: 1 two: [ 1, 3, 2 ])pb")));
+  EXPECT_THAT(msg, Partially(EqualsProto(R"pb(two: [ 1, 2, 3 ])pb")));
+  EXPECT_THAT(GetExplanation(EqualsProto(R"pb(one: 2 two: [ 1, 2, 3 ])pb"), msg), EndsWith("modified: one: 2 -> 1"));
+  msg.clear_one();
+  EXPECT_THAT(msg, Not(EqualsProto(R"pb(one: 0 two: [ 1, 2, 3 ])pb")));
+  EXPECT_THAT(msg, EquivToProto(R"pb(one: 0 two: [ 1, 2, 3 ])pb"));
+}
+
+TEST(Matchers, EqualsProtoNaNSerialized) {
+  const TestMessage2 msg = ParseTextProtoOrDie(R"pb(one { val: nan })pb");
+  EXPECT_THAT(msg, Not(EqualsProto(msg)));
+  EXPECT_THAT(msg, TreatingNaNsAsEqual(EqualsProto(msg)));
+}
+
 TEST(Matchers, EquivToProto) {
   const TestMessage msg1 = ParseTextProtoOrDie(R"pb(name: "name")pb");
   TestMessage msg2 = msg1;
@@ -75,6 +175,85 @@ TEST(Matchers, TreatingNaNsAsEqual) {
   EXPECT_THAT(GetExplanation(EqualsProto(R"pb(val: nan)pb"), msg), HasSubstr("val: nan -> nan"));
 }
 
+TEST(Matchers, ComparisonPlanCompareFloatArrays) {
+  const internal::ProtoComparison comp;
+  EXPECT_TRUE(internal::MakeProtoComparisonPlan(comp, *TestFloats::descriptor()).compare_float_arrays);
+  EXPECT_FALSE(internal::MakeProtoComparisonPlan(comp, *TestMessage2::descriptor()).compare_float_arrays);
+  const internal::ProtoComparison set_comp{
+      .repeated_field_comp = internal::kProtoCompareRepeatedFieldsIgnoringOrdering,
+  };
+  EXPECT_FALSE(internal::MakeProtoComparisonPlan(set_comp, *TestFloats::descriptor()).compare_float_arrays);
+}
+
+TEST(Matchers, FloatArrays) {
+  TestFloats msg;
+  for (int i = 0; i < 1000; ++i) {
+    msg.add_floats(static_cast<float>(i) / 7.0F);
+    msg.add_doubles(static_cast<double>(i) / 7.0);
+  }
+  *msg.add_children() = msg;
+  TestFloats expected = msg;
+  EXPECT_THAT(msg, EqualsProto(expected));
+  expected.mutable_children(0)->set_doubles(500, expected.doubles(500) * 1.001);
+  EXPECT_THAT(msg, Not(EqualsProto(expected)));
+  EXPECT_THAT(msg, Not(Approximately(EqualsProto(expected))));
+  EXPECT_THAT(msg, Approximately(EqualsProto(expected), 0.1));
+  EXPECT_THAT(msg, Approximately(EqualsProto(expected), 0.0, 0.01));
+  EXPECT_THAT(
+      GetExplanation(EqualsProto(expected), msg),
+      AllOf(HasSubstr("modified: children[0].doubles[500]: "), Not(HasSubstr("ignored:"))));
+  expected.mutable_children(0)->add_floats(0.0F);
+  EXPECT_THAT(msg, Not(Approximately(EqualsProto(expected), 0.1)));
+  EXPECT_THAT(
+      GetExplanation(Approximately(EqualsProto(expected), 0.1), msg),
+      HasSubstr("deleted: children[0].floats[1000]: 0"));
+}
+
+TEST(Matchers, FloatArraysDynamic) {
+  // Messages from another pool are not generated, so their values get gathered through reflection.
+  ::google::protobuf::FileDescriptorProto file;
+  TestFloats::descriptor()->file()->CopyTo(&file);
+  ::google::protobuf::DescriptorPool pool;
+  ASSERT_THAT(pool.BuildFile(file), NotNull());
+  ::google::protobuf::DynamicMessageFactory factory(&pool);
+  const ::google::protobuf::Descriptor* const descriptor =
+      pool.FindMessageTypeByName(TestFloats::descriptor()->full_name());
+  ASSERT_THAT(descriptor, NotNull());
+  const std::unique_ptr<::google::protobuf::Message> msg(factory.GetPrototype(descriptor)->New());
+  const ::google::protobuf::FieldDescriptor* const doubles = descriptor->FindFieldByName("doubles");
+  for (int i = 0; i < 1000; ++i) {
+    msg->GetReflection()->AddDouble(msg.get(), doubles, static_cast<double>(i) / 7.0);
+  }
+  const std::unique_ptr<::google::protobuf::Message> expected(msg->New());
+  expected->CopyFrom(*msg);
+  EXPECT_THAT(*msg, EqualsProto(*expected));
+  expected->GetReflection()->SetRepeatedDouble(expected.get(), doubles, 500, 1.0);
+  EXPECT_THAT(*msg, Not(EqualsProto(*expected)));
+  EXPECT_THAT(*msg, Approximately(EqualsProto(*expected), 100.0));
+  EXPECT_THAT(*msg, Not(Approximately(EqualsProto(*expected), 1.0)));
+}
+
+TEST(Matchers, FloatArraysNaN) {
+  TestFloats msg;
+  for (int i = 0; i < 100; ++i) {
+    msg.add_floats(i % 10 == 0 ? std::nanf("") : static_cast<float>(i));
+  }
+  EXPECT_THAT(msg, Not(EqualsProto(msg)));
+  EXPECT_THAT(msg, TreatingNaNsAsEqual(EqualsProto(msg)));
+  EXPECT_THAT(msg, Approximately(TreatingNaNsAsEqual(EqualsProto(msg))));
+  TestFloats expected = msg;
+  expected.set_floats(50, 0.0F);
+  EXPECT_THAT(msg, Not(TreatingNaNsAsEqual(EqualsProto(expected))));
+}
+
+TEST(Matchers, FloatArraysPartially) {
+  const TestFloats msg = ParseTextProtoOrDie(R"pb(floats: [ 1, 2, 3 ] doubles: [ 4, 5 ])pb");
+  EXPECT_THAT(msg, Partially(EqualsProto(R"pb(doubles: [ 4, 5 ])pb")));
+  EXPECT_THAT(msg, Not(Partially(EqualsProto(R"pb(doubles: [ 4 ])pb"))));
+  EXPECT_THAT(msg, Not(Partially(EqualsProto(R"pb(doubles: [ 5, 4 ])pb"))));
+  EXPECT_THAT(msg, IgnoringRepeatedFieldOrdering(Partially(EqualsProto(R"pb(doubles: [ 5, 4 ])pb"))));
+}
+
 TEST(Matchers, IgnoringFields) {
   const TestMessage msg = ParseTextProtoOrDie(R"pb(name: "name" num: 42)pb");
   EXPECT_THAT(msg, IgnoringFields({"mbo.proto.tests.TestMessage.num"}, EqualsProto(R"pb(name: "name" num: 25)pb")));
@@ -124,6 +303,42 @@ TEST(Matchers, IgnoringFieldPathsTerminalIndex) {
       "\\('num\\[0\\]'\\)");
 }
 
+TEST(Matchers, IgnoringFieldPathsForManyValues) {
+  std::vector<TestMessage2> msgs;
+  for (int i = 0; i < 1'000; ++i) {
+    msgs.push_back(ParseTextProtoOrDie(R"pb(one { name: "name" num: 42 })pb"));
+    msgs.back().mutable_one()->set_num(i);
+  }
+  EXPECT_THAT(msgs, Each(IgnoringFieldPaths({"one.num"}, EqualsProto(R"pb(one { name: "name" })pb"))));
+  EXPECT_THAT(msgs, Each(IgnoringFields({"mbo.proto.tests.TestMessage.num"}, EqualsProto(msgs.front()))));
+  EXPECT_THAT(msgs, Not(Each(EqualsProto(msgs.front()))));
+}
+
+TEST(Matchers, IgnoringFieldsAfterUse) {
+  const TestMessage msg = ParseTextProtoOrDie(R"pb(name: "name" num: 42)pb");
+  const auto matcher = EqualsProto(R"pb(name: "name" num: 25)pb");
+  EXPECT_THAT(msg, Not(matcher));
+  EXPECT_THAT(msg, IgnoringFields({"mbo.proto.tests.TestMessage.num"}, matcher));
+  EXPECT_THAT(msg, IgnoringFieldPaths({"num"}, matcher));
+  EXPECT_THAT(msg, Not(matcher));
+}
+
+TEST(Matchers, SettingsAfterUse) {
+  const TestMessage msg = ParseTextProtoOrDie(R"pb(val: nan)pb");
+  const auto nan_matcher = EqualsProto(R"pb(val: nan)pb");
+  EXPECT_THAT(msg, Not(nan_matcher));
+  EXPECT_THAT(msg, TreatingNaNsAsEqual(nan_matcher));
+  EXPECT_THAT(msg, Not(nan_matcher));
+  const TestMessage2 msg2 = ParseTextProtoOrDie(R"pb(num: [ 1, 2 ] more { val: 1 name: "name" })pb");
+  const auto matcher = EqualsProto(R"pb(num: [ 2, 1 ] more { val: 1.05 })pb");
+  EXPECT_THAT(msg2, Not(matcher));
+  EXPECT_THAT(msg2, Partially(IgnoringRepeatedFieldOrdering(Approximately(matcher, 0.1))));
+  EXPECT_THAT(msg2, Partially(IgnoringRepeatedFieldOrdering(Approximately(matcher, 0.0, 0.1))));
+  EXPECT_THAT(msg2, Not(Partially(IgnoringRepeatedFieldOrdering(Approximately(matcher, 0.01)))));
+  EXPECT_THAT(msg2, Not(IgnoringRepeatedFieldOrdering(Approximately(matcher, 0.1))));
+  EXPECT_THAT(msg2, Not(matcher));
+}
+
 TEST(Matchers, IgnoringRepeatedFieldOrdering) {
   const TestMessage2 msg = ParseTextProtoOrDie(R"pb(num: 1 num: 2)pb");
   EXPECT_THAT(msg, IgnoringRepeatedFieldOrdering(EqualsProto(R"pb(num: 2 num: 1)pb")));
@@ -140,6 +355,114 @@ TEST(Matchers, IgnoringRepeatedFieldOrderingNested) {
               )pb")));
 }
 
+TEST(Matchers, IgnoringRepeatedFieldOrderingLarge) {
+  TestMessage2 msg;
+  TestMessage2 reversed;
+  constexpr int kSize = 20'000;
+  for (int i = 0; i < kSize; ++i) {
+    msg.add_num(i % 100);
+    reversed.add_num((kSize - 1 - i) % 100);
+    TestMessage& more = *msg.add_more();
+    more.set_num(i);
+    more.set_name(i % 2 == 0 ? "even" : "odd");
+    more.set_val(i);
+  }
+  for (int i = kSize - 1; i >= 0; --i) {
+    *reversed.add_more() = msg.more(i);
+  }
+  EXPECT_THAT(msg, Not(EqualsProto(reversed)));
+  EXPECT_THAT(msg, IgnoringRepeatedFieldOrdering(EqualsProto(reversed)));
+  EXPECT_THAT(msg, IgnoringRepeatedFieldOrdering(EquivToProto(reversed)));
+  EXPECT_THAT(msg, Approximately(IgnoringRepeatedFieldOrdering(EqualsProto(reversed))));
+  EXPECT_THAT(msg, IgnoringFieldPaths({"more.val"}, IgnoringRepeatedFieldOrdering(EqualsProto(reversed))));
+  reversed.mutable_more(kSize / 2)->set_num(-1);
+  EXPECT_THAT(msg, Not(IgnoringRepeatedFieldOrdering(EqualsProto(reversed))));
+  EXPECT_THAT(msg, IgnoringFieldPaths({"more.num"}, IgnoringRepeatedFieldOrdering(EqualsProto(reversed))));
+  reversed.add_num(1);
+  EXPECT_THAT(msg, Not(IgnoringFieldPaths({"more.num"}, IgnoringRepeatedFieldOrdering(EqualsProto(reversed)))));
+}
+
+TEST(Matchers, ComparisonPlanSortRepeatedFields) {
+  const internal::ProtoComparison set_comp{
+      .repeated_field_comp = internal::kProtoCompareRepeatedFieldsIgnoringOrdering,
+  };
+  EXPECT_TRUE(internal::MakeProtoComparisonPlan(set_comp, *TestFloats::descriptor()).sort_repeated_fields);
+  const internal::ProtoComparison approximate_set_comp{
+      .float_comp = internal::kProtoApproximate,
+      .repeated_field_comp = internal::kProtoCompareRepeatedFieldsIgnoringOrdering,
+  };
+  EXPECT_FALSE(internal::MakeProtoComparisonPlan(approximate_set_comp, *TestFloats::descriptor()).sort_repeated_fields);
+}
+
+TEST(Matchers, IgnoringRepeatedFieldOrderingApproximatelyLarge) {
+  // Approximate matching is not transitive and elements get matched greedily,
+  // so the verdict depends on the order: With a margin of 1 the expected [1, 0]
+  // does not match the actual [0, 2], but the expected [0, 1] does. Large
+  // fields must get the same verdict as small ones.
+  for (const int pairs : {1, 20}) {
+    SCOPED_TRACE(pairs);
+    TestFloats msg;
+    TestFloats expected;
+    TestFloats swapped;
+    for (int i = 0; i < pairs; ++i) {
+      const double base = 10.0 * i;
+      for (const auto& [message, values] : {
+               std::pair{&msg, std::pair{base, base + 2}},
+               std::pair{&expected, std::pair{base + 1, base}},
+               std::pair{&swapped, std::pair{base, base + 1}},
+           }) {
+        message->add_doubles(values.first);
+        message->add_doubles(values.second);
+        message->add_children()->add_doubles(values.first);
+        message->add_children()->add_doubles(values.second);
+      }
+    }
+    EXPECT_THAT(msg, Not(Approximately(IgnoringRepeatedFieldOrdering(EqualsProto(expected)), 1.0)));
+    EXPECT_THAT(msg, Approximately(IgnoringRepeatedFieldOrdering(EqualsProto(swapped)), 1.0));
+  }
+}
+
+TEST(Matchers, IgnoringRepeatedFieldOrderingAfterUse) {
+  // The wrapped matcher must not reuse the comparison plan of the exact one,
+  // which sorts repeated fields. See the test above for the values.
+  TestFloats msg;
+  TestFloats expected;
+  TestFloats swapped;
+  for (int i = 0; i < 20; ++i) {
+    const double base = 10.0 * i;
+    msg.add_children()->add_doubles(base);
+    msg.add_children()->add_doubles(base + 2);
+    expected.add_children()->add_doubles(base + 1);
+    expected.add_children()->add_doubles(base);
+    swapped.add_children()->add_doubles(base);
+    swapped.add_children()->add_doubles(base + 1);
+  }
+  const auto matcher = IgnoringRepeatedFieldOrdering(EqualsProto(expected));
+  const auto swapped_matcher = IgnoringRepeatedFieldOrdering(EqualsProto(swapped));
+  EXPECT_THAT(msg, Not(matcher));
+  EXPECT_THAT(msg, Not(swapped_matcher));
+  EXPECT_THAT(msg, Not(Approximately(matcher, 1.0)));
+  EXPECT_THAT(msg, Approximately(swapped_matcher, 1.0));
+  const TestMessage2 partial = ParseTextProtoOrDie(R"pb(num: [ 3, 2, 1 ] more { num: 1 name: "one" })pb");
+  const auto partial_matcher = IgnoringRepeatedFieldOrdering(EqualsProto(R"pb(num: [ 1, 2, 3 ] more { num: 1 })pb"));
+  EXPECT_THAT(partial, Not(partial_matcher));
+  EXPECT_THAT(partial, Partially(partial_matcher));
+}
+
+TEST(Matchers, IgnoringRepeatedFieldOrderingExplanation) {
+  TestMessage2 msg;
+  for (int i = 0; i < 20; ++i) {
+    msg.add_num(i);
+  }
+  TestMessage2 expected = msg;
+  expected.mutable_num()->SwapElements(0, 19);
+  EXPECT_THAT(msg, IgnoringRepeatedFieldOrdering(EqualsProto(expected)));
+  expected.set_num(10, 42);
+  EXPECT_THAT(
+      GetExplanation(IgnoringRepeatedFieldOrdering(EqualsProto(expected)), msg),
+      AllOf(HasSubstr("added: num[10]: 10"), HasSubstr("deleted: num[10]: 42")));
+}
+
 TEST(Matchers, Partially) {
   const TestMessage msg = ParseTextProtoOrDie(R"pb(name: "name" num: 42)pb");
   EXPECT_THAT(msg, Partially(EqualsProto(R"pb(num: 42)pb")));
@@ -0,0 +1,244 @@
+// SPDX-FileCopyrightText: Copyright (c) The helly25/mbo authors (helly25.com)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mbo/proto/message_generator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "google/protobuf/descriptor.h"
+#include "google/protobuf/message.h"
+
+namespace mbo::proto {
+namespace {
+
+using ::google::protobuf::FieldDescriptor;
+
+constexpr std::string_view kAlphabet = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_ ";
+
+// Map entries are part of their map field, so they do not count as nesting.
+int ChildDepth(const FieldDescriptor& field, int depth) {
+  return field.is_map() ? depth : depth + 1;
+}
+
+}  // namespace
+
+MessageGenerator::MessageGenerator(const MessageGeneratorOptions& options) : options_(options), state_(options.seed) {}
+
+std::uint64_t MessageGenerator::Next() {
+  // SplitMix64: Fast, statistically good and the same on every platform.
+  // NOLINTBEGIN(*-magic-numbers)
+  std::uint64_t result = (state_ += 0x9E3779B97F4A7C15ULL);
+  result = (result ^ (result >> 30U)) * 0xBF58476D1CE4E5B9ULL;
+  result = (result ^ (result >> 27U)) * 0x94D049BB133111EBULL;
+  return result ^ (result >> 31U);
+  // NOLINTEND(*-magic-numbers)
+}
+
+std::uint64_t MessageGenerator::Uniform(std::uint64_t bound) {
+  return bound == 0 ? 0 : Next() % bound;
+}
+
+double MessageGenerator::UniformDouble() {
+  static constexpr int kMantissaBits = std::numeric_limits<double>::digits;
+  return static_cast<double>(Next() >> (64 - kMantissaBits)) * std::ldexp(1.0, -kMantissaBits);
+}
+
+template<typename T>
+T MessageGenerator::RandomInteger() {
+  using Unsigned = std::make_unsigned_t<T>;
+  const auto bits = static_cast<unsigned>(Uniform(std::numeric_limits<T>::digits + 1));
+  const auto magnitude = static_cast<Unsigned>(bits == 0 ? 0 : Next() >> (64U - bits));
+  if constexpr (std::is_signed_v<T>) {
+    const auto value = static_cast<T>(magnitude);
+    return Chance(0.5) ? -value : value;  // NOLINT(*-magic-numbers)
+  } else {
+    return magnitude;
+  }
+}
+
+double MessageGenerator::RandomFloat() {
+  if (Chance(options_.float_nan_fraction)) {
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+  return options_.float_min + UniformDouble() * (options_.float_max - options_.float_min);
+}
+
+std::string MessageGenerator::RandomString(bool bytes) {
+  std::string result(Uniform(options_.max_string_length + 1), '\0');
+  for (char& chr : result) {
+    chr = bytes ? static_cast<char>(Uniform(256)) : kAlphabet[Uniform(kAlphabet.size())];  // NOLINT(*-magic-numbers)
+  }
+  return result;
+}
+
+void MessageGenerator::Fill(::google::protobuf::Message& message) {
+  message.Clear();
+  FillMessage(message, 0);
+  if (options_.target_bytes == 0) {
+    return;
+  }
+  // Computing the size is linear in the message size. So grow in batches whose size is estimated
+  // from the bytes per element of the previous batch.
+  std::size_t size = message.ByteSizeLong();
+  std::size_t batch = 1;
+  while (size < options_.target_bytes) {
+    for (std::size_t i = 0; i < batch; ++i) {
+      if (!Grow(message, 0)) {
+        return;
+      }
+    }
+    const std::size_t grown = message.ByteSizeLong();
+    const double bytes_per_element = static_cast<double>(std::max<std::size_t>(grown - size, 1)) / batch;
+    size = grown;
+    if (size < options_.target_bytes) {
+      batch = std::max<std::size_t>(
+          1, static_cast<std::size_t>(static_cast<double>(options_.target_bytes - size) / bytes_per_element));
+    }
+  }
+}
+
+void MessageGenerator::FillMessage(::google::protobuf::Message& message, int depth) {
+  const ::google::protobuf::Descriptor& descriptor = *message.GetDescriptor();
+  // Messages created only because they are required get only their required fields.
+  const bool required_only = depth > options_.max_depth;
+  for (int i = 0; i < descriptor.field_count(); ++i) {
+    const FieldDescriptor& field = *descriptor.field(i);
+    const bool is_message = field.cpp_type() == FieldDescriptor::CPPTYPE_MESSAGE;
+    if (field.is_repeated()) {
+      if (required_only || (is_message && ChildDepth(field, depth) > options_.max_depth)) {
+        continue;
+      }
+      const int range = std::max(options_.max_repeated - options_.min_repeated, 0) + 1;
+      const auto count = options_.min_repeated + static_cast<int>(Uniform(range));
+      for (int n = 0; n < count; ++n) {
+        SetField(message, field, depth);
+      }
+    } else if (const ::google::protobuf::OneofDescriptor* oneof = field.real_containing_oneof(); oneof != nullptr) {
+      // A oneof is decided once, at its first field.
+      if (field.index_in_oneof() == 0 && !required_only && Chance(options_.field_presence)) {
+        const FieldDescriptor& chosen = *oneof->field(static_cast<int>(Uniform(oneof->field_count())));
+        if (chosen.cpp_type() != FieldDescriptor::CPPTYPE_MESSAGE || depth < options_.max_depth) {
+          SetField(message, chosen, depth);
+        }
+      }
+    } else if (field.is_required()) {
+      SetField(message, field, depth);
+    } else if (!required_only && (!is_message || depth < options_.max_depth) && Chance(options_.field_presence)) {
+      SetField(message, field, depth);
+    }
+  }
+}
+
+void MessageGenerator::SetField(
+    ::google::protobuf::Message& message,
+    const FieldDescriptor& field,
+    int depth) {
+  const ::google::protobuf::Reflection& reflection = *message.GetReflection();
+  const bool repeated = field.is_repeated();
+  switch (field.cpp_type()) {
+    case FieldDescriptor::CPPTYPE_INT32: {
+      const auto value = RandomInteger<std::int32_t>();
+      repeated ? reflection.AddInt32(&message, &field, value) : reflection.SetInt32(&message, &field, value);
+      break;
+    }
+    case FieldDescriptor::CPPTYPE_INT64: {
+      const auto value = RandomInteger<std::int64_t>();
+      repeated ? reflection.AddInt64(&message, &field, value) : reflection.SetInt64(&message, &field, value);
+      break;
+    }
+    case FieldDescriptor::CPPTYPE_UINT32: {
+      const auto value = RandomInteger<std::uint32_t>();
+      repeated ? reflection.AddUInt32(&message, &field, value) : reflection.SetUInt32(&message, &field, value);
+      break;
+    }
+    case FieldDescriptor::CPPTYPE_UINT64: {
+      const auto value = RandomInteger<std::uint64_t>();
+      repeated ? reflection.AddUInt64(&message, &field, value) : reflection.SetUInt64(&message, &field, value);
+      break;
+    }
+    case FieldDescriptor::CPPTYPE_DOUBLE: {
+      const double value = RandomFloat();
+      repeated ? reflection.AddDouble(&message, &field, value) : reflection.SetDouble(&message, &field, value);
+      break;
+    }
+    case FieldDescriptor::CPPTYPE_FLOAT: {
+      const auto value = static_cast<float>(RandomFloat());
+      repeated ? reflection.AddFloat(&message, &field, value) : reflection.SetFloat(&message, &field, value);
+      break;
+    }
+    case FieldDescriptor::CPPTYPE_BOOL: {
+      const bool value = Chance(0.5);  // NOLINT(*-magic-numbers)
+      repeated ? reflection.AddBool(&message, &field, value) : reflection.SetBool(&message, &field, value);
+      break;
+    }
+    case FieldDescriptor::CPPTYPE_ENUM: {
+      const ::google::protobuf::EnumDescriptor& type = *field.enum_type();
+      const int value = type.value(static_cast<int>(Uniform(type.value_count())))->number();
+      repeated ? reflection.AddEnumValue(&message, &field, value)
+               : reflection.SetEnumValue(&message, &field, value);
+      break;
+    }
+    case FieldDescriptor::CPPTYPE_STRING: {
+      std::string value = RandomString(field.type() == FieldDescriptor::TYPE_BYTES);
+      repeated ? reflection.AddString(&message, &field, std::move(value))
+               : reflection.SetString(&message, &field, std::move(value));
+      break;
+    }
+    case FieldDescriptor::CPPTYPE_MESSAGE: {
+      ::google::protobuf::Message& child =
+          repeated ? *reflection.AddMessage(&message, &field) : *reflection.MutableMessage(&message, &field);
+      FillMessage(child, ChildDepth(field, depth));
+      break;
+    }
+  }
+}
+
+bool MessageGenerator::Grow(::google::protobuf::Message& message, int depth) {
+  const ::google::protobuf::Descriptor& descriptor = *message.GetDescriptor();
+  std::vector<const FieldDescriptor*> repeated;
+  std::vector<const FieldDescriptor*> children;
+  for (int i = 0; i < descriptor.field_count(); ++i) {
+    const FieldDescriptor* field = descriptor.field(i);
+    const bool is_message = field->cpp_type() == FieldDescriptor::CPPTYPE_MESSAGE;
+    if (field->is_repeated()) {
+      if (!is_message || ChildDepth(*field, depth) <= options_.max_depth) {
+        repeated.push_back(field);
+      }
+    } else if (is_message && message.GetReflection()->HasField(message, field)) {
+      children.push_back(field);
+    }
+  }
+  if (!repeated.empty()) {
+    SetField(message, *repeated[Uniform(repeated.size())], depth);
+    return true;
+  }
+  for (const FieldDescriptor* field : children) {
+    if (Grow(*message.GetReflection()->MutableMessage(&message, field), depth + 1)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace mbo::proto
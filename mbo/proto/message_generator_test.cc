@@ -0,0 +1,114 @@
+// SPDX-FileCopyrightText: Copyright (c) The helly25/mbo authors (helly25.com)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mbo/proto/message_generator.h"
+
+#include <cmath>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "mbo/proto/matchers.h"
+#include "mbo/proto/tests/simple_message.pb.h"
+#include "mbo/proto/tests/test.pb.h"
+
+namespace mbo::proto {
+namespace {
+// NOLINTBEGIN(*-magic-numbers)
+
+using ::mbo::proto::EqualsProto;
+using ::mbo::proto::tests::SimpleMessage;
+using ::mbo::proto::tests::TestMessage;
+using ::mbo::proto::tests::TestMessage2;
+using ::testing::AllOf;
+using ::testing::Ge;
+using ::testing::Le;
+using ::testing::Not;
+using ::testing::SizeIs;
+
+struct MessageGeneratorTest : ::testing::Test {};
+
+TEST_F(MessageGeneratorTest, Deterministic) {
+  MessageGenerator generator({.seed = 42});
+  MessageGenerator same({.seed = 42});
+  MessageGenerator other({.seed = 43});
+  const TestMessage2 first = generator.Generate<TestMessage2>();
+  EXPECT_THAT(same.Generate<TestMessage2>(), EqualsProto(first));
+  EXPECT_THAT(other.Generate<TestMessage2>(), Not(EqualsProto(first)));
+  // A generator continues its sequence.
+  EXPECT_THAT(generator.Generate<TestMessage2>(), Not(EqualsProto(first)));
+}
+
+TEST_F(MessageGeneratorTest, TargetBytes) {
+  for (const std::size_t target : {100, 10'000, 1'000'000}) {
+    MessageGenerator generator({.target_bytes = target});
+    const TestMessage2 proto = generator.Generate<TestMessage2>();
+    EXPECT_THAT(proto.ByteSizeLong(), AllOf(Ge(target), Le(target + target / 10 + 100))) << "Target: " << target;
+  }
+  // A message without repeated fields cannot grow.
+  MessageGenerator generator({.target_bytes = 1'000});
+  EXPECT_THAT(generator.Generate<TestMessage>().ByteSizeLong(), Le(100));
+}
+
+TEST_F(MessageGeneratorTest, Shape) {
+  {
+    MessageGenerator generator({.min_repeated = 3, .max_repeated = 3, .field_presence = 1.0});
+    const TestMessage2 proto = generator.Generate<TestMessage2>();
+    EXPECT_THAT(proto.num(), SizeIs(3));
+    EXPECT_THAT(proto.more(), SizeIs(3));
+    EXPECT_TRUE(proto.has_one());
+    EXPECT_TRUE(proto.one().has_name());
+  }
+  {
+    MessageGenerator generator({.max_repeated = 0, .field_presence = 0.0});
+    EXPECT_THAT(generator.Generate<TestMessage2>(), EqualsProto(""));
+  }
+  {
+    MessageGenerator generator({.max_depth = 0, .min_repeated = 2, .field_presence = 1.0});
+    const TestMessage2 proto = generator.Generate<TestMessage2>();
+    EXPECT_FALSE(proto.has_one());
+    EXPECT_THAT(proto.more(), SizeIs(0));
+    EXPECT_THAT(proto.num(), SizeIs(Ge(2)));
+  }
+}
+
+TEST_F(MessageGeneratorTest, Values) {
+  MessageGenerator generator({.max_string_length = 5, .float_min = 1.0, .float_max = 2.0});
+  for (int i = 0; i < 100; ++i) {
+    const TestMessage proto = generator.Generate<TestMessage>();
+    EXPECT_THAT(proto.name().size(), Le(5));
+    if (proto.has_val()) {
+      EXPECT_THAT(proto.val(), AllOf(Ge(1.0), Le(2.0)));
+    }
+  }
+  MessageGenerator nan_generator({.field_presence = 1.0, .float_nan_fraction = 1.0});
+  EXPECT_TRUE(std::isnan(nan_generator.Generate<TestMessage>().val()));
+}
+
+TEST_F(MessageGeneratorTest, VarintLengths) {
+  MessageGenerator generator({.min_repeated = 1'000, .max_repeated = 1'000});
+  const SimpleMessage proto = generator.Generate<SimpleMessage>();
+  bool small = false;
+  bool large = false;
+  for (const int value : proto.two()) {
+    small |= value >= -127 && value <= 127;
+    large |= value >= (1 << 28) || value <= -(1 << 28);
+  }
+  EXPECT_TRUE(small);
+  EXPECT_TRUE(large);
+}
+
+// NOLINTEND(*-magic-numbers)
+}  // namespace
+}  // namespace mbo::proto
@@ -15,44 +15,159 @@
 
 #include "mbo/proto/parse_text_proto.h"
 
+#include <cstdint>
+#include <memory>
 #include <source_location>
 #include <string>
 #include <string_view>
+#include <tuple>
+#include <utility>
 
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/log/absl_check.h"
 #include "absl/log/absl_log.h"
 #include "absl/status/status.h"
+#include "absl/strings/cord.h"
 #include "absl/strings/str_format.h"
+#include "absl/synchronization/mutex.h"
+#include "google/protobuf/descriptor.h"
 #include "google/protobuf/message.h"
-#include "google/protobuf/text_format.h"
-#include "mbo/proto/silent_error_collector.h"
+#include "mbo/proto/text_proto_parser.h"
 
 namespace mbo::proto::proto_internal {
+namespace {
 
-absl::Status ParseTextInternal(
-    std::string_view text_proto,
+// Memoized messages of `ParseTextOnceOrDieInternal` by call site and message type.
+class ParsedTextCache final {
+ public:
+  static ParsedTextCache& Global() {
+    static ParsedTextCache* cache = new ParsedTextCache();  // NOLINT(cppcoreguidelines-owning-memory)
+    return *cache;
+  }
+
+  const ::google::protobuf::Message& Get(
+      std::string_view text,
+      const ::google::protobuf::Message& prototype,
+      std::string_view func,
+      std::source_location loc) {
+    const Key key{loc.file_name(), loc.line(), loc.column(), prototype.GetDescriptor()};
+    {
+      const absl::ReaderMutexLock lock(&mutex_);
+      if (const auto it = entries_.find(key); it != entries_.end()) {
+        return Check(it->second, text, func, loc);
+      }
+    }
+    // Parse outside of the lock, so that unrelated call sites are not blocked. If another thread
+    // wins the race, then its message is used and this one is dropped.
+    Entry entry{
+        .text = std::string(text),
+        .message = std::unique_ptr<::google::protobuf::Message>(prototype.New()),
+    };
+    ParseTextOrDieInternal(text, entry.message.get(), func, loc);
+    const absl::MutexLock lock(&mutex_);
+    return Check(entries_.try_emplace(key, std::move(entry)).first->second, text, func, loc);
+  }
+
+ private:
+  struct Entry {
+    std::string text;
+    std::unique_ptr<::google::protobuf::Message> message;
+  };
+
+  // The file name is compared by pointer: Each translation unit may have its own copy, which only
+  // results in separate entries.
+  using Key = std::tuple<const char*, std::uint_least32_t, std::uint_least32_t, const ::google::protobuf::Descriptor*>;
+
+  static const ::google::protobuf::Message& Check(
+      const Entry& entry,
+      std::string_view text,
+      std::string_view func,
+      std::source_location loc) {
+    ABSL_CHECK(entry.text == text) << func << " called with different text from the same call site\n"
+                                   << "File: '" << loc.file_name() << "', Line: " << loc.line() << ": "
+                                   << loc.function_name();
+    return *entry.message;
+  }
+
+  absl::Mutex mutex_;
+  absl::flat_hash_map<Key, Entry> entries_ ABSL_GUARDED_BY(mutex_);
+};
+
+// One parser per thread, so that its setup is not repeated on every call.
+TextProtoParser& ThreadParser() {
+  thread_local TextProtoParser parser;
+  return parser;
+}
+
+// Parses `text` which is either a `std::string_view` or an `absl::Cord`. Neither gets copied.
+template<typename Text>
+absl::Status ParseTextImpl(
+    const Text& text,
     ::google::protobuf::Message* message,
     std::string_view func,
     std::source_location loc) {
-  google::protobuf::TextFormat::Parser parser;
-  SilentErrorCollector error_collector;
-  parser.RecordErrorsTo(error_collector);
-  if (parser.ParseFromString(std::string(text_proto), message)) {
+  TextProtoParser& parser = ThreadParser();
+  if (parser.Parse(text, *message, loc).ok()) {
     return absl::OkStatus();
   }
   return absl::InvalidArgumentError(absl::StrFormat(
       "%s<%s>\nFile: '%s', Line: %d: %s\nError: %s", func, message->GetDescriptor()->name(), loc.file_name(),
-      loc.line(), loc.function_name(), error_collector.GetErrors()));
+      loc.line(), loc.function_name(), parser.errors().GetErrors()));
 }
 
-void ParseTextOrDieInternal(
-    std::string_view text,
+template<typename Text>
+void ParseTextOrDieImpl(
+    const Text& text,
     ::google::protobuf::Message* message,
     std::string_view func,
     std::source_location loc) {
-  const absl::Status status = ParseTextInternal(text, message, func, loc);
+  const absl::Status status = ParseTextImpl(text, message, func, loc);
   if (!status.ok()) {
     ABSL_LOG(FATAL) << "Check failed: " << status;
   }
 }
 
+}  // namespace
+
+absl::Status ParseTextInternal(
+    std::string_view text,
+    ::google::protobuf::Message* message,
+    std::string_view func,
+    std::source_location loc) {
+  return ParseTextImpl(text, message, func, loc);
+}
+
+absl::Status ParseTextInternal(
+    const absl::Cord& text,
+    ::google::protobuf::Message* message,
+    std::string_view func,
+    std::source_location loc) {
+  return ParseTextImpl(text, message, func, loc);
+}
+
+void ParseTextOrDieInternal(
+    std::string_view text,
+    ::google::protobuf::Message* message,
+    std::string_view func,
+    std::source_location loc) {
+  ParseTextOrDieImpl(text, message, func, loc);
+}
+
+void ParseTextOrDieInternal(
+    const absl::Cord& text,
+    ::google::protobuf::Message* message,
+    std::string_view func,
+    std::source_location loc) {
+  ParseTextOrDieImpl(text, message, func, loc);
+}
+
+const ::google::protobuf::Message& ParseTextOnceOrDieInternal(
+    std::string_view text,
+    const ::google::protobuf::Message& prototype,
+    std::string_view func,
+    std::source_location loc) {
+  return ParsedTextCache::Global().Get(text, prototype, func, loc);
+}
+
 }  // namespace mbo::proto::proto_internal
@@ -19,11 +19,14 @@
 #include <source_location>
 #include <string>
 #include <string_view>
+#include <type_traits>
 
 #include "absl/log/absl_check.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/strings/cord.h"
 #include "absl/strings/string_view.h"
+#include "google/protobuf/arena.h"
 #include "google/protobuf/message.h"
 
 namespace mbo::proto {
@@ -35,12 +38,35 @@ void ParseTextOrDieInternal(
     std::string_view func,
     std::source_location loc);
 
+void ParseTextOrDieInternal(
+    const absl::Cord& text,
+    ::google::protobuf::Message* message,
+    std::string_view func,
+    std::source_location loc);
+
 absl::Status ParseTextInternal(
     std::string_view text,
     ::google::protobuf::Message* message,
     std::string_view func,
     std::source_location loc);
 
+absl::Status ParseTextInternal(
+    const absl::Cord& text,
+    ::google::protobuf::Message* message,
+    std::string_view func,
+    std::source_location loc);
+
+// Returns the message of type `prototype` parsed from `text` at `loc`. The message is parsed once
+// per `loc` and type and then kept for the lifetime of the program.
+const ::google::protobuf::Message& ParseTextOnceOrDieInternal(
+    std::string_view text,
+    const ::google::protobuf::Message& prototype,
+    std::string_view func,
+    std::source_location loc);
+
+// The helpers only keep a view of the text. Only temporaries can be converted, which happens within
+// the full-expression that created them, so the text outlives them. A named helper (which could
+// outlive a temporary text) has to be moved explicitly.
 class ParseTextProtoHelper final {
  public:
   ~ParseTextProtoHelper() noexcept { ABSL_CHECK(parsed_) << "ParseTextProtoOrDie<T> result unused"; }
@@ -56,7 +82,7 @@ class ParseTextProtoHelper final {
 
   template<typename T>
   requires(std::derived_from<T, ::google::protobuf::Message> && !std::same_as<T, ::google::protobuf::Message>)
-  operator T() {  // NOLINT clangtidy(google-explicit-constructor)
+  operator T() && {  // NOLINT clangtidy(google-explicit-constructor)
     parsed_ = true;
     T message;
     ParseTextOrDieInternal(text_proto_, &message, "ParseTextProtoOrDie", loc_);
@@ -64,7 +90,71 @@ class ParseTextProtoHelper final {
   }
 
  private:
-  const std::string text_proto_;
+  const std::string_view text_proto_;
+  const std::source_location loc_;
+  bool parsed_{false};
+};
+
+// Same as `ParseTextProtoHelper` but creates the message on an arena and converts to a pointer.
+class ParseTextProtoOnArenaHelper final {
+ public:
+  ~ParseTextProtoOnArenaHelper() noexcept { ABSL_CHECK(parsed_) << "ParseTextProtoOrDie<T> result unused"; }
+
+  ParseTextProtoOnArenaHelper(
+      ::google::protobuf::Arena* arena,
+      std::string_view text_proto,
+      std::source_location loc) noexcept
+      : arena_(arena), text_proto_(text_proto), loc_(loc) {}
+
+  // This is a purely temporary object... no copy or move may be used.
+  ParseTextProtoOnArenaHelper(const ParseTextProtoOnArenaHelper&) noexcept = delete;
+  ParseTextProtoOnArenaHelper& operator=(const ParseTextProtoOnArenaHelper&) noexcept = delete;
+  ParseTextProtoOnArenaHelper(ParseTextProtoOnArenaHelper&&) noexcept = delete;
+  ParseTextProtoOnArenaHelper& operator=(ParseTextProtoOnArenaHelper&&) noexcept = delete;
+
+  // Allows conversion to both `T*` and `const T*`.
+  template<typename T, typename ProtoType = std::remove_const_t<T>>
+  requires(
+      std::derived_from<ProtoType, ::google::protobuf::Message>
+      && !std::same_as<ProtoType, ::google::protobuf::Message>)
+  operator T*() && {  // NOLINT clangtidy(google-explicit-constructor)
+    parsed_ = true;
+    ProtoType* message = ::google::protobuf::Arena::Create<ProtoType>(arena_);
+    ParseTextOrDieInternal(text_proto_, message, "ParseTextProtoOrDie", loc_);
+    return message;
+  }
+
+ private:
+  ::google::protobuf::Arena* const arena_;
+  const std::string_view text_proto_;
+  const std::source_location loc_;
+  bool parsed_{false};
+};
+
+// Same as `ParseTextProtoHelper` but the parsed message gets memoized, see `ParseTextProtoOnceOrDie`.
+class ParseTextProtoOnceHelper final {
+ public:
+  ~ParseTextProtoOnceHelper() noexcept { ABSL_CHECK(parsed_) << "ParseTextProtoOnceOrDie<T> result unused"; }
+
+  ParseTextProtoOnceHelper(std::string_view text_proto, std::source_location loc) noexcept
+      : text_proto_(text_proto), loc_(loc) {}
+
+  // This is a purely temporary object... no copy or move may be used.
+  ParseTextProtoOnceHelper(const ParseTextProtoOnceHelper&) noexcept = delete;
+  ParseTextProtoOnceHelper& operator=(const ParseTextProtoOnceHelper&) noexcept = delete;
+  ParseTextProtoOnceHelper(ParseTextProtoOnceHelper&&) noexcept = delete;
+  ParseTextProtoOnceHelper& operator=(ParseTextProtoOnceHelper&&) noexcept = delete;
+
+  template<typename T>
+  requires(std::derived_from<T, ::google::protobuf::Message> && !std::same_as<T, ::google::protobuf::Message>)
+  operator T() && {  // NOLINT clangtidy(google-explicit-constructor)
+    parsed_ = true;
+    return static_cast<const T&>(
+        ParseTextOnceOrDieInternal(text_proto_, T::default_instance(), "ParseTextProtoOnceOrDie", loc_));
+  }
+
+ private:
+  const std::string_view text_proto_;
   const std::source_location loc_;
   bool parsed_{false};
 };
@@ -88,6 +178,37 @@ inline proto_internal::ParseTextProtoHelper ParseTextProtoOrDie(
   return {text_proto, loc};
 }
 
+// Same as `ParseTextProtoOrDie` but the text gets parsed only once per call site (source location)
+// and message type. Every further call returns a copy of the memoized message. This makes repeated
+// construction of constant protos in loops, parameterized tests or benchmarks cost a copy instead
+// of a text parse. Memoized messages are never freed. See `ParseTextOnceOrDie` to avoid the copy.
+//
+// The text must be the same on every call from the same call site. It gets compared against the
+// memoized text and the program dies if they differ. Memoization is thread-safe. Example:
+//
+// ```
+// MyProtoType message = ParseTextProtoOnceOrDie(R"pb(field: 42)pb");
+// ```
+inline proto_internal::ParseTextProtoOnceHelper ParseTextProtoOnceOrDie(
+    std::string_view text_proto,
+    std::source_location loc = std::source_location::current()) {
+  return {text_proto, loc};
+}
+
+// Parses the text in 'text_proto' into a proto message created on 'arena' whose pointer type is
+// requested as return type. The message is owned by 'arena', or by the caller if 'arena' is null.
+// The function dies if parsing fails. Example:
+//
+// ```
+// MyProtoType* message = ParseTextProtoOrDie(&arena, R"pb(field: 42)pb");
+// ```
+inline proto_internal::ParseTextProtoOnArenaHelper ParseTextProtoOrDie(
+    ::google::protobuf::Arena* arena,
+    std::string_view text_proto,
+    std::source_location loc = std::source_location::current()) {
+  return {arena, text_proto, loc};
+}
+
 // Parses the text in 'text_proto' into a proto message of type 'T'.
 // The function dies if parsing fails.
 // Use this function only if the return type cannot be determined automatically.
@@ -99,6 +220,40 @@ inline T ParseTextOrDie(std::string_view text_proto, std::source_location loc =
   return message;
 }
 
+// Same as `ParseTextProtoOnceOrDie` but returns a reference to the memoized message of type 'T'
+// which remains valid for the lifetime of the program.
+template<typename T>
+requires(std::derived_from<T, ::google::protobuf::Message> && !std::same_as<T, ::google::protobuf::Message>)
+inline const T& ParseTextOnceOrDie(
+    std::string_view text_proto,
+    std::source_location loc = std::source_location::current()) {
+  return static_cast<const T&>(
+      proto_internal::ParseTextOnceOrDieInternal(text_proto, T::default_instance(), "ParseTextOnceOrDie", loc));
+}
+
+// Same as above but parses the text from the chunks of an `absl::Cord` without flattening it.
+template<typename T>
+requires(std::derived_from<T, ::google::protobuf::Message> && !std::same_as<T, ::google::protobuf::Message>)
+inline T ParseTextOrDie(const absl::Cord& text_proto, std::source_location loc = std::source_location::current()) {
+  T message;
+  proto_internal::ParseTextOrDieInternal(text_proto, &message, "ParseTextOrDie", loc);
+  return message;
+}
+
+// Parses the text in 'text_proto' into a proto message of type 'T' created on 'arena'.
+// The message is owned by 'arena', or by the caller if 'arena' is null.
+// The function dies if parsing fails.
+template<typename T>
+requires(std::derived_from<T, ::google::protobuf::Message> && !std::same_as<T, ::google::protobuf::Message>)
+inline T* ParseTextOrDie(
+    ::google::protobuf::Arena* arena,
+    std::string_view text_proto,
+    std::source_location loc = std::source_location::current()) {
+  T* message = ::google::protobuf::Arena::Create<T>(arena);
+  proto_internal::ParseTextOrDieInternal(text_proto, message, "ParseTextOrDie", loc);
+  return message;
+}
+
 // Parses the text in 'text_proto' into a proto message of type 'T' and return it wrapped as StatusOr.
 // If parsing fails, then an error status will be returned.
 template<typename T>
@@ -116,6 +271,41 @@ inline absl::StatusOr<T> ParseText(
   return message;
 }
 
+// Same as above but parses the text from the chunks of an `absl::Cord` without flattening it.
+template<typename T>
+requires(std::derived_from<T, ::google::protobuf::Message> && !std::same_as<T, ::google::protobuf::Message>)
+inline absl::StatusOr<T> ParseText(
+    const absl::Cord& text_proto,
+    std::source_location loc = std::source_location::current()) {
+  T message;
+  absl::Status result = proto_internal::ParseTextInternal(text_proto, &message, "ParseText", loc);
+  if (!result.ok()) {
+    return absl::Status(result.code(), absl::StrCat(result.message()));
+  }
+  return message;
+}
+
+// Parses the text in 'text_proto' into a proto message of type 'T' created on 'arena' and returns
+// the pointer wrapped as StatusOr. The message is owned by 'arena', or by the caller if 'arena' is
+// null. If parsing fails, then an error status will be returned and a heap allocated message will
+// be deleted, while an arena allocated one remains with the arena.
+template<typename T>
+requires(std::derived_from<T, ::google::protobuf::Message> && !std::same_as<T, ::google::protobuf::Message>)
+inline absl::StatusOr<T*> ParseText(
+    ::google::protobuf::Arena* arena,
+    std::string_view text_proto,
+    std::source_location loc = std::source_location::current()) {
+  T* message = ::google::protobuf::Arena::Create<T>(arena);
+  absl::Status result = proto_internal::ParseTextInternal(text_proto, message, "ParseText", loc);
+  if (!result.ok()) {
+    if (arena == nullptr) {
+      delete message;  // NOLINT(cppcoreguidelines-owning-memory)
+    }
+    return absl::Status(result.code(), absl::StrCat(result.message()));
+  }
+  return message;
+}
+
 }  // namespace mbo::proto
 
 #ifndef PARSE_TEXT_PROTO
@@ -15,19 +15,31 @@
 
 #include "mbo/proto/parse_text_proto.h"
 
+#include <source_location>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/strings/cord.h"
 #include "absl/strings/str_cat.h"
 #include "gmock/gmock.h"
+#include "google/protobuf/arena.h"
 #include "gtest/gtest.h"
 #include "mbo/proto/matchers.h"
 #include "mbo/proto/tests/simple_message.pb.h"
+#include "mbo/proto/tests/test.pb.h"
 
 namespace mbo::proto {
 namespace {
 
 using ::mbo::proto::EqualsProto;
 using ::mbo::proto::tests::SimpleMessage;
+using ::mbo::proto::tests::TestFloats;
+using ::mbo::proto::tests::TestMessage;
 using ::testing::ContainsRegex;
 
 class ParseTextProtoTest : public ::testing::Test {};
@@ -52,6 +64,19 @@ TEST_F(ParseTextProtoTest, ParseTextProtoOrDiePass) {
   EXPECT_THAT((SimpleMessage)ParseTextProtoOrDie("one: 25"), EqualsProto("one: 25"));
 }
 
+TEST_F(ParseTextProtoTest, OnlyTemporaryHelpersConvert) {
+  // The helpers only hold a view of the text, which a named helper could outlive.
+  static_assert(std::is_convertible_v<proto_internal::ParseTextProtoHelper&&, SimpleMessage>);
+  static_assert(!std::is_convertible_v<proto_internal::ParseTextProtoHelper&, SimpleMessage>);
+  static_assert(std::is_convertible_v<proto_internal::ParseTextProtoOnceHelper&&, SimpleMessage>);
+  static_assert(!std::is_convertible_v<proto_internal::ParseTextProtoOnceHelper&, SimpleMessage>);
+  static_assert(std::is_convertible_v<proto_internal::ParseTextProtoOnArenaHelper&&, SimpleMessage*>);
+  static_assert(!std::is_convertible_v<proto_internal::ParseTextProtoOnArenaHelper&, SimpleMessage*>);
+  auto helper = ParseTextProtoOrDie(R"pb(one: 42)pb");
+  const SimpleMessage message = std::move(helper);
+  EXPECT_THAT(message, EqualsProto(R"pb(one: 42)pb"));
+}
+
 TEST_F(ParseTextProtoTest, ParseTextProtoOrDieFail) {
   EXPECT_DEATH(
       [[maybe_unused]] const SimpleMessage msg = ParseTextProtoOrDie("!!!"),
@@ -82,6 +107,127 @@ TEST_F(ParseTextProtoTest, ParseText) {
           kExpected));
 }
 
+TEST_F(ParseTextProtoTest, ParseTextDeeplyNested) {
+  static constexpr int kDepth = 1'000;
+  std::string text;
+  for (int i = 0; i < kDepth; ++i) {
+    text += "children { ";
+  }
+  text += "floats: 1";
+  for (int i = 0; i < kDepth; ++i) {
+    text += " }";
+  }
+  const absl::StatusOr<TestFloats> proto = ParseText<TestFloats>(text);
+  ASSERT_THAT(proto.ok(), true) << proto.status();
+  const TestFloats* leaf = &*proto;
+  for (int i = 0; i < kDepth; ++i) {
+    ASSERT_THAT(leaf->children_size(), 1);
+    leaf = &leaf->children(0);
+  }
+  EXPECT_THAT(*leaf, EqualsProto("floats: 1"));
+}
+
+TEST_F(ParseTextProtoTest, ParseTextCord) {
+  absl::Cord text("one: 25");
+  text.Append(absl::MakeCordFromExternal(" two: [1, 2]", [] {}));
+  EXPECT_THAT(*ParseText<SimpleMessage>(text), EqualsProto("one: 25 two: [1, 2]"));
+  EXPECT_THAT(ParseTextOrDie<SimpleMessage>(text), EqualsProto("one: 25 two: [1, 2]"));
+  const absl::StatusOr<SimpleMessage> status = ParseText<SimpleMessage>(absl::Cord("!!!"));
+  EXPECT_THAT(status.status().code(), absl::StatusCode::kInvalidArgument);
+  EXPECT_DEATH(
+      ParseTextOrDie<SimpleMessage>(absl::Cord("!!!")), "Line 0, Col 0: Expected identifier, got: !");
+}
+
+TEST_F(ParseTextProtoTest, OnArena) {
+  ::google::protobuf::Arena arena;
+  const SimpleMessage* const parsed = ParseTextProtoOrDie(&arena, "one: 25");
+  EXPECT_THAT(*parsed, EqualsProto("one: 25"));
+  EXPECT_THAT(parsed->GetArena(), &arena);
+  const SimpleMessage* const parsed_or_die = ParseTextOrDie<SimpleMessage>(&arena, "one: 42");
+  EXPECT_THAT(*parsed_or_die, EqualsProto("one: 42"));
+  EXPECT_THAT(parsed_or_die->GetArena(), &arena);
+  const absl::StatusOr<SimpleMessage*> parsed_or_status = ParseText<SimpleMessage>(&arena, "two: 1 two: 2");
+  ASSERT_THAT(parsed_or_status.ok(), true);
+  EXPECT_THAT(**parsed_or_status, EqualsProto("two: 1 two: 2"));
+  EXPECT_THAT((*parsed_or_status)->GetArena(), &arena);
+  const absl::StatusOr<SimpleMessage*> error = ParseText<SimpleMessage>(nullptr, "!!!");
+  EXPECT_THAT(error.status().code(), absl::StatusCode::kInvalidArgument);
+  EXPECT_DEATH(
+      [[maybe_unused]] const SimpleMessage* msg = ParseTextProtoOrDie(&arena, "!!!"),
+      ".*Check failed: "                                   // Prefix
+      "INVALID_ARGUMENT: "                                 // StatusCode
+      "ParseTextProtoOrDie<SimpleMessage>.*\n.*"           // Called function
+      "File: '.*/parse_text_proto.*', Line: [0-9]+.*\n.*"  // Source
+      "Line 0, Col 0: Expected identifier, got: !.*");     // Error
+}
+
+TEST_F(ParseTextProtoTest, ParseTextOnceOrDie) {
+  const SimpleMessage* first = nullptr;
+  for (int i = 0; i < 3; ++i) {
+    const SimpleMessage& parsed = ParseTextOnceOrDie<SimpleMessage>("one: 25");
+    EXPECT_THAT(parsed, EqualsProto("one: 25"));
+    if (first == nullptr) {
+      first = &parsed;
+    }
+    EXPECT_THAT(&parsed, first);
+  }
+  // Another call site has its own message, even with the same text.
+  const SimpleMessage& other = ParseTextOnceOrDie<SimpleMessage>("one: 25");
+  EXPECT_NE(&other, first);
+}
+
+TEST_F(ParseTextProtoTest, ParseTextProtoOnceOrDie) {
+  for (int i = 0; i < 3; ++i) {
+    // Copies can be modified.
+    SimpleMessage copy = ParseTextProtoOnceOrDie("one: 25");
+    EXPECT_THAT(copy, EqualsProto("one: 25"));
+    copy.set_one(42);
+    EXPECT_THAT(copy, EqualsProto("one: 42"));
+  }
+}
+
+TEST_F(ParseTextProtoTest, ParseTextOnceOrDieTypes) {
+  const std::source_location loc = std::source_location::current();
+  const SimpleMessage& simple = ParseTextOnceOrDie<SimpleMessage>("", loc);
+  const TestMessage& test = ParseTextOnceOrDie<TestMessage>("", loc);
+  EXPECT_THAT(simple, EqualsProto(""));
+  EXPECT_THAT(test, EqualsProto(""));
+  EXPECT_THAT(simple.GetDescriptor(), SimpleMessage::descriptor());
+  EXPECT_THAT(test.GetDescriptor(), TestMessage::descriptor());
+}
+
+TEST_F(ParseTextProtoTest, ParseTextOnceOrDieThreads) {
+  static constexpr int kNumThreads = 8;
+  std::vector<const SimpleMessage*> parsed(kNumThreads);
+  {
+    std::vector<std::jthread> threads;
+    for (int i = 0; i < kNumThreads; ++i) {
+      threads.emplace_back([&parsed, i] { parsed[i] = &ParseTextOnceOrDie<SimpleMessage>("two: 1 two: 2"); });
+    }
+  }
+  for (const SimpleMessage* message : parsed) {
+    EXPECT_THAT(message, parsed.front());
+    EXPECT_THAT(*message, EqualsProto("two: 1 two: 2"));
+  }
+}
+
+TEST_F(ParseTextProtoTest, ParseTextProtoOnceOrDieFail) {
+  EXPECT_DEATH(
+      [[maybe_unused]] const SimpleMessage msg = ParseTextProtoOnceOrDie("!!!"),
+      ".*Check failed: "                                   // Prefix
+      "INVALID_ARGUMENT: "                                 // StatusCode
+      "ParseTextProtoOnceOrDie<SimpleMessage>.*\n.*"       // Called function
+      "File: '.*/parse_text_proto.*', Line: [0-9]+.*\n.*"  // Source
+      "Line 0, Col 0: Expected identifier, got: !.*");     // Error
+  EXPECT_DEATH(
+      {
+        const std::source_location loc = std::source_location::current();
+        ParseTextOnceOrDie<SimpleMessage>("one: 1", loc);
+        ParseTextOnceOrDie<SimpleMessage>("one: 2", loc);
+      },
+      "ParseTextOnceOrDie called with different text from the same call site");
+}
+
 TEST_F(ParseTextProtoTest, Macro) {
 #if defined(__clang__)
 #pragma clang diagnostic push
@@ -15,22 +15,87 @@
 
 #include "mbo/proto/silent_error_collector.h"
 
+#include <algorithm>
+#include <cstddef>
 #include <string>
 #include <string_view>
 
+#include "absl/base/log_severity.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
-#include "absl/strings/str_join.h"
 
 namespace mbo::proto {
 
+void SilentErrorCollector::Record(int line, int column, std::string_view message, absl::LogSeverity severity) {
+  if (limit_reached()) {
+    ++total_;
+    return;
+  }
+  ++total_;
+  const ErrorInfo error{.line = line, .column = column, .message = Intern(message), .severity = severity};
+  if (options_.max_stored_errors == 0 || errors_.size() < options_.max_stored_errors) {
+    errors_.push_back(error);
+    return;
+  }
+  // Drop the oldest message. The entries are small and trivially copyable, so shifting them keeps
+  // `errors_` in order at little cost.
+  std::move(errors_.begin() + 1, errors_.end(), errors_.begin());
+  errors_.back() = error;
+  ++overwritten_;
+}
+
+std::string_view SilentErrorCollector::Intern(std::string_view message) {
+  if (const auto it = texts_.find(message); it != texts_.end()) {
+    return *it;
+  }
+  // Dropped messages leave their texts behind. Erase those once the pool is twice as large as the
+  // stored messages can be, so its size remains bounded. The remaining texts do not move.
+  if (options_.max_stored_errors > 0 && texts_.size() >= 2 * options_.max_stored_errors) {
+    absl::flat_hash_set<const char*> stored;
+    for (const ErrorInfo& error : errors_) {
+      stored.insert(error.message.data());
+    }
+    for (auto it = texts_.begin(); it != texts_.end();) {
+      if (stored.contains(it->data())) {
+        ++it;
+      } else {
+        texts_.erase(it++);
+      }
+    }
+  }
+  return *texts_.emplace(message).first;
+}
+
+void SilentErrorCollector::clear() {
+  errors_.clear();
+  texts_.clear();
+  total_ = 0;
+  overwritten_ = 0;
+}
+
 std::string SilentErrorCollector::FormatError(const ErrorInfo& error) const {
   return absl::StrFormat("Line %d, Col %d: %s", error.line, error.column, error.message);
 }
 
 std::string SilentErrorCollector::GetErrors(std::string_view joiner) const {
-  return absl::StrJoin(
-      errors(), joiner, [this](std::string* out, const ErrorInfo& error) { absl::StrAppend(out, FormatError(error)); });
+  std::string result;
+  std::string_view separator;
+  if (overwritten_ > 0) {
+    absl::StrAppend(&result, overwritten_, " earlier errors dropped");
+    separator = joiner;
+  }
+  for (const ErrorInfo& error : *this) {
+    absl::StrAppend(&result, separator, FormatError(error));
+    separator = joiner;
+  }
+  if (limit_reached()) {
+    absl::StrAppend(&result, separator, "Stopped after ", options_.max_errors, " errors");
+    if (total_ > options_.max_errors) {
+      absl::StrAppend(&result, ", ", total_ - options_.max_errors, " more dropped");
+    }
+  }
+  return result;
 }
 
 }  // namespace mbo::proto
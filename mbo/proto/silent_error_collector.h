@@ -20,25 +20,45 @@
 #include <memory>
 #include <string>
 #include <string_view>
+#include <vector>
 
 #include "absl/base/log_severity.h"
+#include "absl/container/node_hash_set.h"
 #include "google/protobuf/io/tokenizer.h"
 
 namespace mbo::proto {
 
+// Options for `SilentErrorCollector`. The collector records errors as well as warnings, and both
+// count towards the limits.
+struct SilentErrorCollectorOptions {
+  // Once this many messages were recorded, all further messages get dropped and `limit_reached`
+  // becomes true, which makes `TextProtoParser` stop parsing. Zero means no limit.
+  std::size_t max_errors = 0;
+
+  // The number of most recent messages that are kept. Older messages get overwritten, which keeps
+  // the final (usually fatal) error. Zero means all messages are kept.
+  std::size_t max_stored_errors = 0;
+};
+
 // Collects errors from proto parsing.
 //
 // This class does not implement `::google::protobuf::io::ErrorCollector` but
 // can be used as such due to its conversion operator. The reason this is done,
 // is to disable direct access to the underlying functions which change accross
 // protobuf library versions.
+//
+// The cost of collecting can be bounded: With `max_stored_errors` only the most
+// recent messages are kept. Their texts are interned so that repeated messages
+// share one copy, and formatting only happens in `GetErrors`.
 class SilentErrorCollector {
  public:
   // NOLINTBEGIN(readability-identifier-naming)
   struct ErrorInfo {
     int line = 0;
     int column = 0;
-    std::string message;
+    // Interned text, which remains valid until the collector gets cleared or
+    // destroyed, or the message gets dropped from the `max_stored_errors`.
+    std::string_view message;
     absl::LogSeverity severity = absl::LogSeverity::kError;
 
     friend auto operator<=>(const ErrorInfo&, const ErrorInfo&) = default;
@@ -46,7 +66,10 @@ class SilentErrorCollector {
 
   using value_type = ErrorInfo;
 
-  SilentErrorCollector() : impl_(std::make_unique<Impl>(*this)) {}
+  SilentErrorCollector() : SilentErrorCollector(SilentErrorCollectorOptions{}) {}
+
+  explicit SilentErrorCollector(const SilentErrorCollectorOptions& options)
+      : options_(options), impl_(std::make_unique<Impl>(*this)) {}
 
   SilentErrorCollector(const SilentErrorCollector&) = delete;
   SilentErrorCollector& operator=(const SilentErrorCollector&) = delete;
@@ -57,9 +80,7 @@ class SilentErrorCollector {
 
   // Records a single message. In client code that manually needs to add messages always use this
   // variant and never RecordError/Warning or AddError/Warning.
-  void Record(int line, int column, std::string_view message, absl::LogSeverity severity) {
-    errors_.push_back({.line = line, .column = column, .message = std::string(message), .severity = severity});
-  }
+  void Record(int line, int column, std::string_view message, absl::LogSeverity severity);
 
   // NOLINTNEXTLINE(*-explicit-constructor,*-explicit-conversions)
   operator ::google::protobuf::io::ErrorCollector&() & { return *impl_; }
@@ -69,14 +90,29 @@ class SilentErrorCollector {
 
   virtual std::string FormatError(const ErrorInfo& error) const;
 
+  // Formats the stored messages. Messages that were dropped are summarized.
   std::string GetErrors(std::string_view joiner = "\n") const;
 
+  // The stored messages from the oldest to the most recent one.
   const std::vector<ErrorInfo>& errors() const { return errors_; }
 
   bool empty() const { return errors_.empty(); }
 
+  // The number of stored messages.
   std::size_t size() const { return errors_.size(); }
 
+  // The number of recorded messages including those that were dropped.
+  std::size_t total() const { return total_; }
+
+  // Whether `max_errors` is set.
+  bool limited() const { return options_.max_errors > 0; }
+
+  // Whether `max_errors` messages were recorded.
+  bool limit_reached() const { return limited() && total_ >= options_.max_errors; }
+
+  // Removes all recorded messages, so that the collector can be reused for another parse.
+  void clear();
+
   auto begin() const { return errors_.begin(); }
 
   auto end() const { return errors_.end(); }
@@ -106,8 +142,16 @@ class SilentErrorCollector {
     SilentErrorCollector& collector_;
   };
 
+  // Returns the pooled copy of `message`, dropping texts of messages that are no longer stored
+  // once the pool holds twice as many texts as can be stored.
+  std::string_view Intern(std::string_view message);
+
+  SilentErrorCollectorOptions options_;
   std::unique_ptr<Impl> impl_;
-  std::vector<ErrorInfo> errors_;
+  std::vector<ErrorInfo> errors_;  // From the oldest to the most recent message.
+  std::size_t total_ = 0;
+  std::size_t overwritten_ = 0;
+  absl::node_hash_set<std::string> texts_;  // Nodes are stable, so views into them remain valid.
 };
 
 }  // namespace mbo::proto
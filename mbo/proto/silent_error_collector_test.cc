@@ -16,6 +16,7 @@
 #include "mbo/proto/silent_error_collector.h"
 
 #include <string>
+#include <vector>
 
 #include "absl/base/log_severity.h"
 #include "absl/strings/str_split.h"
@@ -26,7 +27,10 @@
 
 namespace mbo::proto {
 
+using ::testing::ElementsAre;
 using ::testing::ElementsAreArray;
+using ::testing::Field;
+using ::testing::HasSubstr;
 using ::testing::IsEmpty;
 using ::testing::Not;
 using ::testing::NotNull;
@@ -66,6 +70,83 @@ TEST_F(SilentErrorCollectorTest, Test) {
           "Line 25, Col 42: error",
           "Line 33, Col 99: warning",
       }));
+  collector.clear();
+  EXPECT_THAT(collector, IsEmpty());
+  EXPECT_THAT(collector.GetErrors(), "");
+  // NOLINTEND(*-magic-numbers)
+}
+
+TEST_F(SilentErrorCollectorTest, RingBuffer) {
+  // NOLINTBEGIN(*-magic-numbers)
+  SilentErrorCollector collector({.max_stored_errors = 3});
+  for (int line = 1; line <= 10; ++line) {
+    Error(line, 0, std::to_string(line), collector);
+  }
+  EXPECT_THAT(collector, SizeIs(3));
+  EXPECT_THAT(collector.total(), 10);
+  EXPECT_THAT(
+      collector,
+      ElementsAre(
+          Field(&SilentErrorCollector::ErrorInfo::line, 8), Field(&SilentErrorCollector::ErrorInfo::line, 9),
+          Field(&SilentErrorCollector::ErrorInfo::line, 10)));
+  EXPECT_THAT(
+      collector.GetErrors(", "), "7 earlier errors dropped, Line 8, Col 0: 8, Line 9, Col 0: 9, Line 10, Col 0: 10");
+  EXPECT_FALSE(collector.limit_reached());
+  collector.clear();
+  EXPECT_THAT(collector, IsEmpty());
+  EXPECT_THAT(collector.total(), 0);
+  EXPECT_THAT(collector.GetErrors(), "");
+  // NOLINTEND(*-magic-numbers)
+}
+
+TEST_F(SilentErrorCollectorTest, Interning) {
+  // NOLINTBEGIN(*-magic-numbers)
+  SilentErrorCollector collector({.max_stored_errors = 2});
+  Error(1, 0, "same", collector);
+  Error(2, 0, "same", collector);
+  ASSERT_THAT(collector, SizeIs(2));
+  const std::vector<SilentErrorCollector::ErrorInfo>& errors = collector.errors();
+  EXPECT_THAT(errors[0].message.data(), errors[1].message.data());
+  // Many distinct texts compact the pool, while the texts of stored messages do not move.
+  Warning(3, 0, "kept", collector);
+  const SilentErrorCollector::ErrorInfo kept = errors.back();
+  for (int line = 4; line <= 100; ++line) {
+    Warning(line, 0, line % 2 == 0 ? std::to_string(line) : "kept", collector);
+  }
+  EXPECT_THAT(&collector.errors(), &errors);
+  EXPECT_THAT(
+      collector,
+      ElementsAreArray<SilentErrorCollector::ErrorInfo>({
+          {.line = 99, .column = 0, .message = "kept", .severity = absl::LogSeverity::kWarning},
+          {.line = 100, .column = 0, .message = "100", .severity = absl::LogSeverity::kWarning},
+      }));
+  EXPECT_THAT(kept.message, "kept");
+  EXPECT_THAT(errors[0].message.data(), kept.message.data());
+  // NOLINTEND(*-magic-numbers)
+}
+
+TEST_F(SilentErrorCollectorTest, StoresAllByDefault) {
+  SilentErrorCollector collector;
+  for (int line = 1; line <= 1'000; ++line) {
+    Error(line, 0, "error", collector);
+  }
+  EXPECT_THAT(collector, SizeIs(1'000));
+  EXPECT_THAT(collector.GetErrors(), Not(HasSubstr("dropped")));
+}
+
+TEST_F(SilentErrorCollectorTest, Limit) {
+  // NOLINTBEGIN(*-magic-numbers)
+  SilentErrorCollector collector({.max_errors = 2});
+  EXPECT_TRUE(collector.limited());
+  Error(1, 0, "one", collector);
+  EXPECT_FALSE(collector.limit_reached());
+  Warning(2, 0, "two", collector);
+  EXPECT_TRUE(collector.limit_reached());
+  Error(3, 0, "three", collector);
+  EXPECT_THAT(collector, SizeIs(2));
+  EXPECT_THAT(collector.total(), 3);
+  EXPECT_THAT(
+      collector.GetErrors(", "), "Line 1, Col 0: one, Line 2, Col 0: two, Stopped after 2 errors, 1 more dropped");
   // NOLINTEND(*-magic-numbers)
 }
 
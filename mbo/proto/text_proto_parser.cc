@@ -0,0 +1,129 @@
+// SPDX-FileCopyrightText: Copyright (c) The helly25/mbo authors (helly25.com)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mbo/proto/text_proto_parser.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <source_location>
+#include <string>
+#include <string_view>
+
+#include "absl/status/status.h"
+#include "absl/strings/cord.h"
+#include "absl/strings/str_format.h"
+#include "google/protobuf/io/zero_copy_stream.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
+#include "google/protobuf/message.h"
+#include "google/protobuf/text_format.h"
+#include "mbo/proto/file.h"
+#include "mbo/proto/silent_error_collector.h"
+
+namespace mbo::proto {
+namespace {
+
+using ::mbo::proto::proto_internal::SrcLoc;
+
+// Text is handed to the tokenizer in blocks of this size, so that a parse which reached the error
+// limit stops soon rather than only at the end of a large input.
+constexpr int kBlockSize = 8192;
+
+// Ends the input early once the error collector reached its limit.
+class LimitedInputStream final : public ::google::protobuf::io::ZeroCopyInputStream {
+ public:
+  LimitedInputStream(::google::protobuf::io::ZeroCopyInputStream& input, const SilentErrorCollector& errors)
+      : input_(input), errors_(errors) {}
+
+  bool Next(const void** data, int* size) override { return !errors_.limit_reached() && input_.Next(data, size); }
+
+  void BackUp(int count) override { input_.BackUp(count); }
+
+  bool Skip(int count) override { return !errors_.limit_reached() && input_.Skip(count); }
+
+  int64_t ByteCount() const override { return input_.ByteCount(); }
+
+ private:
+  ::google::protobuf::io::ZeroCopyInputStream& input_;
+  const SilentErrorCollector& errors_;
+};
+
+}  // namespace
+
+TextProtoParser::TextProtoParser(const TextProtoParserOptions& options) : error_collector_(options.errors) {
+  parser_.AllowPartialMessage(options.allow_partial_message);
+  parser_.AllowUnknownField(options.allow_unknown_field);
+  parser_.AllowUnknownExtension(options.allow_unknown_extension);
+  parser_.AllowFieldNumber(options.allow_field_number);
+  parser_.SetRecursionLimit(options.recursion_limit);
+  parser_.SetFinder(options.finder);
+  parser_.RecordErrorsTo(error_collector_);
+}
+
+bool TextProtoParser::ParseStream(
+    ::google::protobuf::io::ZeroCopyInputStream& input,
+    ::google::protobuf::Message& result) {
+  error_collector_.clear();
+  if (!error_collector_.limited()) {
+    return parser_.Parse(&input, &result);
+  }
+  LimitedInputStream limited_input(input, error_collector_);
+  return parser_.Parse(&limited_input, &result) && !error_collector_.limit_reached();
+}
+
+absl::Status TextProtoParser::Parse(
+    std::string_view text,
+    ::google::protobuf::Message& result,
+    const std::source_location& src_loc) {
+  if (text.size() > static_cast<std::size_t>(std::numeric_limits<int>::max())) {
+    return absl::InvalidArgumentError(absl::StrFormat("Cannot parse text proto @ %s: Too large.", SrcLoc(src_loc)));
+  }
+  ::google::protobuf::io::ArrayInputStream input(text.data(), static_cast<int>(text.size()), kBlockSize);
+  return Parse(input, result, src_loc);
+}
+
+absl::Status TextProtoParser::Parse(
+    const absl::Cord& text,
+    ::google::protobuf::Message& result,
+    const std::source_location& src_loc) {
+  ::google::protobuf::io::CordInputStream input(&text);
+  return Parse(input, result, src_loc);
+}
+
+absl::Status TextProtoParser::Parse(
+    ::google::protobuf::io::ZeroCopyInputStream& input,
+    ::google::protobuf::Message& result,
+    const std::source_location& src_loc) {
+  if (ParseStream(input, result)) {
+    return absl::OkStatus();
+  }
+  return absl::InvalidArgumentError(
+      absl::StrFormat("Cannot parse text proto @ %s: %s.", SrcLoc(src_loc), error_collector_.GetErrors(", ")));
+}
+
+absl::Status TextProtoParser::ParseFile(
+    const std::filesystem::path& filename,
+    ::google::protobuf::Message& result,
+    const std::source_location& src_loc) {
+  return proto_internal::ParseFile(filename, "text proto file", src_loc, [&](auto& input) {
+    if (ParseStream(input, result)) {
+      return absl::OkStatus();
+    }
+    return absl::AbortedError(absl::StrFormat(
+        "Cannot parse text proto file '%s' @%s: %s.", filename, SrcLoc(src_loc), error_collector_.GetErrors(", ")));
+  });
+}
+
+}  // namespace mbo::proto
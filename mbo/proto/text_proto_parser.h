@@ -0,0 +1,163 @@
+// SPDX-FileCopyrightText: Copyright (c) The helly25/mbo authors (helly25.com)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MBO_PROTO_TEXT_PROTO_PARSER_H_
+#define MBO_PROTO_TEXT_PROTO_PARSER_H_
+
+#include <filesystem>
+#include <limits>
+#include <source_location>
+#include <string_view>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/cord.h"
+#include "google/protobuf/io/zero_copy_stream.h"
+#include "google/protobuf/message.h"
+#include "google/protobuf/text_format.h"
+#include "mbo/proto/file.h"
+#include "mbo/proto/silent_error_collector.h"
+
+namespace mbo::proto {
+
+// Options for `TextProtoParser`.
+struct TextProtoParserOptions {
+  // Accept messages with missing required fields.
+  bool allow_partial_message = false;
+
+  // Skip fields that are not known to the message descriptor instead of failing.
+  bool allow_unknown_field = false;
+
+  // Skip extensions that cannot be found instead of failing.
+  bool allow_unknown_extension = false;
+
+  // Accept field numbers in place of field names.
+  bool allow_field_number = false;
+
+  // Maximum nesting depth of messages. Unlimited by default, like `TextFormat::Parser`.
+  int recursion_limit = std::numeric_limits<int>::max();
+
+  // Optional finder for extensions and `Any` types. It must outlive the parser.
+  const ::google::protobuf::TextFormat::Finder* finder = nullptr;
+
+  // Limits for the collected errors and warnings. If `errors.max_errors` is set, then parsing
+  // stops and fails once that many errors and warnings were recorded.
+  SilentErrorCollectorOptions errors;
+};
+
+// A text proto parser that is configured once and can then be reused for any number of parses.
+//
+// The functions in "mbo/proto/parse_text_proto.h" and "mbo/proto/file.h" use fixed options. This
+// class allows to control the options, and it avoids setting up a parser and an error collector
+// on every call. A parser is not thread-safe, so use one per thread.
+//
+// Example:
+//
+// ```c++
+// TextProtoParser parser({.allow_unknown_field = true});
+// for (std::string_view text : texts) {
+//   MyProto proto;
+//   if (absl::Status status = parser.Parse(text, proto); !status.ok()) {
+//     return status;
+//   }
+//   ...
+// }
+// ```
+class TextProtoParser final {
+ public:
+  TextProtoParser() : TextProtoParser(TextProtoParserOptions{}) {}
+
+  explicit TextProtoParser(const TextProtoParserOptions& options);
+
+  // The parser keeps a reference to the error collector, so it can neither be copied nor moved.
+  TextProtoParser(const TextProtoParser&) = delete;
+  TextProtoParser& operator=(const TextProtoParser&) = delete;
+  TextProtoParser(TextProtoParser&&) = delete;
+  TextProtoParser& operator=(TextProtoParser&&) = delete;
+
+  ~TextProtoParser() = default;
+
+  // Parses `text` into `result`. The text is read in place, it does not get copied.
+  absl::Status Parse(
+      std::string_view text,
+      ::google::protobuf::Message& result,
+      const std::source_location& src_loc = std::source_location::current());
+
+  // Parses `text` into `result` chunk by chunk, so the cord does not get flattened.
+  absl::Status Parse(
+      const absl::Cord& text,
+      ::google::protobuf::Message& result,
+      const std::source_location& src_loc = std::source_location::current());
+
+  // Parses the remaining content of `input` into `result`.
+  absl::Status Parse(
+      ::google::protobuf::io::ZeroCopyInputStream& input,
+      ::google::protobuf::Message& result,
+      const std::source_location& src_loc = std::source_location::current());
+
+  // Reads the text proto file `filename` into `result`. Files with a gzip extension (see
+  // `HasGzipExtension`) are decompressed while being parsed.
+  absl::Status ParseFile(
+      const std::filesystem::path& filename,
+      ::google::protobuf::Message& result,
+      const std::source_location& src_loc = std::source_location::current());
+
+  // Same as above but return a new `ProtoType`.
+  template<IsProtoType ProtoType>
+  absl::StatusOr<ProtoType> Parse(
+      std::string_view text,
+      const std::source_location& src_loc = std::source_location::current()) {
+    ProtoType result;
+    if (absl::Status status = Parse(text, result, src_loc); !status.ok()) {
+      return status;
+    }
+    return result;
+  }
+
+  template<IsProtoType ProtoType>
+  absl::StatusOr<ProtoType> Parse(
+      const absl::Cord& text,
+      const std::source_location& src_loc = std::source_location::current()) {
+    ProtoType result;
+    if (absl::Status status = Parse(text, result, src_loc); !status.ok()) {
+      return status;
+    }
+    return result;
+  }
+
+  template<IsProtoType ProtoType>
+  absl::StatusOr<ProtoType> ParseFile(
+      const std::filesystem::path& filename,
+      const std::source_location& src_loc = std::source_location::current()) {
+    ProtoType result;
+    if (absl::Status status = ParseFile(filename, result, src_loc); !status.ok()) {
+      return status;
+    }
+    return result;
+  }
+
+  // The errors and warnings of the most recent parse.
+  const SilentErrorCollector& errors() const { return error_collector_; }  // NOLINT(readability-identifier-naming)
+
+ private:
+  bool ParseStream(::google::protobuf::io::ZeroCopyInputStream& input, ::google::protobuf::Message& result);
+
+  SilentErrorCollector error_collector_;
+  ::google::protobuf::TextFormat::Parser parser_;
+};
+
+}  // namespace mbo::proto
+
+#endif  // MBO_PROTO_TEXT_PROTO_PARSER_H_
@@ -0,0 +1,143 @@
+// SPDX-FileCopyrightText: Copyright (c) The helly25/mbo authors (helly25.com)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mbo/proto/text_proto_parser.h"
+
+#include <string>
+
+#include "absl/status/status.h"
+#include "absl/strings/cord.h"
+#include "absl/strings/str_format.h"
+#include "gmock/gmock.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
+#include "gtest/gtest.h"
+#include "mbo/proto/file.h"
+#include "mbo/proto/matchers.h"
+#include "mbo/proto/parse_text_proto.h"
+#include "mbo/proto/status_matchers.h"
+#include "mbo/proto/tests/simple_message.pb.h"
+#include "mbo/proto/tests/test.pb.h"
+
+namespace mbo::proto {
+namespace {
+// NOLINTBEGIN(*-magic-numbers)
+
+using ::mbo::proto::EqualsProto;
+using ::mbo::proto::tests::SimpleMessage;
+using ::mbo::proto::tests::TestMessage2;
+using ::testing::_;
+using ::testing::HasSubstr;
+using ::testing::IsEmpty;
+using ::testing::Lt;
+using ::testing::SizeIs;
+
+struct TextProtoParserTest : ::testing::Test {};
+
+TEST_F(TextProtoParserTest, Reuse) {
+  TextProtoParser parser;
+  for (int i = 0; i < 3; ++i) {
+    SimpleMessage message;
+    ASSERT_THAT(parser.Parse(absl::StrFormat("one: %d", i), message), IsOk());
+    EXPECT_THAT(message, EqualsProto(absl::StrFormat("one: %d", i)));
+    EXPECT_THAT(parser.errors(), IsEmpty());
+    EXPECT_THAT(parser.Parse<SimpleMessage>("!!!"), StatusIs(absl::StatusCode::kInvalidArgument, _));
+    EXPECT_THAT(parser.errors(), SizeIs(1));  // Errors of previous parses are cleared.
+  }
+}
+
+TEST_F(TextProtoParserTest, Stream) {
+  TextProtoParser parser;
+  const std::string text = "one: 1 two: [2, 3]";
+  ::google::protobuf::io::ArrayInputStream input(text.data(), static_cast<int>(text.size()), 4);
+  SimpleMessage message;
+  ASSERT_THAT(parser.Parse(input, message), IsOk());
+  EXPECT_THAT(message, EqualsProto("one: 1 two: [2, 3]"));
+}
+
+TEST_F(TextProtoParserTest, Cord) {
+  TextProtoParser parser;
+  // External memory is not merged, so each part becomes a chunk. The boundaries split tokens.
+  absl::Cord text;
+  for (const char* part : {"on", "e: 4", "2 two: [1", ", 2]"}) {
+    text.Append(absl::MakeCordFromExternal(part, [] {}));
+  }
+  EXPECT_THAT(parser.Parse<SimpleMessage>(text), IsOkAndHolds(EqualsProto("one: 42 two: [1, 2]")));
+  EXPECT_THAT(
+      parser.Parse<SimpleMessage>(absl::Cord("one: !")),
+      StatusIs(absl::StatusCode::kInvalidArgument, HasSubstr("Cannot parse text proto @")));
+}
+
+TEST_F(TextProtoParserTest, File) {
+  TextProtoParser parser;
+  ASSERT_THAT(WriteTextProtoFile("test.txtpb.gz", ParseTextOrDie<SimpleMessage>("one: 42")), IsOk());
+  EXPECT_THAT(parser.ParseFile<SimpleMessage>("test.txtpb.gz"), IsOkAndHolds(EqualsProto("one: 42")));
+  EXPECT_THAT(
+      parser.ParseFile<SimpleMessage>("DoesNotExist.txtpb"),
+      StatusIs(absl::StatusCode::kNotFound, HasSubstr("Cannot open 'DoesNotExist.txtpb'")));
+  ASSERT_THAT(WriteTextProtoFile("test.txtpb", ParseTextOrDie<TestMessage2>("num: 1")), IsOk());
+  EXPECT_THAT(
+      parser.ParseFile<SimpleMessage>("test.txtpb"),
+      StatusIs(absl::StatusCode::kAborted, HasSubstr("Cannot parse text proto file 'test.txtpb' @")));
+}
+
+TEST_F(TextProtoParserTest, Options) {
+  {
+    TextProtoParser parser;
+    EXPECT_THAT(
+        parser.Parse<SimpleMessage>("one: 1 unknown: 2"),
+        StatusIs(absl::StatusCode::kInvalidArgument, HasSubstr("no field named \"unknown\"")));
+    EXPECT_THAT(parser.Parse<SimpleMessage>("1: 1"), StatusIs(absl::StatusCode::kInvalidArgument, _));
+  }
+  {
+    TextProtoParser parser({.allow_unknown_field = true});
+    EXPECT_THAT(parser.Parse<SimpleMessage>("one: 1 unknown: 2"), IsOkAndHolds(EqualsProto("one: 1")));
+    EXPECT_THAT(parser.errors(), SizeIs(1));  // The unknown field is reported as a warning.
+  }
+  {
+    TextProtoParser parser({.allow_field_number = true});
+    EXPECT_THAT(parser.Parse<SimpleMessage>("1: 7"), IsOkAndHolds(EqualsProto("one: 7")));
+  }
+  {
+    TextProtoParser parser({.recursion_limit = 0});
+    EXPECT_THAT(parser.Parse<TestMessage2>("num: 1"), IsOk());
+    EXPECT_THAT(parser.Parse<TestMessage2>("one { num: 1 }"), StatusIs(absl::StatusCode::kInvalidArgument, _));
+  }
+}
+
+TEST_F(TextProtoParserTest, MaxErrors) {
+  std::string text;
+  for (int i = 0; i < 100'000; ++i) {
+    absl::StrAppendFormat(&text, "unknown%d: %d ", i, i);
+  }
+  text += "one: 1";
+  {
+    TextProtoParser parser({.allow_unknown_field = true, .errors = {.max_stored_errors = 0}});
+    EXPECT_THAT(parser.Parse<SimpleMessage>(text), IsOkAndHolds(EqualsProto("one: 1")));
+    EXPECT_THAT(parser.errors(), SizeIs(100'000));
+  }
+  {
+    TextProtoParser parser({.allow_unknown_field = true, .errors = {.max_errors = 10}});
+    EXPECT_THAT(
+        parser.Parse<SimpleMessage>(text),
+        StatusIs(absl::StatusCode::kInvalidArgument, HasSubstr("Stopped after 10 errors")));
+    EXPECT_THAT(parser.errors(), SizeIs(10));
+    // Reading the input stopped within a block after the limit was reached.
+    EXPECT_THAT(parser.errors().total(), Lt(1'000));
+  }
+}
+
+// NOLINTEND(*-magic-numbers)
+}  // namespace
+}  // namespace mbo::proto
@@ -0,0 +1,354 @@
+// SPDX-FileCopyrightText: Copyright (c) The helly25/mbo authors (helly25.com)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mbo/proto/text_records_file.h"
+
+#include <fcntl.h>
+
+#include <cctype>
+#include <filesystem>
+#include <memory>
+#include <source_location>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "google/protobuf/io/gzip_stream.h"
+#include "google/protobuf/io/zero_copy_stream_impl.h"
+#include "google/protobuf/message.h"
+#include "mbo/proto/file.h"
+#include "mbo/proto/silent_error_collector.h"
+#include "mbo/proto/text_proto_parser.h"
+
+namespace mbo::proto {
+namespace {
+
+using ::mbo::proto::proto_internal::SrcLoc;
+
+// Same as `io::Tokenizer`, so that columns match those of regular text proto parse errors.
+constexpr int kTabWidth = 8;
+
+char ClosingDelimiter(char chr) {
+  switch (chr) {
+    case '{': return '}';
+    case '<': return '>';
+    case '[': return ']';
+    default: return '\0';
+  }
+}
+
+bool IsClosingDelimiter(char chr) {
+  return chr == '}' || chr == '>' || chr == ']';
+}
+
+bool IsIdentifierChar(char chr) {
+  return std::isalnum(static_cast<unsigned char>(chr)) != 0 || chr == '_';
+}
+
+}  // namespace
+
+namespace proto_internal {
+
+TextProtoRecordReader::TextProtoRecordReader(
+    std::filesystem::path filename,
+    std::string_view field_name,
+    const TextProtoParserOptions& options,
+    const std::source_location& src_loc)
+    : filename_(std::move(filename)), field_name_(field_name), src_loc_(src_loc), parser_(options) {
+  const int fd = ::open(filename_.c_str(), O_RDONLY | O_CLOEXEC);  // NOLINT(*-vararg)
+  if (fd < 0) {
+    status_ = absl::NotFoundError(absl::StrFormat("Cannot open '%s' @ %s", filename_, SrcLoc(src_loc_)));
+    return;
+  }
+  file_ = std::make_unique<::google::protobuf::io::FileInputStream>(fd);
+  file_->SetCloseOnDelete(true);
+  input_ = file_.get();
+  if (HasGzipExtension(filename_)) {
+    gzip_ = std::make_unique<::google::protobuf::io::GzipInputStream>(
+        file_.get(), ::google::protobuf::io::GzipInputStream::GZIP);
+    input_ = gzip_.get();
+  }
+}
+
+TextProtoRecordReader::~TextProtoRecordReader() = default;
+
+bool TextProtoRecordReader::Peek(char& chr) {
+  while (size_ <= 0) {
+    const void* data = nullptr;
+    if (!input_->Next(&data, &size_)) {
+      size_ = 0;
+      return false;
+    }
+    data_ = static_cast<const char*>(data);
+  }
+  chr = *data_;
+  return true;
+}
+
+char TextProtoRecordReader::Get() {
+  const char chr = *data_;
+  ++data_;  // NOLINT(*-pointer-arithmetic)
+  --size_;
+  if (chr == '\n') {
+    ++line_;
+    column_ = 0;
+  } else if (chr == '\t') {
+    column_ += kTabWidth - (column_ % kTabWidth);
+  } else {
+    ++column_;
+  }
+  return chr;
+}
+
+bool TextProtoRecordReader::Consume(char chr) {
+  char next = '\0';
+  if (Peek(next) && next == chr) {
+    Get();
+    return true;
+  }
+  return false;
+}
+
+void TextProtoRecordReader::SkipWhitespaceAndComments() {
+  char chr = '\0';
+  while (Peek(chr)) {
+    if (chr == '#') {
+      while (Peek(chr) && Get() != '\n') {
+      }
+    } else if (std::isspace(static_cast<unsigned char>(chr)) != 0) {
+      Get();
+    } else {
+      return;
+    }
+  }
+}
+
+std::string TextProtoRecordReader::ReadFieldName() {
+  std::string name;
+  char chr = '\0';
+  if (Consume('[')) {
+    name = "[";
+    while (Peek(chr) && chr != ']') {
+      name += Get();
+    }
+    return Consume(']') ? absl::StrCat(name, "]") : std::string();
+  }
+  while (Peek(chr) && IsIdentifierChar(chr)) {
+    name += Get();
+  }
+  return name;
+}
+
+bool TextProtoRecordReader::SkipString(std::string* out) {
+  const char quote = Get();
+  if (out != nullptr) {
+    *out += quote;
+  }
+  char chr = '\0';
+  while (Peek(chr) && chr != '\n') {
+    Get();
+    if (out != nullptr) {
+      *out += chr;
+    }
+    if (chr == quote) {
+      return true;
+    }
+    if (chr == '\\' && Peek(chr) && chr != '\n') {
+      Get();
+      if (out != nullptr) {
+        *out += chr;
+      }
+    }
+  }
+  return Fail("Unterminated string");
+}
+
+bool TextProtoRecordReader::SkipNested(std::string* out) {
+  std::string closers(1, ClosingDelimiter(Get()));
+  char chr = '\0';
+  while (Peek(chr)) {
+    if (chr == '"' || chr == '\'') {
+      if (!SkipString(out)) {
+        return false;
+      }
+      continue;
+    }
+    if (IsClosingDelimiter(chr)) {
+      if (chr != closers.back()) {
+        return Fail(absl::StrFormat("Expected '%c' but found '%c'", closers.back(), chr));
+      }
+      closers.pop_back();
+      if (closers.empty()) {
+        Get();
+        return true;
+      }
+    } else if (const char closer = ClosingDelimiter(chr); closer != '\0') {
+      closers += closer;
+    }
+    Get();
+    if (out != nullptr) {
+      *out += chr;
+    }
+    if (chr == '#') {
+      // Comments are kept, so that line numbers in `out` remain intact.
+      while (Peek(chr) && chr != '\n') {
+        Get();
+        if (out != nullptr) {
+          *out += chr;
+        }
+      }
+    }
+  }
+  return Fail("Unexpected end of file");
+}
+
+bool TextProtoRecordReader::SkipValue(bool has_colon) {
+  char chr = '\0';
+  if (!Peek(chr)) {
+    return Fail("Unexpected end of file");
+  }
+  if (chr == '{' || chr == '<' || (has_colon && chr == '[')) {
+    return SkipNested(nullptr);
+  }
+  if (!has_colon) {
+    return Fail("Expected ':', '{' or '<'");
+  }
+  if (chr == '"' || chr == '\'') {
+    // Adjacent strings get concatenated.
+    while (Peek(chr) && (chr == '"' || chr == '\'')) {
+      if (!SkipString(nullptr)) {
+        return false;
+      }
+      SkipWhitespaceAndComments();
+    }
+    return true;
+  }
+  if (Consume('-')) {
+    SkipWhitespaceAndComments();
+  }
+  bool found = false;
+  while (Peek(chr) && (IsIdentifierChar(chr) || chr == '.' || chr == '+' || chr == '-')) {
+    Get();
+    found = true;
+  }
+  return found || Fail("Expected value");
+}
+
+bool TextProtoRecordReader::ReadRecord(::google::protobuf::Message& message) {
+  char chr = '\0';
+  if (!Peek(chr) || (chr != '{' && chr != '<')) {
+    return Fail(absl::StrFormat("Expected '{' or '<' to start record #%d", index_));
+  }
+  // The position of the first character after the opening delimiter.
+  const int line = line_;
+  const int column = column_ + 1;
+  record_text_.clear();
+  if (!SkipNested(&record_text_)) {
+    return false;
+  }
+  if (parser_.Parse(record_text_, message, src_loc_).ok()) {
+    ++index_;
+    return true;
+  }
+  // Parse errors are relative to the record text, so they get moved to the record's position.
+  std::string errors;
+  std::string_view separator;
+  for (const SilentErrorCollector::ErrorInfo& error : parser_.errors()) {
+    absl::StrAppendFormat(
+        &errors, "%sLine %d, Col %d: %s", separator, line + error.line,
+        error.line == 0 ? column + error.column : error.column, error.message);
+    separator = ", ";
+  }
+  status_ = absl::AbortedError(absl::StrFormat(
+      "Cannot parse text proto record #%d from file '%s' @ %s: %s.", index_, filename_, SrcLoc(src_loc_), errors));
+  input_ = nullptr;
+  return false;
+}
+
+bool TextProtoRecordReader::Next(::google::protobuf::Message& message) {
+  if (!status_.ok() || input_ == nullptr) {
+    return false;
+  }
+  while (true) {
+    SkipWhitespaceAndComments();
+    if (in_list_) {
+      if (Consume(']')) {
+        in_list_ = false;
+        SkipWhitespaceAndComments();
+        Consume(';') || Consume(',');
+        continue;
+      }
+      if (list_started_ && !Consume(',')) {
+        return Fail("Expected ',' or ']'");
+      }
+      list_started_ = true;
+      SkipWhitespaceAndComments();
+      return ReadRecord(message);
+    }
+    char chr = '\0';
+    if (!Peek(chr)) {
+      break;
+    }
+    const std::string name = ReadFieldName();
+    if (name.empty()) {
+      return Fail("Expected field name");
+    }
+    SkipWhitespaceAndComments();
+    const bool has_colon = Consume(':');
+    SkipWhitespaceAndComments();
+    if (name == field_name_) {
+      if (has_colon && Consume('[')) {
+        in_list_ = true;
+        list_started_ = false;
+        continue;
+      }
+      if (!ReadRecord(message)) {
+        return false;
+      }
+      SkipWhitespaceAndComments();
+      Consume(';') || Consume(',');
+      return true;
+    }
+    if (!SkipValue(has_colon)) {
+      return false;
+    }
+    SkipWhitespaceAndComments();
+    Consume(';') || Consume(',');
+  }
+  // Corrupt or truncated compressed data ends the stream like a regular end of input.
+  if (gzip_ != nullptr && gzip_->ZlibErrorCode() < 0) {
+    status_ = absl::AbortedError(
+        absl::StrFormat("Cannot parse text proto file '%s' @%s: Corrupt gzip data.", filename_, SrcLoc(src_loc_)));
+  } else if (file_->GetErrno() != 0) {
+    status_ = absl::ErrnoToStatus(
+        file_->GetErrno(), absl::StrFormat("Cannot read text proto file '%s' @ %s", filename_, SrcLoc(src_loc_)));
+  }
+  input_ = nullptr;
+  return false;
+}
+
+bool TextProtoRecordReader::Fail(std::string_view error) {
+  status_ = absl::AbortedError(absl::StrFormat(
+      "Cannot parse text proto file '%s' @%s: Line %d, Col %d: %s.", filename_, SrcLoc(src_loc_), line_, column_,
+      error));
+  input_ = nullptr;
+  return false;
+}
+
+}  // namespace proto_internal
+}  // namespace mbo::proto
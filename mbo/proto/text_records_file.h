@@ -0,0 +1,243 @@
+// SPDX-FileCopyrightText: Copyright (c) The helly25/mbo authors (helly25.com)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MBO_PROTO_TEXT_RECORDS_FILE_H_
+#define MBO_PROTO_TEXT_RECORDS_FILE_H_
+
+#include <cstddef>
+#include <filesystem>
+#include <iterator>
+#include <memory>
+#include <source_location>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "absl/status/status.h"
+#include "google/protobuf/io/gzip_stream.h"
+#include "google/protobuf/io/zero_copy_stream.h"
+#include "google/protobuf/io/zero_copy_stream_impl.h"
+#include "google/protobuf/message.h"
+#include "mbo/proto/file.h"
+#include "mbo/proto/text_proto_parser.h"
+
+// Functionality for streaming the elements of a repeated top-level field from a text proto file:
+// - struct  ReadTextProtoFileRecordsOptions
+// - class   ReadTextProtoFileRecords
+//
+// A text proto file of a wrapper message like `message Dataset { repeated Record records = 1; }`
+// can be read one `Record` at a time, without ever holding the whole `Dataset` in memory.
+
+namespace mbo::proto {
+
+// Options for reading the elements of a repeated top-level field from a text proto file.
+struct ReadTextProtoFileRecordsOptions {
+  // Reuse a single message object for all records. The message gets cleared before each record is
+  // read, which keeps the allocated capacity of strings and repeated fields. Otherwise a new message
+  // is created for each record, so that records can be moved out of the iteration.
+  bool reuse_message = false;
+
+  // Options for parsing each record.
+  TextProtoParserOptions parser;
+};
+
+namespace proto_internal {
+
+// Type erased sequential reader for the elements of a repeated top-level field in a text proto file.
+//
+// The reader scans the top level of the file itself. Entries of other fields get skipped without
+// being validated, entries of the requested field are buffered one at a time and parsed with a
+// `TextProtoParser`. Both `field { ... }` and `field: [{ ... }, ...]` forms are supported.
+class TextProtoRecordReader final {
+ public:
+  TextProtoRecordReader(
+      std::filesystem::path filename,
+      std::string_view field_name,
+      const TextProtoParserOptions& options,
+      const std::source_location& src_loc);
+
+  TextProtoRecordReader(const TextProtoRecordReader&) = delete;
+  TextProtoRecordReader& operator=(const TextProtoRecordReader&) = delete;
+  TextProtoRecordReader(TextProtoRecordReader&&) = delete;
+  TextProtoRecordReader& operator=(TextProtoRecordReader&&) = delete;
+
+  ~TextProtoRecordReader();
+
+  // Reads the next record into `message` which must be empty. Returns false at the end of the
+  // file or if an error occurred, in which case `status` will be set.
+  bool Next(::google::protobuf::Message& message);
+
+  // The status of the reader. Any error is final.
+  const absl::Status& status() const { return status_; }
+
+ private:
+  // Returns whether a character is available and sets `chr` to it without consuming it.
+  bool Peek(char& chr);
+
+  // Consumes the current character, which must be available, and advances line and column.
+  char Get();
+
+  // Consumes `chr` if it is the current character.
+  bool Consume(char chr);
+
+  void SkipWhitespaceAndComments();
+
+  // Consumes a field name, which is either an identifier or an extension or `Any` type in brackets.
+  std::string ReadFieldName();
+
+  // Consumes the value of a field that is not the requested one.
+  bool SkipValue(bool has_colon);
+
+  // Consumes a quoted string including its quotes.
+  bool SkipString(std::string* out);
+
+  // Consumes a message in `{}` or `<>` or a list in `[]`, appending its content without the outer
+  // delimiters to `out` if set.
+  bool SkipNested(std::string* out);
+
+  // Consumes the message of the next record and parses it into `message`.
+  bool ReadRecord(::google::protobuf::Message& message);
+
+  bool Fail(std::string_view error);
+
+  const std::filesystem::path filename_;
+  const std::string field_name_;
+  const std::source_location src_loc_;
+  TextProtoParser parser_;
+  std::unique_ptr<::google::protobuf::io::FileInputStream> file_;
+  std::unique_ptr<::google::protobuf::io::GzipInputStream> gzip_;
+  ::google::protobuf::io::ZeroCopyInputStream* input_ = nullptr;
+  const char* data_ = nullptr;
+  int size_ = 0;
+  int line_ = 0;
+  int column_ = 0;
+  bool in_list_ = false;
+  bool list_started_ = false;
+  std::string record_text_;
+  absl::Status status_;
+  std::size_t index_ = 0;
+};
+
+}  // namespace proto_internal
+
+// Input range over the elements of the repeated top-level field `field_name` in a text proto file.
+//
+// Records are read lazily while iterating, so memory is bounded by a single
+// record. The iteration stops at the end of the file or at the first error.
+// Once iteration finished, `status` tells whether the whole file was read.
+// Errors carry the line and column within the file. Files with a gzip extension
+// (see `HasGzipExtension`) are decompressed while being read.
+//
+// Example:
+//
+// ```c++
+// ReadTextProtoFileRecords<Record> records("dataset.txtpb", "records");
+// for (const Record& record : records) {
+//   Process(record);
+// }
+// if (!records.status().ok()) {
+//   return records.status();
+// }
+// ```
+template<IsProtoType ProtoType>
+class ReadTextProtoFileRecords final {
+ public:
+  class iterator final {  // NOLINT(readability-identifier-naming)
+   public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = ProtoType;
+    using difference_type = std::ptrdiff_t;
+    using pointer = ProtoType*;
+    using reference = ProtoType&;
+
+    iterator() = default;
+
+    reference operator*() const { return file_->message_; }
+
+    pointer operator->() const { return &file_->message_; }
+
+    iterator& operator++() {
+      if (!file_->Advance()) {
+        file_ = nullptr;
+      }
+      return *this;
+    }
+
+    void operator++(int) { ++*this; }
+
+    friend bool operator==(const iterator& it, std::default_sentinel_t /*unused*/) { return it.file_ == nullptr; }
+
+   private:
+    friend class ReadTextProtoFileRecords;
+
+    explicit iterator(ReadTextProtoFileRecords* file) : file_(file) {}
+
+    ReadTextProtoFileRecords* file_ = nullptr;
+  };
+
+  ReadTextProtoFileRecords(
+      std::filesystem::path filename,
+      std::string_view field_name,
+      const std::source_location& src_loc = std::source_location::current())
+      : ReadTextProtoFileRecords(std::move(filename), field_name, ReadTextProtoFileRecordsOptions{}, src_loc) {}
+
+  ReadTextProtoFileRecords(
+      std::filesystem::path filename,
+      std::string_view field_name,
+      const ReadTextProtoFileRecordsOptions& options,
+      const std::source_location& src_loc = std::source_location::current())
+      : reuse_message_(options.reuse_message), reader_(std::move(filename), field_name, options.parser, src_loc) {}
+
+  ReadTextProtoFileRecords(const ReadTextProtoFileRecords&) = delete;
+  ReadTextProtoFileRecords& operator=(const ReadTextProtoFileRecords&) = delete;
+  ReadTextProtoFileRecords(ReadTextProtoFileRecords&&) = delete;
+  ReadTextProtoFileRecords& operator=(ReadTextProtoFileRecords&&) = delete;
+
+  ~ReadTextProtoFileRecords() = default;
+
+  // Starts the iteration by reading the first record. This is an input range,
+  // so it can only be iterated once.
+  iterator begin() {  // NOLINT(readability-identifier-naming)
+    if (started_) {
+      return iterator();
+    }
+    started_ = true;
+    return Advance() ? iterator(this) : iterator();
+  }
+
+  std::default_sentinel_t end() const { return {}; }  // NOLINT(readability-identifier-naming)
+
+  // The error, if any, that stopped the iteration.
+  const absl::Status& status() const { return reader_.status(); }  // NOLINT(readability-identifier-naming)
+
+ private:
+  bool Advance() {
+    if (reuse_message_) {
+      message_.Clear();
+    } else {
+      message_ = ProtoType();
+    }
+    return reader_.Next(message_);
+  }
+
+  const bool reuse_message_;
+  proto_internal::TextProtoRecordReader reader_;
+  ProtoType message_;
+  bool started_ = false;
+};
+
+}  // namespace mbo::proto
+
+#endif  // MBO_PROTO_TEXT_RECORDS_FILE_H_
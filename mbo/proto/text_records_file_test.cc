@@ -0,0 +1,170 @@
+// SPDX-FileCopyrightText: Copyright (c) The helly25/mbo authors (helly25.com)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mbo/proto/text_records_file.h"
+
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "mbo/proto/file.h"
+#include "mbo/proto/matchers.h"
+#include "mbo/proto/status_matchers.h"
+#include "mbo/proto/tests/test.pb.h"
+
+namespace mbo::proto {
+namespace {
+// NOLINTBEGIN(*-magic-numbers)
+
+using ::mbo::proto::EqualsProto;
+using ::mbo::proto::tests::TestMessage;
+using ::mbo::proto::tests::TestMessage2;
+using ::testing::AllOf;
+using ::testing::ElementsAre;
+using ::testing::HasSubstr;
+using ::testing::IsEmpty;
+
+struct TextRecordsFileTest : ::testing::Test {
+  static void WriteFile(const std::string& filename, std::string_view content) {
+    std::ofstream output(filename);
+    output << content;
+  }
+
+  static std::vector<TestMessage> ReadAll(ReadTextProtoFileRecords<TestMessage>& records) {
+    std::vector<TestMessage> result;
+    for (TestMessage& record : records) {
+      result.push_back(std::move(record));
+    }
+    return result;
+  }
+};
+
+TEST_F(TextRecordsFileTest, Read) {
+  static constexpr std::string_view kText = R"pb(
+    # Other fields get skipped.
+    num: 1
+    one { name: "} not the end" }
+    more { name: "a" num: 1 }  # A comment with a }.
+    num: [ 2, -3 ];
+    more: < name: "b\"}" >,
+    [ext.name]: 1.5e+3
+    more: [ { name: "c" }, { num: 3 } ]
+    more {
+      # Nested comment {
+      name: 'd'
+      val: -inf
+    }
+  )pb";
+  WriteFile("test.txtpb", kText);
+  ReadTextProtoFileRecords<TestMessage> records("test.txtpb", "more");
+  const std::vector<TestMessage> result = ReadAll(records);
+  EXPECT_THAT(records.status(), IsOk());
+  EXPECT_THAT(
+      result,
+      ElementsAre(
+          EqualsProto(R"pb(name: "a" num: 1)pb"), EqualsProto(R"pb(name: "b\"}")pb"), EqualsProto(R"pb(name: "c")pb"),
+          EqualsProto(R"pb(num: 3)pb"), EqualsProto(R"pb(name: "d" val: -inf)pb")));
+}
+
+TEST_F(TextRecordsFileTest, ReuseMessage) {
+  WriteFile("test.txtpb", "more { name: 'a' } more { num: 2 }");
+  ReadTextProtoFileRecords<TestMessage> records("test.txtpb", "more", {.reuse_message = true});
+  std::vector<std::string> seen;
+  const TestMessage* first = nullptr;
+  for (const TestMessage& record : records) {
+    seen.push_back(record.ShortDebugString());
+    if (first == nullptr) {
+      first = &record;
+    }
+    EXPECT_THAT(&record, first);
+  }
+  EXPECT_THAT(records.status(), IsOk());
+  EXPECT_THAT(seen, ElementsAre(R"(name: "a")", "num: 2"));
+}
+
+TEST_F(TextRecordsFileTest, Gzip) {
+  TestMessage2 dataset;
+  for (int i = 0; i < 1'000; ++i) {
+    dataset.add_more()->set_num(i);
+  }
+  ASSERT_THAT(WriteTextProtoFile("test.txtpb.gz", dataset), IsOk());
+  ReadTextProtoFileRecords<TestMessage> records("test.txtpb.gz", "more");
+  int count = 0;
+  for (const TestMessage& record : records) {
+    EXPECT_THAT(record.num(), count);
+    ++count;
+  }
+  EXPECT_THAT(records.status(), IsOk());
+  EXPECT_THAT(count, 1'000);
+}
+
+TEST_F(TextRecordsFileTest, Empty) {
+  WriteFile("empty.txtpb", "# Nothing\nnum: 1\n");
+  ReadTextProtoFileRecords<TestMessage> records("empty.txtpb", "more");
+  EXPECT_THAT(ReadAll(records), IsEmpty());
+  EXPECT_THAT(records.status(), IsOk());
+}
+
+TEST_F(TextRecordsFileTest, Errors) {
+  {
+    ReadTextProtoFileRecords<TestMessage> records("DoesNotExist.txtpb", "more");
+    EXPECT_THAT(ReadAll(records), IsEmpty());
+    EXPECT_THAT(records.status(), StatusIs(absl::StatusCode::kNotFound, HasSubstr("Cannot open 'DoesNotExist.txtpb'")));
+  }
+  {
+    WriteFile("test.txtpb", "more { num: 1 }\nmore {\n  num: 2\n  bad: 3\n}\nmore { num: 4 }");
+    ReadTextProtoFileRecords<TestMessage> records("test.txtpb", "more");
+    EXPECT_THAT(ReadAll(records), ElementsAre(EqualsProto("num: 1")));
+    EXPECT_THAT(
+        records.status(),
+        StatusIs(
+            absl::StatusCode::kAborted,
+            AllOf(
+                HasSubstr("Cannot parse text proto record #1 from file 'test.txtpb'"),
+                HasSubstr("Line 3, Col 5: Message type \"mbo.proto.tests.TestMessage\" has no field named \"bad\""))));
+    // Same position as when parsing the whole file.
+    EXPECT_THAT(
+        ReadTextProtoFile::As<TestMessage2>("test.txtpb"),
+        StatusIs(absl::StatusCode::kAborted, HasSubstr("Line 3, Col 5: Message type")));
+  }
+  {
+    WriteFile("test.txtpb", "more { num: 1 }  more { num: 2 } more { num: 'x");
+    ReadTextProtoFileRecords<TestMessage> records("test.txtpb", "more");
+    EXPECT_THAT(ReadAll(records), ElementsAre(EqualsProto("num: 1"), EqualsProto("num: 2")));
+    EXPECT_THAT(
+        records.status(), StatusIs(absl::StatusCode::kAborted, HasSubstr("Line 0, Col 47: Unterminated string")));
+  }
+  {
+    WriteFile("test.txtpb", "more { num: 1 ]");
+    ReadTextProtoFileRecords<TestMessage> records("test.txtpb", "more");
+    EXPECT_THAT(ReadAll(records), IsEmpty());
+    EXPECT_THAT(records.status(), StatusIs(absl::StatusCode::kAborted, HasSubstr("Expected '}' but found ']'")));
+  }
+  {
+    WriteFile("test.txtpb", "more: 1");
+    ReadTextProtoFileRecords<TestMessage> records("test.txtpb", "more");
+    EXPECT_THAT(ReadAll(records), IsEmpty());
+    EXPECT_THAT(records.status(), StatusIs(absl::StatusCode::kAborted, HasSubstr("Expected '{' or '<'")));
+  }
+}
+
+// NOLINTEND(*-magic-numbers)
+}  // namespace
+}  // namespace mbo::proto
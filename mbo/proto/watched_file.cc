@@ -0,0 +1,185 @@
+// SPDX-FileCopyrightText: Copyright (c) The helly25/mbo authors (helly25.com)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mbo/proto/watched_file.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#endif  // defined(__linux__)
+
+#include <cerrno>
+#include <cstdint>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <source_location>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_format.h"
+#include "mbo/proto/file.h"
+
+namespace mbo::proto::proto_internal {
+namespace {
+
+#if defined(__linux__)
+// Drains all pending events from `fd` and returns whether any of them concerns `name`.
+bool ReadInotifyEvents(int fd, const std::string& name) {
+  bool changed = false;
+  alignas(struct inotify_event) char buffer[4096];  // NOLINT(*-avoid-c-arrays,*-magic-numbers)
+  while (true) {
+    const ssize_t size = ::read(fd, buffer, sizeof(buffer));
+    if (size <= 0) {
+      return changed;  // EAGAIN: all events were read.
+    }
+    for (ssize_t pos = 0; pos < size;) {
+      const auto* event = reinterpret_cast<const struct inotify_event*>(&buffer[pos]);  // NOLINT(*-reinterpret-cast)
+      if ((event->mask & IN_Q_OVERFLOW) != 0 || (event->len > 0 && name == event->name)) {
+        changed = true;
+      }
+      pos += static_cast<ssize_t>(sizeof(struct inotify_event) + event->len);
+    }
+  }
+}
+#endif  // defined(__linux__)
+
+}  // namespace
+
+struct ProtoFileWatcher::FileStamp {
+  bool operator==(const FileStamp&) const = default;
+
+  std::int64_t mtime = 0;  // Nanoseconds since the epoch.
+  std::uintmax_t size = 0;
+  std::uintmax_t inode = 0;
+  bool exists = false;
+};
+
+ProtoFileWatcher::FileStamp ProtoFileWatcher::GetFileStamp(const std::filesystem::path& filename) {
+  struct stat info{};
+  if (::stat(filename.c_str(), &info) != 0) {
+    return {};
+  }
+  return {
+      .mtime = ModificationTimeNanos(info),
+      .size = static_cast<std::uintmax_t>(info.st_size),
+      .inode = static_cast<std::uintmax_t>(info.st_ino),
+      .exists = true,
+  };
+}
+
+absl::StatusOr<std::unique_ptr<ProtoFileWatcher>> ProtoFileWatcher::Create(
+    std::filesystem::path filename,
+    std::chrono::milliseconds poll_interval,
+    std::function<void()> on_change,
+    const std::source_location& src_loc) {
+  int watch_fd = -1;
+#if defined(__linux__)
+  // Watching the directory rather than the file keeps working when the file gets replaced.
+  const std::filesystem::path parent = filename.has_parent_path() ? filename.parent_path() : ".";
+  watch_fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (watch_fd < 0 || ::inotify_add_watch(watch_fd, parent.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+    const int error = errno;
+    if (watch_fd >= 0) {
+      ::close(watch_fd);
+    }
+    return absl::ErrnoToStatus(
+        error, absl::StrFormat("Cannot watch directory '%s' for file '%s' @ %s", parent, filename, SrcLoc(src_loc)));
+  }
+#endif  // defined(__linux__)
+  int stop_fds[2] = {-1, -1};  // NOLINT(*-avoid-c-arrays)
+  if (::pipe(stop_fds) != 0) {
+    const int error = errno;
+    if (watch_fd >= 0) {
+      ::close(watch_fd);
+    }
+    return absl::ErrnoToStatus(
+        error, absl::StrFormat("Cannot create watcher for file '%s' @ %s", filename, SrcLoc(src_loc)));
+  }
+  for (const int fd : stop_fds) {
+    ::fcntl(fd, F_SETFD, FD_CLOEXEC);  // NOLINT(*-vararg)
+  }
+  return std::unique_ptr<ProtoFileWatcher>(new ProtoFileWatcher(
+      std::move(filename), poll_interval, std::move(on_change), watch_fd, stop_fds[0], stop_fds[1]));
+}
+
+ProtoFileWatcher::ProtoFileWatcher(
+    std::filesystem::path filename,
+    std::chrono::milliseconds poll_interval,
+    std::function<void()> on_change,
+    int watch_fd,
+    int stop_read_fd,
+    int stop_write_fd)
+    : filename_(std::move(filename)),
+      poll_interval_(poll_interval),
+      on_change_(std::move(on_change)),
+      watch_fd_(watch_fd),
+      stop_read_fd_(stop_read_fd),
+      stop_write_fd_(stop_write_fd),
+      thread_([this, stamp = GetFileStamp(filename_)] { Run(stamp); }) {}
+
+ProtoFileWatcher::~ProtoFileWatcher() {
+  // Closing the write end wakes up the watcher thread.
+  ::close(stop_write_fd_);
+  thread_.join();
+  ::close(stop_read_fd_);
+  if (watch_fd_ >= 0) {
+    ::close(watch_fd_);
+  }
+}
+
+void ProtoFileWatcher::Run(FileStamp stamp) {
+  [[maybe_unused]] const std::string name = filename_.filename();
+  while (true) {
+    struct pollfd fds[2] = {  // NOLINT(*-avoid-c-arrays)
+        {.fd = stop_read_fd_, .events = POLLIN, .revents = 0},
+        {.fd = watch_fd_, .events = POLLIN, .revents = 0},
+    };
+    const bool polling = watch_fd_ < 0;
+    const int ready = ::poll(fds, polling ? 1 : 2, polling ? static_cast<int>(poll_interval_.count()) : -1);
+    if (ready < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return;
+    }
+    if (fds[0].revents != 0) {
+      return;
+    }
+#if defined(__linux__)
+    if (!polling) {
+      if ((fds[1].revents & POLLIN) != 0 && ReadInotifyEvents(watch_fd_, name)) {
+        on_change_();
+      }
+      continue;
+    }
+#endif  // defined(__linux__)
+    FileStamp current = GetFileStamp(filename_);
+    if (current != stamp) {
+      stamp = current;
+      on_change_();
+    }
+  }
+}
+
+}  // namespace mbo::proto::proto_internal
@@ -0,0 +1,246 @@
+// SPDX-FileCopyrightText: Copyright (c) The helly25/mbo authors (helly25.com)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MBO_PROTO_WATCHED_FILE_H_
+#define MBO_PROTO_WATCHED_FILE_H_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <source_location>
+#include <thread>
+#include <utility>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
+#include "mbo/proto/file.h"
+#include "mbo/proto/silent_error_collector.h"
+
+// Functionality for text proto files that get reloaded when they change:
+// - struct  WatchedProtoFileOptions
+// - class   WatchedProtoFile
+
+namespace mbo::proto {
+
+// Options for `WatchedProtoFile`.
+struct WatchedProtoFileOptions {
+  // Called from the watcher thread if reading the changed file failed. The `errors` hold the parse
+  // errors, if any. The previous snapshot remains in use.
+  std::function<void(const absl::Status& status, const SilentErrorCollector& errors)> on_error;
+
+  // Called from the watcher thread after a new snapshot was published.
+  std::function<void()> on_reload;
+
+  // On platforms without inotify the file gets polled (`stat`) in this interval.
+  std::chrono::milliseconds poll_interval{1000};  // NOLINT(*-magic-numbers)
+};
+
+namespace proto_internal {
+
+// Watches a single file from a background thread and calls `on_change` whenever the file may have
+// changed. On Linux this uses inotify on the parent directory, so that files which get replaced
+// by a rename are tracked as well. Elsewhere the file gets polled.
+class ProtoFileWatcher final {
+ public:
+  static absl::StatusOr<std::unique_ptr<ProtoFileWatcher>> Create(
+      std::filesystem::path filename,
+      std::chrono::milliseconds poll_interval,
+      std::function<void()> on_change,
+      const std::source_location& src_loc);
+
+  ProtoFileWatcher(const ProtoFileWatcher&) = delete;
+  ProtoFileWatcher& operator=(const ProtoFileWatcher&) = delete;
+  ProtoFileWatcher(ProtoFileWatcher&&) = delete;
+  ProtoFileWatcher& operator=(ProtoFileWatcher&&) = delete;
+
+  // Stops and joins the background thread. No `on_change` call is in progress once this returns.
+  ~ProtoFileWatcher();
+
+ private:
+  ProtoFileWatcher(
+      std::filesystem::path filename,
+      std::chrono::milliseconds poll_interval,
+      std::function<void()> on_change,
+      int watch_fd,
+      int stop_read_fd,
+      int stop_write_fd);
+
+  // Identifies a version of the file for polling.
+  struct FileStamp;
+
+  static FileStamp GetFileStamp(const std::filesystem::path& filename);
+
+  // The `stamp` is taken on the creating thread, so that no change after construction gets lost.
+  void Run(FileStamp stamp);
+
+  const std::filesystem::path filename_;
+  const std::chrono::milliseconds poll_interval_;
+  const std::function<void()> on_change_;
+  const int watch_fd_;  // The inotify descriptor or -1 if polling.
+  const int stop_read_fd_;
+  const int stop_write_fd_;
+  std::thread thread_;
+};
+
+// Holds a `std::shared_ptr` that can be loaded concurrently with a store without taking a lock.
+//
+// `std::atomic<std::shared_ptr>` is not lock-free in common standard libraries, so the value lives
+// in one of two slots instead. A reader announces itself on the current slot and retries if a store
+// switched slots in the meantime. A store fills the other slot, switches to it, and then waits for
+// the remaining readers of the previous slot before releasing its value. Stores must not be called
+// concurrently with each other.
+template<typename T>
+class AtomicSharedPtr final {
+ public:
+  std::shared_ptr<T> load() const {  // NOLINT(readability-identifier-naming)
+    while (true) {
+      const std::size_t index = current_.load();
+      Slot& slot = slots_[index];
+      slot.readers.fetch_add(1);
+      if (current_.load() == index) {
+        std::shared_ptr<T> result = slot.ptr;
+        slot.readers.fetch_sub(1);
+        return result;
+      }
+      slot.readers.fetch_sub(1);
+    }
+  }
+
+  void store(std::shared_ptr<T> ptr) {  // NOLINT(readability-identifier-naming)
+    const std::size_t previous = current_.load();
+    Slot& next = slots_[1 - previous];
+    WaitForReaders(next);
+    next.ptr = std::move(ptr);
+    current_.store(1 - previous);
+    Slot& old = slots_[previous];
+    WaitForReaders(old);
+    old.ptr.reset();
+  }
+
+ private:
+  struct Slot {
+    std::atomic<int> readers{0};
+    std::shared_ptr<T> ptr;
+  };
+
+  static void WaitForReaders(const Slot& slot) {
+    while (slot.readers.load() != 0) {
+      std::this_thread::yield();
+    }
+  }
+
+  mutable std::array<Slot, 2> slots_;
+  std::atomic<std::size_t> current_{0};
+};
+
+}  // namespace proto_internal
+
+// A text proto file that gets reloaded in the background whenever it changes.
+//
+// Readers call `Get` which returns the latest successfully parsed snapshot. `Get` never blocks on
+// a reload, so it can be used on hot paths. If a changed file cannot be read or parsed, then the
+// previous snapshot remains in use and `WatchedProtoFileOptions::on_error` gets called.
+//
+// Example:
+//
+// ```c++
+// absl::StatusOr<std::unique_ptr<WatchedProtoFile<MyConfig>>> config = WatchedProtoFile<MyConfig>::Create(
+//     "config.txtpb", {.on_error = [](const absl::Status& status, const SilentErrorCollector&) {
+//       ABSL_LOG(ERROR) << status;
+//     }});
+// ...
+// const std::shared_ptr<const MyConfig> snapshot = (*config)->Get();
+// ```
+template<IsProtoType ProtoType>
+class WatchedProtoFile final {
+ public:
+  // Reads `filename` and starts watching it. Fails if the initial read fails.
+  static absl::StatusOr<std::unique_ptr<WatchedProtoFile>> Create(
+      std::filesystem::path filename,
+      WatchedProtoFileOptions options = {},
+      const std::source_location& src_loc = std::source_location::current()) {
+    std::unique_ptr<WatchedProtoFile> file(new WatchedProtoFile(std::move(filename), std::move(options), src_loc));
+    // Watch first, so that no change after the initial read gets lost.
+    absl::StatusOr<std::unique_ptr<proto_internal::ProtoFileWatcher>> watcher =
+        proto_internal::ProtoFileWatcher::Create(
+            file->filename_, file->options_.poll_interval, [file = file.get()] { file->OnChange(); }, src_loc);
+    if (!watcher.ok()) {
+      return watcher.status();
+    }
+    SilentErrorCollector errors;
+    if (absl::Status status = file->Reload(errors); !status.ok()) {
+      return status;
+    }
+    file->watcher_ = *std::move(watcher);
+    return file;
+  }
+
+  WatchedProtoFile(const WatchedProtoFile&) = delete;
+  WatchedProtoFile& operator=(const WatchedProtoFile&) = delete;
+  WatchedProtoFile(WatchedProtoFile&&) = delete;
+  WatchedProtoFile& operator=(WatchedProtoFile&&) = delete;
+
+  ~WatchedProtoFile() = default;
+
+  // Returns the latest snapshot. This never takes a lock, see `proto_internal::AtomicSharedPtr`.
+  std::shared_ptr<const ProtoType> Get() const { return snapshot_.load(); }
+
+  const std::filesystem::path& filename() const { return filename_; }  // NOLINT(readability-identifier-naming)
+
+ private:
+  WatchedProtoFile(std::filesystem::path filename, WatchedProtoFileOptions options, const std::source_location& src_loc)
+      : filename_(std::move(filename)), options_(std::move(options)), src_loc_(src_loc) {}
+
+  absl::Status Reload(SilentErrorCollector& errors) {
+    // Serializes the initial read with the watcher thread, so an older snapshot never replaces a
+    // newer one.
+    const absl::MutexLock lock(&reload_mutex_);
+    auto proto = std::make_shared<ProtoType>();
+    absl::Status status = proto_internal::ReadTextProtoFile(filename_, *proto, errors, src_loc_);
+    if (status.ok()) {
+      snapshot_.store(std::move(proto));
+    }
+    return status;
+  }
+
+  void OnChange() {
+    SilentErrorCollector errors;
+    if (absl::Status status = Reload(errors); !status.ok()) {
+      if (options_.on_error) {
+        options_.on_error(status, errors);
+      }
+    } else if (options_.on_reload) {
+      options_.on_reload();
+    }
+  }
+
+  const std::filesystem::path filename_;
+  const WatchedProtoFileOptions options_;
+  const std::source_location src_loc_;
+  absl::Mutex reload_mutex_;
+  proto_internal::AtomicSharedPtr<const ProtoType> snapshot_;
+  // Must be last, so the watcher thread is stopped before any other member is destroyed.
+  std::unique_ptr<proto_internal::ProtoFileWatcher> watcher_;
+};
+
+}  // namespace mbo::proto
+
+#endif  // MBO_PROTO_WATCHED_FILE_H_
@@ -0,0 +1,192 @@
+// SPDX-FileCopyrightText: Copyright (c) The helly25/mbo authors (helly25.com)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mbo/proto/watched_file.h"
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <ios>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "mbo/proto/file.h"
+#include "mbo/proto/matchers.h"
+#include "mbo/proto/silent_error_collector.h"
+#include "mbo/proto/status_matchers.h"
+#include "mbo/proto/tests/simple_message.pb.h"
+
+namespace mbo::proto {
+namespace {
+// NOLINTBEGIN(*-magic-numbers)
+
+using ::mbo::proto::EqualsProto;
+using ::mbo::proto::tests::SimpleMessage;
+using ::testing::HasSubstr;
+using ::testing::Pointee;
+
+struct WatchedFileTest : ::testing::Test {
+  WatchedFileTest() {
+    std::filesystem::remove_all(kDir);
+    std::filesystem::create_directory(kDir);
+  }
+
+  ~WatchedFileTest() override { std::filesystem::remove_all(kDir); }
+
+  [[nodiscard]] static bool WriteFile(const std::filesystem::path& filename, std::string_view data) {
+    std::ofstream output(filename, std::ios::binary);
+    if (output.good()) {
+      output << data;
+      output.close();
+    }
+    return output.good();
+  }
+
+  // Waits up to 10 seconds for `predicate` to become true.
+  template<typename Predicate>
+  static bool WaitUntil(Predicate&& predicate) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (!predicate()) {
+      if (std::chrono::steady_clock::now() > deadline) {
+        return false;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    return true;
+  }
+
+  WatchedProtoFileOptions Options() {
+    return {
+        .on_error =
+            [this](const absl::Status& status, const SilentErrorCollector& errors) {
+              const absl::MutexLock lock(&mutex);
+              last_error = status;
+              last_parse_errors = errors.GetErrors(", ");
+              ++num_errors;
+            },
+        .on_reload = [this] { ++num_reloads; },
+        .poll_interval = std::chrono::milliseconds(10),
+    };
+  }
+
+  static constexpr std::string_view kDir = "watched";
+  const std::filesystem::path filename = std::filesystem::path(kDir) / "config.txtpb";
+
+  std::atomic<int> num_reloads{0};
+  std::atomic<int> num_errors{0};
+  absl::Mutex mutex;
+  absl::Status last_error ABSL_GUARDED_BY(mutex);
+  std::string last_parse_errors ABSL_GUARDED_BY(mutex);
+};
+
+TEST(AtomicSharedPtrTest, ConcurrentLoadAndStore) {
+  proto_internal::AtomicSharedPtr<const int> ptr;
+  EXPECT_THAT(ptr.load(), nullptr);
+  ptr.store(std::make_shared<const int>(0));
+  std::atomic<bool> done{false};
+  std::vector<std::thread> readers;
+  for (int i = 0; i < 4; ++i) {
+    readers.emplace_back([&] {
+      int last = 0;
+      while (!done) {
+        const std::shared_ptr<const int> value = ptr.load();
+        ASSERT_NE(value, nullptr);
+        EXPECT_GE(*value, last);
+        last = *value;
+      }
+    });
+  }
+  for (int i = 1; i <= 10'000; ++i) {
+    ptr.store(std::make_shared<const int>(i));
+  }
+  done = true;
+  for (std::thread& reader : readers) {
+    reader.join();
+  }
+  EXPECT_THAT(ptr.load(), Pointee(10'000));
+}
+
+TEST_F(WatchedFileTest, Reload) {
+  ASSERT_TRUE(WriteFile(filename, "one: 1"));
+  const absl::StatusOr<std::unique_ptr<WatchedProtoFile<SimpleMessage>>> file =
+      WatchedProtoFile<SimpleMessage>::Create(filename, Options());
+  ASSERT_THAT(file, IsOk());
+  const std::shared_ptr<const SimpleMessage> first = (*file)->Get();
+  EXPECT_THAT(first, Pointee(EqualsProto("one: 1")));
+  // Files that get replaced atomically.
+  SimpleMessage message;
+  message.set_one(2);
+  ASSERT_THAT(WriteTextProtoFile(filename, message, {.atomic = true}), IsOk());
+  EXPECT_TRUE(WaitUntil([&] { return (*file)->Get()->one() == 2; }));
+  EXPECT_THAT(first, Pointee(EqualsProto("one: 1")));  // Old snapshots stay valid.
+  // Files that get rewritten in place.
+  ASSERT_TRUE(WriteFile(filename, "one: 333"));  // Size differs in case polling sees the same mtime.
+  EXPECT_TRUE(WaitUntil([&] { return (*file)->Get()->one() == 333; }));
+  EXPECT_THAT(num_reloads.load(), ::testing::Ge(2));
+  EXPECT_THAT(num_errors.load(), 0);
+}
+
+TEST_F(WatchedFileTest, ParseErrorKeepsSnapshot) {
+  ASSERT_TRUE(WriteFile(filename, "one: 1"));
+  const absl::StatusOr<std::unique_ptr<WatchedProtoFile<SimpleMessage>>> file =
+      WatchedProtoFile<SimpleMessage>::Create(filename, Options());
+  ASSERT_THAT(file, IsOk());
+  ASSERT_TRUE(WriteFile(filename, "one: xx"));
+  EXPECT_TRUE(WaitUntil([&] { return num_errors.load() > 0; }));
+  EXPECT_THAT((*file)->Get(), Pointee(EqualsProto("one: 1")));
+  {
+    const absl::MutexLock lock(&mutex);
+    EXPECT_THAT(last_error, StatusIs(absl::StatusCode::kAborted, HasSubstr("Cannot parse text proto file")));
+    EXPECT_THAT(last_parse_errors, HasSubstr("Expected integer"));
+  }
+  // Recovers with the next good version.
+  ASSERT_TRUE(WriteFile(filename, "one: 222"));
+  EXPECT_TRUE(WaitUntil([&] { return (*file)->Get()->one() == 222; }));
+}
+
+TEST_F(WatchedFileTest, IgnoresOtherFiles) {
+  ASSERT_TRUE(WriteFile(filename, "one: 1"));
+  const absl::StatusOr<std::unique_ptr<WatchedProtoFile<SimpleMessage>>> file =
+      WatchedProtoFile<SimpleMessage>::Create(filename, Options());
+  ASSERT_THAT(file, IsOk());
+  ASSERT_TRUE(WriteFile(std::filesystem::path(kDir) / "other.txtpb", "one: x"));
+  ASSERT_TRUE(WriteFile(filename, "one: 22"));
+  EXPECT_TRUE(WaitUntil([&] { return (*file)->Get()->one() == 22; }));
+  EXPECT_THAT(num_errors.load(), 0);
+}
+
+TEST_F(WatchedFileTest, CreateErrors) {
+  EXPECT_THAT(
+      WatchedProtoFile<SimpleMessage>::Create(filename, Options()),
+      StatusIs(absl::StatusCode::kNotFound, HasSubstr("config.txtpb")));
+  ASSERT_TRUE(WriteFile(filename, "one: x"));
+  EXPECT_THAT(
+      WatchedProtoFile<SimpleMessage>::Create(filename, Options()),
+      StatusIs(absl::StatusCode::kAborted, HasSubstr("Cannot parse text proto file")));
+  EXPECT_THAT(num_errors.load(), 0);  // The initial read reports errors by status only.
+}
+
+// NOLINTEND(*-magic-numbers)
+}  // namespace
+}  // namespace mbo::proto